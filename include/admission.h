@@ -0,0 +1,93 @@
+/* Defines the admission control of the game-server: limits on the requests of
+ * each player and of the whole server, checked before a request is validated
+ * or takes the game lock, so a flood only costs a reply */
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include "comms.h"
+#include "game_def.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Environment variable with the actions per second of each player (0 for no
+ * limit) */
+#define ADMISSION_PLAYER_RATE_ENV "SPACE_PLAYER_RATE"
+#define ADMISSION_PLAYER_RATE 50
+
+/* Environment variable with the connect requests per second of the whole
+ * server (displays and astronauts, 0 for no limit) */
+#define ADMISSION_CONNECT_RATE_ENV "SPACE_CONNECT_RATE"
+#define ADMISSION_CONNECT_RATE 200
+
+/* Each limit allows a burst of a second of requests */
+#define ADMISSION_BURST_S 1
+
+/* The main loop is overloaded when it was busy for this percentage of a
+ * window, and then the connect requests are shed for the next one */
+#define ADMISSION_BUSY_PERCENTAGE 90
+#define ADMISSION_WINDOW_MS 100
+
+/* Time a shed display waits before connecting again (ms) */
+#define ADMISSION_RETRY_MS 100
+
+/*
+  The limits are token buckets, kept as the time at which each one is full
+  again (a request takes a token by moving it forward, and is shed if it
+  would be more than the burst away). A player is only charged for the
+  requests with its token, so nobody else can use up its limit. The actions
+  without a valid token share a bucket of one player instead (a REP socket
+  doesn't tell who sent them), so flooding them is shed before the
+  validators.
+
+  A REP socket answers the requests in order, so a shed request can't wait:
+  it is answered right away with 429. An action response tells the astronaut
+  when it can act again (action_wait_ms), and the displays connect again
+  after ADMISSION_RETRY_MS. The disconnects are never shed, as they free a
+  slot.
+*/
+
+typedef struct {
+  /* Time a token takes to come back and to fill the bucket (0 for no
+   * limit) */
+  uint64_t interval_ns;
+  uint64_t capacity_ns;
+  /* When the bucket is full again (monotonic ns) */
+  uint64_t full_ns;
+} token_bucket_t;
+
+typedef struct {
+  token_bucket_t players[MAX_PLAYERS];
+  /* The actions without a valid token */
+  token_bucket_t invalid;
+  token_bucket_t connects;
+  /* Time the main loop waited for requests in the current window */
+  uint64_t window_start_ns;
+  uint64_t window_idle_ns;
+  /* The previous window was over ADMISSION_BUSY_PERCENTAGE */
+  bool overloaded;
+} admission_t;
+
+/* Initializes a bucket with the given requests per second (0 for no limit) */
+void token_bucket_init(token_bucket_t *bucket, int rate);
+
+/* Takes a token, returning false (and the ns until there is one in retry_ns)
+ * if the bucket is empty */
+bool token_bucket_take(token_bucket_t *bucket, uint64_t now_ns,
+                       uint64_t *retry_ns);
+
+/* Initializes the limits from the environment */
+void admission_init(admission_t *admission);
+
+/* Records the time the main loop waited for a request (from wait_start_ns to
+ * received_ns), ending the window when it is over */
+void admission_record_wait(admission_t *admission, uint64_t wait_start_ns,
+                           uint64_t received_ns);
+
+/* Checks if a request received at now_ns is admitted, given the tokens of the
+ * players. If it isn't, retry_ns has the time until it would be */
+bool admission_admit(admission_t *admission, MESSAGE_TYPE msg_type,
+                     const void *request, const int *tokens, uint64_t now_ns,
+                     uint64_t *retry_ns);
+
+#endif // ADMISSION_H
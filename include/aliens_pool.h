@@ -0,0 +1,73 @@
+/* Defines the pool of threads that move the aliens of a tick in parallel, for
+ * boards with too many aliens for a single thread */
+
+#ifndef ALIENS_POOL_H
+#define ALIENS_POOL_H
+
+#include "comms.h"
+#include "game_core.h"
+#include "game_def.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Environment variable with the number of threads that move the aliens (by
+ * default one per ALIENS_PER_WORKER aliens, up to one per core) */
+#define ALIEN_WORKERS_ENV "SPACE_ALIEN_WORKERS"
+
+/* Aliens below which another worker isn't worth waking up */
+#define ALIENS_PER_WORKER 16384
+
+#define MAX_ALIEN_WORKERS 64
+
+/* Aliens the ranges of the workers start at a multiple of. 64 aliens take a
+ * whole number of 64 byte cache lines whatever the size of an alien */
+#define ALIENS_RANGE_ALIGN 64
+
+/*
+  Each worker moves a contiguous range of the aliens with aliens_move_range,
+  writing only to its own range of the update (the ranges start at a multiple
+  of ALIENS_RANGE_ALIGN aliens), so there is nothing to merge. As every alien uses the same
+  random number in any range, the result is the same as aliens_move with any
+  number of workers. The thread that calls aliens_pool_move is the first
+  worker.
+*/
+
+typedef struct {
+  struct aliens_pool *pool;
+  int index;
+} aliens_worker_t;
+
+typedef struct aliens_pool {
+  int n_workers;
+  pthread_t threads[MAX_ALIEN_WORKERS];
+  aliens_worker_t workers[MAX_ALIEN_WORKERS];
+  pthread_mutex_t lock;
+  pthread_cond_t work_ready;
+  pthread_cond_t work_done;
+  /* Increases with every tick given to the workers */
+  uint64_t tick;
+  /* Workers still moving the current tick (besides the caller) */
+  int working;
+  bool stopping;
+  /* The current tick */
+  const alien_t *aliens;
+  aliens_update_t *aliens_update;
+  game_rng_t rng;
+} aliens_pool_t;
+
+/* Returns the number of workers set by ALIEN_WORKERS_ENV or, if not set, the
+ * default for the board size and the cores */
+int aliens_pool_default_workers();
+
+/* Starts a pool with n_workers (including the caller of aliens_pool_move) */
+aliens_pool_t *aliens_pool_create(int n_workers);
+
+/* Same as aliens_move, splitting the aliens between the workers */
+void aliens_pool_move(aliens_pool_t *pool, const alien_t *aliens,
+                      aliens_update_t *aliens_update, game_rng_t *rng);
+
+/* Stops the workers and frees the pool */
+void aliens_pool_destroy(aliens_pool_t *pool);
+
+#endif // ALIENS_POOL_H
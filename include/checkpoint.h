@@ -0,0 +1,82 @@
+/* Defines the checkpoints of the game-server: the game state saved on a
+ * memory-mapped file, from which a restarted server resumes the match */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "game_core.h"
+#include "game_def.h"
+#include "game_snapshot.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Environment variable with the path of the checkpoint file (no checkpoints
+ * are saved when it isn't set) */
+#define CHECKPOINT_ENV "SPACE_CHECKPOINT"
+
+#define CHECKPOINT_MAGIC "SPACECKP"
+#define CHECKPOINT_VERSION 5
+
+/*
+  The file has two slots. A checkpoint is written to the slot that doesn't
+  have the latest one, which only changes once it is complete, so a crash
+  while saving still leaves the previous checkpoint intact. Each slot also has
+  a hash of its contents, in case the machine stops before the pages reach the
+  disk.
+*/
+
+typedef struct {
+  /* Increases with every checkpoint (0 if the slot was never written) */
+  uint64_t sequence;
+  /* Game clock time when it was saved (ms) */
+  uint64_t saved_ts;
+  /* Hash of the fields below */
+  uint64_t hash;
+  game_rng_t rng;
+  int tokens[MAX_PLAYERS];
+  /* Ids of the clients that connected the players (see
+   * astronaut_connect_request_t) */
+  uint64_t client_ids[MAX_PLAYERS];
+  game_t game;
+} checkpoint_slot_t;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  /* Build configuration (only the same one can restore it) */
+  int32_t space_size;
+  int32_t max_players;
+  int32_t n_aliens;
+  /* Slot with the latest checkpoint */
+  uint32_t latest_slot;
+  checkpoint_slot_t slots[2];
+} checkpoint_file_t;
+
+typedef struct checkpoint {
+  int fd;
+  checkpoint_file_t *file;
+  /* Serializes the saves, made by several threads without the game lock */
+  pthread_mutex_t lock;
+  /* Version of the last snapshot saved (an older one is skipped) */
+  uint64_t saved_version;
+} checkpoint_t;
+
+/* Opens (or creates) the checkpoint file, exiting if it can't or if it was
+ * created by a different build */
+checkpoint_t *checkpoint_open(const char *path);
+
+/* Restores the latest valid checkpoint, returning false if there isn't one */
+bool checkpoint_restore(checkpoint_t *checkpoint, game_t *game, int *tokens,
+                        uint64_t *client_ids, game_rng_t *rng);
+
+/* Saves a checkpoint of a snapshot, unless a newer one was already saved (it
+ * can be called by any thread, without the game lock) */
+void checkpoint_save(checkpoint_t *checkpoint, const game_snapshot_t *snapshot,
+                     uint64_t ts);
+
+/* Closes the file, discarding the checkpoints if the match ended (so the next
+ * server starts a new one) */
+void checkpoint_close(checkpoint_t *checkpoint, bool match_ended);
+
+#endif // CHECKPOINT_H
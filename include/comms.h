@@ -4,8 +4,9 @@
 #define COMMS_H
 
 #include "game_def.h"
-#include <ncurses.h>
+#include "render_backend.h"
 #include <pthread.h>
+#include <stdio.h>
 
 #define PROTOCOL "tcp"
 #define SERVER_IP "127.0.0.1"
@@ -20,10 +21,31 @@
 #define SERVER_ZMQ_PUBSUB_ADDRESS PROTOCOL "://" SERVER_IP ":" PORT_PUBSUB
 #define SERVER_ZMQ_PUBSUB_BIND_ADDRESS PROTOCOL "://*:" PORT_PUBSUB
 
+/*
+  Environment variables with the addresses of the server, which replace the
+  ones above. The server binds them and the clients connect to them, so any
+  zmq transport can be used, e.g. "ipc:///tmp/space-reqrep" on a single host
+  (the server and the clients set the same one) or "tcp://0.0.0.0:7000" for
+  the server and "tcp://host:7000" for the clients. "inproc://" only reaches
+  the same process (see space-bench)
+*/
+#define SERVER_REQREP_ENV "SPACE_SERVER_REQREP"
+#define SERVER_PUBSUB_ENV "SPACE_SERVER_PUBSUB"
+
+/* Environment variables with the addresses the displays connect to instead of
+ * the server's (e.g. the ones of a space-relay) */
+#define DISPLAY_REQREP_ENV "SPACE_DISPLAY_REQREP"
+#define DISPLAY_PUBSUB_ENV "SPACE_DISPLAY_PUBSUB"
+
+/* Longest address sent in a message (with the terminating '\0') */
+#define ADDRESS_SIZE 128
+
 /*
   Every message has 2 or 3 parts (depending if it is REQREP or PUBSUB) and they
   are sent in the following order:
     - (Optional) the topic (defined by PUBSUB_TOPICS)
+    - (Only on GAME_UPDATES_TOPIC, PLAYER_UPDATES_TOPIC and the tile topics)
+      the update header (update_header_t)
     - the type/header (defined by MESSAGE_TYPE)
     - the message contents (defined by the respective structs)
 
@@ -36,6 +58,19 @@
       to all the messages broadcasted by the server using PUBSUB. Here, the
       server simple publishes all messages received from the clients,
       invalidating the tokens so that sensitive information isn't broadcasted
+
+    - A space-relay answers the displays and publishes the same messages as
+      the server (it mirrors the game with the updates it forwards), so the
+      displays can connect to it, or to a relay of a relay, instead.
+
+    - When every alien is killed, the server starts a new round and publishes
+      its state (ROUND_STARTED), which the displays draw in place of the old
+      one without connecting again. GAME_ENDED is only published when the
+      server stops.
+
+    - Behind a space-lobby, every game-server pushes its SHARD_STATUS to the
+      lobby, which forwards the connect requests of the astronauts to the
+      least loaded one and answers with its addresses (see include/lobby.h).
 */
 typedef enum {
   /*
@@ -45,7 +80,7 @@ typedef enum {
   */
   DISPLAY_CONNECT_REQUEST,     /* No followup message needed */
   DISPLAY_CONNECT_RESPONSE,    /* Follows display_connect_response_t */
-  ASTRONAUT_CONNECT_REQUEST,   /* No followup message needed */
+  ASTRONAUT_CONNECT_REQUEST,   /* Follows astronaut_connect_request_t */
   ASTROUNAUT_CONNECT_RESPONSE, /* Follows astronaut_connect_response_t */
   ACTION_REQUEST,              /* Follows action_request_t */
   ACTION_RESPONSE,             /* Follows action_response_t */
@@ -54,7 +89,14 @@ typedef enum {
   /* PUBSUB only messages */
   GAME_ENDED,    /* No followup message needed */
   ALIENS_UPDATE, /* Follows aliens_update_t */
-  SCORES_UPDATE  /* Follows ScoresMessage (defined in src/proto/scores.proto) */
+  SCORES_UPDATE, /* Follows ScoresMessage (defined in src/proto/scores.proto) */
+  STATS_UPDATE,  /* Follows stats_update_t */
+  ROUND_STARTED, /* Follows display_connect_response_t (the new game state) */
+  ALIENS_TILE_UPDATE, /* Follows aliens_tile_update_t (variable size) */
+  /* Only pushed to a space-lobby */
+  SHARD_STATUS, /* Follows shard_status_t */
+  /* Not a message, just the number of types */
+  N_MESSAGE_TYPES
 } MESSAGE_TYPE;
 
 typedef enum {
@@ -63,11 +105,43 @@ typedef enum {
   /* Contains all game related updates such as connect, disconnect, zap, etc */
   GAME_UPDATES_TOPIC,
   /* Contains only the scores updates using protobuf protocol */
-  SCORES_UPDATES_TOPIC
+  SCORES_UPDATES_TOPIC,
+  /* Contains the server telemetry, published periodically */
+  STATS_TOPIC,
+  /* Contains the game updates but the aliens ones (only published when the
+   * board is split in tiles, see include/tiles.h) */
+  PLAYER_UPDATES_TOPIC,
+  /* First of the topics of the tiles, with the aliens of each one (the topic
+   * of tile t is TILES_TOPIC + t) */
+  TILES_TOPIC
 } PUBSUB_TOPICS;
 
+/*
+  Sent by the server right after the topic of every GAME_UPDATES_TOPIC message,
+  telling its order and when it was published (from the monotonic clock, so
+  the latencies are only meaningful when the displays run on the same machine).
+  The copies of the updates on PLAYER_UPDATES_TOPIC and the tile topics have
+  the header of the GAME_UPDATES_TOPIC one.
+
+  The sequences start over every time a game-server starts (e.g. restarted
+  from a checkpoint), which changes the epoch, so the readers that see a new
+  one request the game again instead of dropping its updates as old ones.
+*/
+typedef struct {
+  uint64_t epoch;
+  uint64_t sequence;
+  uint64_t sent_ns;
+} update_header_t;
+
 /******************** Requests structs ********************/
 
+typedef struct {
+  /* Random number chosen by the client, so the same request resent (e.g.
+   * while the server restarts) gets the player it created instead of another
+   * one. Cleared when broadcasted, as it is as secret as a token */
+  uint64_t client_id;
+} astronaut_connect_request_t;
+
 typedef struct {
   /* The id assigned to the player (corresponds to the position on the players
    * array) */
@@ -77,6 +151,12 @@ typedef struct {
   MOVEMENT_DIRECTION movement_direction;
   /* The token assigned to the player for authentication */
   int token;
+  /* Increasing number chosen by the client (kept when broadcasted, so a client
+   * that already applied its own action can ignore the broadcast) */
+  int sequence;
+  /* Score of the player after the action (only set when broadcasted, as the
+   * displays that don't have every alien can't count it) */
+  int score;
 } action_request_t;
 
 typedef struct {
@@ -89,14 +169,22 @@ typedef struct {
 /******************** Response structs ********************/
 
 typedef struct {
-  /* 200 if Ok, 400 otherwise */
+  /* 200 if Ok, 429 if the server is busy (only the status code is sent, see
+   * include/admission.h), 400 otherwise */
   int status_code;
+  /* Sequence of the first update not applied to the game yet (the ones before
+   * it can be received after subscribing and must be skipped) */
+  uint64_t next_sequence;
+  /* Epoch of the updates (see update_header_t) */
+  uint64_t epoch;
+  /* Size of the tiles of the board (0 if the server doesn't publish them) */
+  int tile_size;
   /* The current state of the game when it connected (without tokens) */
   game_t game;
 } display_connect_response_t;
 
 typedef struct {
-  /* 200 if Ok, 400 otherwise */
+  /* 200 if Ok, 429 if the server is busy, 400 otherwise */
   int status_code;
   /* The id assigned to the player (corresponds to the position on the players
    * array) */
@@ -104,18 +192,24 @@ typedef struct {
   MOVEMENT_ORIENTATION orientation;
   /* The token assigned to the player for authentication */
   int token;
+  /* Addresses of the game-server that accepted the player (only set by a
+   * space-lobby, empty when answered by the game-server itself) */
+  char reqrep_address[ADDRESS_SIZE];
+  char pubsub_address[ADDRESS_SIZE];
 } astronaut_connect_response_t;
 
 typedef struct {
-  /* 200 if Ok, 400 otherwise */
+  /* 200 if Ok, 429 if over the limit of the player (the timestamps tell when
+   * it can act again), 400 otherwise */
   int status_code;
   int player_score;
-  /* The timestamp of the next allowed zap (accounting for zap delay) -> this is
-   * also enforced server-side*/
-  uint64_t next_allowed_zap_timestamp;
-  /* The timestamp of the next allowed action (accounting for stunned delay)->
-   * this is also enforced server-side */
-  uint64_t next_allowed_action_timestamp;
+  /* Time left until the next allowed zap (accounting for zap delay, in ms and
+   * 0 if it is allowed now) -> this is also enforced server-side. A time left,
+   * as the clocks of the server and the client aren't comparable */
+  uint64_t zap_wait_ms;
+  /* Time left until the next allowed action (accounting for stunned delay,
+   * in ms and 0 if it is allowed now) -> this is also enforced server-side */
+  uint64_t action_wait_ms;
 } action_response_t;
 
 typedef struct {
@@ -135,23 +229,125 @@ typedef struct {
   alien_t aliens[N_ALIENS];
 } aliens_update_t;
 
+typedef struct {
+  /* Position of the alien in the aliens array */
+  int32_t index;
+  alien_t alien;
+} tile_alien_t;
+
+typedef struct {
+  int32_t tile;
+  /* Aliens alive on the whole board after the tick */
+  int32_t aliens_alive;
+  int32_t n_aliens;
+  /* The aliens in the tile after the tick, and the ones that left it */
+  tile_alien_t aliens[];
+} aliens_tile_update_t;
+
+typedef struct {
+  /* Addresses the clients connect to (see SERVER_REQREP_ENV) */
+  char reqrep_address[ADDRESS_SIZE];
+  char pubsub_address[ADDRESS_SIZE];
+  /* Players connected and slots left */
+  int32_t players;
+  int32_t free_slots;
+  int32_t aliens_alive;
+} shard_status_t;
+
+/* Threads of the game-server that use the game lock */
+typedef enum { LOCK_MAIN_LOOP, LOCK_ALIENS_THREAD, N_LOCK_USERS } LOCK_USER;
+
+/* Percentiles (ns) of the values measured during a stats interval */
+typedef struct {
+  uint64_t count;
+  uint64_t p50;
+  uint64_t p99;
+  uint64_t max;
+} latency_summary_t;
+
+typedef struct {
+  /* Duration of the interval (ms) */
+  uint64_t interval_ms;
+  /* Time to handle each type of request, from being received until the reply
+   * is sent (indexed by MESSAGE_TYPE, only the requests are used) */
+  latency_summary_t service_time[N_MESSAGE_TYPES];
+  /* Time waiting for and holding the game lock (indexed by LOCK_USER) */
+  latency_summary_t lock_wait[N_LOCK_USERS];
+  latency_summary_t lock_hold[N_LOCK_USERS];
+  /* Requests shed by the admission control (indexed by MESSAGE_TYPE, see
+   * include/admission.h) */
+  uint64_t shed[N_MESSAGE_TYPES];
+} stats_update_t;
+
 /******************** Thread args structs ********************/
 
 typedef struct {
-  game_t *game;
-  WINDOW *game_window;
-  WINDOW *score_window;
+  /* Where the current game is, replaced by the other one on every tick
+   * (holding lock), where the next generation is prepared without it */
+  game_t **game;
+  game_t *spare_game;
+  /* Aliens killed since the last tick (changed holding lock, defined in
+   * game_core.h) */
+  struct aliens_kills *kills;
+  nc_window_t *game_window;
+  nc_window_t *score_window;
   void *pub_socket;
   pthread_mutex_t *lock;
+  /* Protects the screen and the publish socket (taken after lock) */
+  pthread_mutex_t *io_lock;
+  /* Where the lock usage is measured (defined in server_stats.h) */
+  struct server_stats *stats;
+  /* Random numbers of the aliens (defined in game_core.h) */
+  struct game_rng *rng;
+  /* Rounds started, as a new round places the aliens again */
+  int *round;
+  /* Set once the last round ended (read holding lock, as aliens_alive is also
+   * 0 while a new round starts) */
+  bool *game_over;
+  /* Where the ticks are recorded, NULL if not (defined in journal.h) */
+  struct journal *journal;
+  /* Where the game is saved after each tick, NULL if not (defined in
+   * checkpoint.h) */
+  struct checkpoint *checkpoint;
+  /* The authentication tokens and the ids of the clients, published with the
+   * game */
+  int *tokens;
+  uint64_t *client_ids;
+  /* Where the game is published after each tick (defined in game_snapshot.h) */
+  struct snapshot_pool *snapshots;
+  /* Tiles where the aliens are also published, NULL if not (defined in
+   * tiles.h) */
+  struct tiles *tiles;
+  /* Where the ticks and the game are also written, NULL if not (defined in
+   * shm_channel.h) */
+  struct shm_channel *shm;
 } aliens_update_thread_args_t;
 
+typedef struct {
+  /* Set once the last round ended (read holding lock) */
+  bool *game_over;
+  void *pub_socket;
+  pthread_mutex_t *lock;
+  pthread_mutex_t *io_lock;
+  struct server_stats *stats;
+  /* Pushes the SHARD_STATUS to a space-lobby (NULL if there is none), with
+   * the players of the latest snapshot */
+  void *lobby_socket;
+  struct snapshot_pool *snapshots;
+} stats_publish_thread_args_t;
+
 typedef struct {
   MOVEMENT_ORIENTATION
   orientation; /* The orientation of the player that shot */
   int index;   /* The col/row of the player that shot */
-  game_t *game;
-  WINDOW *game_window;
+  /* Where the current game is (the game-server replaces it on every tick) */
+  game_t **game;
+  nc_window_t *game_window;
   pthread_mutex_t *lock;
+  pthread_mutex_t *io_lock;
+  /* If not NULL the zap is cleaned by the UI thread that consumes this queue
+   * (defined in render_queue.h) instead of locking and drawing directly */
+  struct render_queue *render_queue;
 } zap_clean_thread_args_t;
 
 #endif // COMMS_H
\ No newline at end of file
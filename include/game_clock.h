@@ -0,0 +1,63 @@
+/* Defines the clock used by the game rules (cooldowns, zaps and the aliens
+ * regeneration), which can be replaced to run the game faster than real time */
+
+#ifndef GAME_CLOCK_H
+#define GAME_CLOCK_H
+
+#include <stdint.h>
+
+/*
+  Clocks (chosen with the GAME_CLOCK_ENV environment variable):
+    - monotonic: reads the monotonic clock every time.
+    - cached (default): reads the time kept by the last game_clock_refresh,
+      which each program calls once per event (request, tick, key, ...), so
+      the validation, zap and response of a request share a single read.
+    - virtual: the monotonic clock times GAME_CLOCK_SPEED_ENV (e.g. 100 makes
+      the game 100x faster, also shortening game_clock_sleep_ms). With a speed
+      of 0 it only moves with game_clock_advance_ms (single threaded
+      simulations).
+
+  Every time is in ms of the machine's monotonic clock, so it never leaves the
+  program: the server sends the cooldowns as the time left, which each client
+  adds to its own clock. The clocks only have to run at the same speed, so
+  all programs of a game must use the same clock speed.
+*/
+
+/* Environment variable used to choose the clock (cached by default) */
+#define GAME_CLOCK_ENV "SPACE_CLOCK"
+
+/* Environment variable with the speed of the virtual clock (1 by default) */
+#define GAME_CLOCK_SPEED_ENV "SPACE_CLOCK_SPEED"
+
+typedef struct {
+  const char *name;
+  /* Returns the current time (ms) */
+  uint64_t (*now_ms)();
+  /* Reads the time again (only needed by the cached clock) */
+  void (*refresh)();
+} game_clock_t;
+
+extern const game_clock_t game_clock_monotonic;
+extern const game_clock_t game_clock_cached;
+extern const game_clock_t game_clock_virtual;
+
+/* Chooses the clock from the environment variables (exits if unknown) */
+void game_clock_init();
+
+/* Chooses the clock by name (speed is only used by the virtual clock) */
+void game_clock_use(const char *name, double speed);
+
+/* Returns the current time (ms) */
+uint64_t game_clock_now_ms();
+
+/* Reads the time again, called once per event handled */
+void game_clock_refresh();
+
+/* Moves the virtual clock forward */
+void game_clock_advance_ms(uint64_t ms);
+
+/* Sleeps for a time of the clock (a virtual clock with speed 0 is advanced
+ * instead) */
+void game_clock_sleep_ms(uint64_t ms);
+
+#endif // GAME_CLOCK_H
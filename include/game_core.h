@@ -0,0 +1,146 @@
+/* Defines the game rules, which only change the game state (no drawing and no
+ * messages, so they can run headless) */
+
+#ifndef GAME_CORE_H
+#define GAME_CORE_H
+
+#include "comms.h"
+#include "game_def.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Tracks when aliens were last killed, to regenerate them when none is killed
+ * for ALIEN_REGENERATION_DELAY */
+typedef struct {
+  int last_aliens_alive;
+  /* Timestamp (ms) of the last kill or regeneration */
+  uint64_t last_aliens_change_ts;
+} aliens_regeneration_t;
+
+/* Random numbers of the game rules, kept apart from rand() so a game can be
+ * replayed from its seed */
+typedef struct game_rng {
+  uint64_t state;
+} game_rng_t;
+
+/* Aliens killed since the last aliens tick, so the next one can apply them
+ * without comparing every alien (see aliens_commit_kills) */
+typedef struct aliens_kills {
+  int n_killed;
+  int killed[N_ALIENS];
+} aliens_kills_t;
+
+/******************** Random numbers ********************/
+
+/* Starts the generator (the same seed gives the same game) */
+void game_rng_seed(game_rng_t *rng, uint64_t seed);
+
+/* Returns the next random number (splitmix64) */
+uint32_t game_rng_next(game_rng_t *rng);
+
+/* Advances the generator as if n numbers were returned (as each number only
+ * depends on how many came before it, a part of the sequence can be computed
+ * without the ones before it) */
+void game_rng_skip(game_rng_t *rng, uint64_t n);
+
+/******************** Aliens management ********************/
+
+/* Starts tracking the aliens killed, at current_ts (ms) */
+void aliens_regeneration_init(aliens_regeneration_t *regeneration,
+                              game_t *game, uint64_t current_ts);
+
+/* Returns how many aliens the tick at current_ts (ms) should regenerate */
+int aliens_regeneration_count(aliens_regeneration_t *regeneration,
+                              game_t *game, uint64_t current_ts);
+
+/* Computes the next positions of every alien into aliens_update. The dead ones
+ * also move, so the random numbers used don't depend on the aliens killed and
+ * it can run without the game lock, from the positions of the last generation
+ * (only changed by aliens_commit and new rounds) */
+void aliens_move(const alien_t *aliens, aliens_update_t *aliens_update,
+                 game_rng_t *rng);
+
+/* Same as aliens_move for the aliens in [start, end), with rng as it is at
+ * the start of the tick (it isn't changed). Each alien uses the same random
+ * number whichever range it is moved in, so the ranges can be moved in any
+ * order or in parallel with the same result */
+void aliens_move_range(const alien_t *aliens, aliens_update_t *aliens_update,
+                       const game_rng_t *rng, int start, int end);
+
+/* Applies the positions computed by aliens_move to the game, with the aliens
+ * alive now (the ones killed meanwhile stay dead) plus up to
+ * aliens_to_regenerate dead aliens, which come back (returns how many were).
+ * aliens_update is left with the new generation, to be published */
+int aliens_commit(game_t *game, aliens_update_t *aliens_update,
+                  int aliens_to_regenerate);
+
+/* Same as aliens_commit, but into next, which has the generation of
+ * aliens_update with the aliens alive at the last commit: only the kills made
+ * since then are applied (kills) before regenerating, and next gets the
+ * players of the game, so it can replace it (returns how many aliens were
+ * regenerated) */
+int aliens_commit_kills(const game_t *game, game_t *next,
+                        aliens_update_t *aliens_update,
+                        const aliens_kills_t *kills, int aliens_to_regenerate);
+
+/* Moves the aliens and applies it to the game (aliens_move followed by
+ * aliens_commit), regenerating up to aliens_to_regenerate dead aliens (returns
+ * how many were) */
+int aliens_tick(game_t *game, aliens_update_t *aliens_update,
+                int aliens_to_regenerate, game_rng_t *rng);
+
+/* Places the alien on the board */
+void place_alien(alien_t *alien, game_rng_t *rng);
+
+/******************** Player management ********************/
+
+/* Places the player on the board. The ids go around the edge lanes (top,
+ * right, bottom and left, then the inner lanes next to them), starting at the
+ * middle of the lane and, for every 8 players, one cell further away from it
+ * on alternating sides */
+void place_player(player_t *player);
+
+/* Finds an available position for a player and initializes it */
+int find_position_and_init_player(game_t *game, int *tokens);
+
+/* Updates state when a player zaps at current_ts (ms), killing the aliens and
+ * stunning the players on its lane (the lane is drawn over by the zap, so the
+ * aliens don't need to be cleaned from the screen). The aliens killed are
+ * added to kills if it isn't NULL */
+void player_zap(game_t *game, int player_id, uint64_t current_ts,
+                aliens_kills_t *kills);
+
+/* Moves a player (keeping the players of each row and column) */
+void player_move(game_t *game, int player_id, MOVEMENT_DIRECTION direction);
+
+/* Disconnects a player, freeing its position */
+void player_leave(game_t *game, int player_id);
+
+/* Returns the first connected player on a row (orientation==VERTICAL, the
+ * lane of a vertical zap) or column (HORIZONTAL), -1 if none */
+int lane_first_player(game_t *game, MOVEMENT_ORIENTATION orientation,
+                      int index);
+
+/* Returns the next player on the same lane as player_id, -1 if none */
+int lane_next_player(game_t *game, MOVEMENT_ORIENTATION orientation,
+                     int player_id);
+
+/******************** Miscellaneous ********************/
+
+/* Inits all the players and aliens on the board */
+void init_game(game_t *game, int *tokens, game_rng_t *rng);
+
+/* Starts a new round once every alien was killed: the connected players keep
+ * their ids (and tokens) but go back to their places with no score, and every
+ * alien is placed again */
+void start_round(game_t *game, game_rng_t *rng);
+
+/* Update the position of a player or alien */
+void update_position(position_t *position, MOVEMENT_DIRECTION direction);
+
+/* Returns a hash of the players and aliens (used to check that a replayed
+ * game didn't diverge) */
+uint64_t game_checksum(const game_t *game);
+
+#endif // GAME_CORE_H
@@ -6,10 +6,16 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-/* Game configuration */
+/* Game configuration (SPACE_SIZE and MAX_PLAYERS can be overridden at build
+ * time, for example with "make SPACE_SIZE=200 MAX_PLAYERS=300", as the displays
+ * only draw a viewport of the board and the best scores) */
+#ifndef SPACE_SIZE
 #define SPACE_SIZE 20
+#endif
+#ifndef MAX_PLAYERS
 #define MAX_PLAYERS 8
-#define N_ALIENS (SPACE_SIZE * SPACE_SIZE) / 3
+#endif
+#define N_ALIENS ((SPACE_SIZE * SPACE_SIZE) / 3)
 #define ZAP_TIME_ON_SCREEN 500         // ms
 #define ZAP_DELAY 3000                 // ms
 #define STUNNED_DELAY 10000            // ms
@@ -17,42 +23,75 @@
 #define ALIEN_REGENERATION_DELAY 10000 // ms
 #define ALIEN_REGENERATION_FACTOR 0.1
 
+/* Symbols of the players on the board, in the order of their ids */
+#define PLAYER_SYMBOLS                                                         \
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"
+#define N_PLAYER_SYMBOLS 62
+/* Size of the names of the players on the scoreboards (see id_to_label) */
+#define PLAYER_LABEL_SIZE 12
+
+/* Environment variable with the number of rounds played by the game-server
+ * before it stops (it never stops when it isn't set or is 0) */
+#define ROUNDS_ENV "SPACE_ROUNDS"
+
 /* Action enums */
 typedef enum { VERTICAL, HORIZONTAL } MOVEMENT_ORIENTATION;
 typedef enum { UP, RIGHT, DOWN, LEFT, NO_MOVEMENT } MOVEMENT_DIRECTION;
 typedef enum { MOVE, ZAP } ACTION_TYPE;
 
 /* Game-related structures */
+
+/* Coordinates of the board, as narrow as its size allows (the aliens are most
+ * of the game state, every snapshot and every aliens update) */
+#if SPACE_SIZE <= 256
+typedef uint8_t coord_t;
+#else
+typedef uint16_t coord_t;
+#endif
+
+/* Ids of the players (-1 if none) */
+typedef int16_t player_id_t;
+
 typedef struct {
-  int row;
-  int col;
+  coord_t row;
+  coord_t col;
 } position_t;
 
+/* Ordered by size, so only the end is padded (to 32 bytes, two per cache
+ * line) */
 typedef struct {
-  /* The id of the player (that corresponds to its  position on the players
-   * array)*/
-  int id;
-  /* Defines if the player is connected/playing or if the position is free */
-  bool connected;
-  MOVEMENT_ORIENTATION orientation;
-  position_t position;
-  /* The current score (-1 if not connected) */
-  int score;
-  /* Contains the timestamp (ms since epoch) where the player was last stunned
+  /* Contains the time of the game clock (ms) when the player was last stunned
    * (starts at 0) */
   uint64_t last_stunned;
-  /* Contains the timestamp (ms since epoch) where the player last shot (starts
+  /* Contains the time of the game clock (ms) when the player last shot (starts
    * at 0) */
   uint64_t last_shot;
+  /* The current score (-1 if not connected) */
+  int score;
+  /* The id of the player (that corresponds to its  position on the players
+   * array)*/
+  player_id_t id;
+  /* Next player on the same row/column (-1 if none, see game_t) */
+  player_id_t next_in_row;
+  player_id_t next_in_col;
+  position_t position;
+  /* Defines if the player is connected/playing or if the position is free */
+  uint8_t connected : 1;
+  /* MOVEMENT_ORIENTATION */
+  uint8_t orientation : 1;
 } player_t;
 
 typedef struct {
-  bool alive;
   position_t position;
+  bool alive;
 } alien_t;
 
 typedef struct {
   player_t players[MAX_PLAYERS];
+  /* First connected player on each row/column (-1 if none), so a zap only
+   * checks the players on its lane (only changed by the rules in game_core.h) */
+  player_id_t row_players[SPACE_SIZE];
+  player_id_t col_players[SPACE_SIZE];
   /* Game ends when it reaches 0 */
   int aliens_alive;
   alien_t aliens[N_ALIENS];
@@ -0,0 +1,67 @@
+/* Defines the snapshots of the game published by the game-server, which let
+ * readers use a consistent game state without the game lock or a copy */
+
+#ifndef GAME_SNAPSHOT_H
+#define GAME_SNAPSHOT_H
+
+#include "game_core.h"
+#include "game_def.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Snapshots kept, so the writer always finds one without readers */
+#define SNAPSHOT_SLOTS 4
+
+/*
+  Works like RCU: the writer copies the game to a slot that isn't the latest
+  one and has no readers, and then makes it the latest one. A reader counts
+  itself on the latest slot and checks that it still is the latest one, so the
+  writer can't be reusing it, and keeps it until it releases it (the snapshot
+  never changes meanwhile). The aliens, which are most of the game, are only
+  copied to a slot when they changed since it was last written.
+*/
+
+typedef struct {
+  /* Increases with every snapshot published */
+  uint64_t version;
+  /* Version of the aliens in this slot (see snapshot_pool_t) */
+  uint64_t aliens_version;
+  /* Readers using the slot (it can only be written when there are none) */
+  int readers;
+  /* Sequence of the first update published after it */
+  uint64_t next_update_sequence;
+  /* What the game-server saves with the game (see include/checkpoint.h) */
+  game_rng_t rng;
+  int tokens[MAX_PLAYERS];
+  uint64_t client_ids[MAX_PLAYERS];
+  game_t game;
+} game_snapshot_t;
+
+typedef struct snapshot_pool {
+  game_snapshot_t slots[SNAPSHOT_SLOTS];
+  game_snapshot_t *latest;
+  /* Increases every time the aliens change */
+  uint64_t aliens_version;
+} snapshot_pool_t;
+
+/* Publishes the first snapshot */
+void snapshot_pool_init(snapshot_pool_t *pool, const game_t *game,
+                        const int *tokens, const uint64_t *client_ids,
+                        const game_rng_t *rng);
+
+/* Publishes a snapshot of the game (the caller serializes the publishes and
+ * the changes to the game, e.g. with a lock). aliens_changed tells if the
+ * aliens changed since the last one and next_update_sequence is the sequence
+ * of the first update that isn't applied to it yet */
+void snapshot_publish(snapshot_pool_t *pool, const game_t *game,
+                      const int *tokens, const uint64_t *client_ids,
+                      const game_rng_t *rng, bool aliens_changed,
+                      uint64_t next_update_sequence);
+
+/* Returns the latest snapshot, which doesn't change until it is released */
+const game_snapshot_t *snapshot_acquire(snapshot_pool_t *pool);
+
+/* Releases a snapshot returned by snapshot_acquire */
+void snapshot_release(const game_snapshot_t *snapshot);
+
+#endif // GAME_SNAPSHOT_H
@@ -0,0 +1,46 @@
+/* Defines a fixed size histogram used to keep latency percentiles */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+  Values are kept in log-linear buckets: each power of 2 is split into
+  HISTOGRAM_SUB_BUCKETS linear buckets, so every value is stored with an error
+  below 1/HISTOGRAM_SUB_BUCKETS (~6%) without depending on its range. Values
+  below HISTOGRAM_SUB_BUCKETS have their own bucket
+*/
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS                                                      \
+  ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  /* Number of values recorded */
+  uint64_t total;
+  /* Exact max value recorded */
+  uint64_t max;
+} histogram_t;
+
+/* Clears the histogram */
+void histogram_reset(histogram_t *histogram);
+
+/* Records a value */
+void histogram_record(histogram_t *histogram, uint64_t value);
+
+/* Adds the values recorded by another histogram */
+void histogram_merge(histogram_t *histogram, const histogram_t *other);
+
+/* Returns the value at the given percentile (0-100), which is the highest
+ * value of its bucket (0 if nothing was recorded) */
+uint64_t histogram_percentile(const histogram_t *histogram, double percentile);
+
+/* Prints the count, p50, p99 and max of a histogram of nanoseconds as ms */
+void histogram_print_ms(FILE *stream, const char *name,
+                        const histogram_t *histogram);
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,117 @@
+/* Defines the journal of a match: an append-only, memory-mapped binary file
+ * with every input accepted by the game-server and every aliens tick, from
+ * which space-replay reproduces the match */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "comms.h"
+#include "game_def.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Environment variable with the path of the journal written by the server
+ * (nothing is recorded when it isn't set) */
+#define JOURNAL_ENV "SPACE_JOURNAL"
+
+/* Environment variable with the seed of the aliens (random if not set) */
+#define JOURNAL_SEED_ENV "SPACE_SEED"
+
+#define JOURNAL_MAGIC "SPACEJNL"
+#define JOURNAL_VERSION 2
+
+/* Bytes added to the file (and mapped) every time it fills up */
+#define JOURNAL_GROWTH (1 << 20)
+
+typedef enum {
+  JOURNAL_CONNECT,
+  JOURNAL_ACTION,
+  JOURNAL_DISCONNECT,
+  JOURNAL_TICK,
+  JOURNAL_ROUND
+} JOURNAL_RECORD_TYPE;
+
+/* Start of the file, with what's needed to start the same match */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  /* Build configuration (a journal can only be replayed by the same one) */
+  int32_t space_size;
+  int32_t max_players;
+  int32_t n_aliens;
+  uint64_t seed;
+  /* Game clock time when the match started (ms) */
+  uint64_t start_ts;
+  /* Records written, updated after each one (so the journal of a server that
+   * crashed can still be replayed) */
+  uint64_t n_records;
+} journal_header_t;
+
+typedef struct {
+  /* JOURNAL_RECORD_TYPE */
+  uint32_t type;
+  /* Player of the connect, action and disconnect records */
+  int32_t player_id;
+  /* Game clock time when it was applied (ms) */
+  uint64_t ts;
+  union {
+    struct {
+      int32_t action_type;
+      int32_t movement_direction;
+    } action;
+    /* Also used by the round records (without aliens regenerated) */
+    struct {
+      /* Aliens regenerated by the tick */
+      int32_t aliens_regenerated;
+      /* State after the tick, checked when replaying (the checksum of a tick
+       * is written after it, without the game lock, so it is 0 if the server
+       * stopped before) */
+      int32_t aliens_alive;
+      uint64_t checksum;
+    } tick;
+  } data;
+} journal_record_t;
+
+typedef struct journal {
+  int fd;
+  /* Start of the mapping */
+  journal_header_t *header;
+  size_t mapped_size;
+} journal_t;
+
+/* Creates the journal of a match (exits if the file can't be created) */
+journal_t *journal_create(const char *path, uint64_t seed, uint64_t start_ts);
+
+/* Appends a record (the caller serializes the appends, e.g. with the game
+ * lock) */
+void journal_append(journal_t *journal, const journal_record_t *record);
+
+/* Appends an input accepted by the server (action_request is only used by
+ * JOURNAL_ACTION) */
+void journal_append_input(journal_t *journal, JOURNAL_RECORD_TYPE type,
+                          int player_id, const action_request_t *action_request,
+                          uint64_t ts);
+
+/* Appends an aliens tick, with the aliens alive after it, and returns its
+ * index (its checksum is written later, see journal_set_checksum) */
+uint64_t journal_append_tick(journal_t *journal, int aliens_regenerated,
+                             const game_t *game, uint64_t ts);
+
+/* Writes the checksum of the game after the tick with the given index. It can
+ * be called while other records are appended (without the game lock) */
+void journal_set_checksum(journal_t *journal, uint64_t index,
+                          const game_t *game);
+
+/* Appends the start of a new round, with the game state after it */
+void journal_append_round(journal_t *journal, game_t *game, uint64_t ts);
+
+/* Truncates the file to the records written and closes it */
+void journal_close(journal_t *journal);
+
+/* Maps a journal to be read, returning NULL if it isn't valid */
+const journal_header_t *journal_map(const char *path, size_t *mapped_size);
+
+/* Returns the first record of a mapped journal */
+const journal_record_t *journal_records(const journal_header_t *header);
+
+#endif // JOURNAL_H
@@ -0,0 +1,79 @@
+/* Defines the lobby: a space-lobby process that places the astronauts on the
+ * least loaded of several game-server processes (the shards), so adding
+ * capacity is starting more servers */
+
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include "comms.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/* Environment variable with the address of the lobby the astronauts connect
+ * to (they connect to the server when it isn't set) */
+#define LOBBY_ENV "SPACE_LOBBY"
+
+/* Environment variable with the address where a game-server reports to the
+ * lobby (it isn't a shard when it isn't set) */
+#define LOBBY_SHARDS_ENV "SPACE_LOBBY_SHARDS"
+
+/* Default addresses bound by the lobby */
+#define LOBBY_REQREP_BIND_ADDRESS PROTOCOL "://*:62768"
+#define LOBBY_SHARDS_BIND_ADDRESS PROTOCOL "://*:62769"
+
+/* Time after which a shard that stopped reporting is forgotten (ms) */
+#define LOBBY_SHARD_TIMEOUT_MS 3000
+
+/* Time the lobby waits for a shard to answer a connect request before trying
+ * the next one (ms) */
+#define LOBBY_SHARD_REQUEST_MS 500
+
+/* Shards tracked by a lobby */
+#define LOBBY_MAX_SHARDS 64
+
+/*
+  Every game-server started with LOBBY_SHARDS_ENV pushes a SHARD_STATUS to the
+  lobby with its addresses (the ones its clients connect to, see
+  SERVER_REQREP_ENV, so each shard needs its own) and players, along with its
+  stats. The status is dropped when the lobby isn't there, as the next one
+  replaces it. The lobby forgets the shards that stop reporting.
+
+  An astronaut started with LOBBY_ENV sends its ASTRONAUT_CONNECT_REQUEST to
+  the lobby, which forwards it to the least loaded shard with free slots (the
+  next one if it is full by then) and answers with its response and the
+  addresses of the shard. The rest of the requests of the astronaut, and the
+  display of the same program, go to the shard. A shard that doesn't answer in
+  LOBBY_SHARD_REQUEST_MS isn't tried again until its next status.
+*/
+
+/* Shard where the astronaut of a program was placed, followed by its display
+ * role */
+typedef struct {
+  atomic_bool placed;
+  char reqrep_address[ADDRESS_SIZE];
+  char pubsub_address[ADDRESS_SIZE];
+} lobby_placement_t;
+
+/******************** Shards (game-server) ********************/
+
+/* Creates the socket that pushes the status of the server to the lobby, or
+ * returns NULL if LOBBY_SHARDS_ENV isn't set */
+void *lobby_shard_socket(void *context);
+
+/* Pushes the status of the server to the lobby (dropped if it can't be sent
+ * right away) */
+void lobby_report_shard(void *lobby_socket, const game_t *game);
+
+/******************** Astronauts ********************/
+
+/* Returns the address the astronauts send their connect request to (the one
+ * of the lobby or, without one, of the server) */
+char *lobby_connect_address();
+
+/* Moves a REQ socket from the lobby to the shard that accepted the astronaut,
+ * given the response to its connect request. Returns false (and leaves the
+ * socket as it is) if the response came from a game-server */
+bool lobby_follow_shard(void *req_socket, const char *lobby_address,
+                        const astronaut_connect_response_t *response);
+
+#endif // LOBBY_H
@@ -2,9 +2,15 @@
 #define NCURSES_WRAPPER_H
 
 #include "game_def.h"
+#include "histogram.h"
+#include "render_backend.h"
+#include "trace.h"
 #include <assert.h>
-#include <ncurses.h>
+#include <ncurses.h> /* KEY_* values */
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <utils.h>
 
@@ -12,23 +18,113 @@
  * border)*/
 #define POS_TO_WIN(val) ((val) + 1)
 
+/* Width of the scoreboard window (drawn to the right of the game window) */
+#define SCOREBOARD_WIDTH 16
+
+/* Players shown on the scoreboard (the ones with the best scores) */
+#define SCOREBOARD_PLAYERS (MAX_PLAYERS < 8 ? MAX_PLAYERS : 8)
+
+/* Height of the scoreboard window */
+#define SCOREBOARD_ROWS (SCOREBOARD_PLAYERS + 2 + 2 + 2)
+
+#if MAX_PLAYERS > 10 * N_PLAYER_SYMBOLS
+#error "The scoreboard only fits player labels of up to 2 characters"
+#endif
+
+/* Height of the astronaut window (drawn below the game window when joint) */
+#define ASTRONAUT_WINDOW_ROWS 11
+
+/* Size of the latency overlay (drawn below the scoreboard) */
+#define LATENCY_WINDOW_ROWS 6
+#define LATENCY_WINDOW_WIDTH 24
+
+/* Distance to the viewport edge at which a followed player recenters it */
+#define VIEWPORT_FOLLOW_MARGIN 3
+
+/* Part of the board that is currently shown on the game window */
+typedef struct {
+  /* Board row/col drawn at the top left corner of the window */
+  int row;
+  int col;
+  /* Number of board rows/cols that fit in the window */
+  int height;
+  int width;
+} viewport_t;
+
+/* The viewport of the game window (each program has a single one) */
+extern viewport_t nc_viewport;
+
+/* Checks if a board position is inside the viewport */
+#define NC_IS_VISIBLE(position)                                                \
+  ((position).row >= nc_viewport.row &&                                        \
+   (position).row < nc_viewport.row + nc_viewport.height &&                    \
+   (position).col >= nc_viewport.col &&                                        \
+   (position).col < nc_viewport.col + nc_viewport.width)
+
+/* Converts a board row/col to a position on the window (considering the
+ * viewport and the border) */
+#define ROW_TO_WIN(val) POS_TO_WIN((val) - nc_viewport.row)
+#define COL_TO_WIN(val) POS_TO_WIN((val) - nc_viewport.col)
+
 /******************** Initialization functions ********************/
 
 /* Initializes ncurses */
 void nc_init();
 
-/* Draws game rectangle */
-WINDOW *nc_init_space();
+/* Draws game rectangle, sized to the viewport that fits in the terminal
+ * (leaving reserved_rows free below it) */
+nc_window_t *nc_init_space(int reserved_rows);
 
 /* Draws score rectangle */
-WINDOW *nc_init_scoreboard();
+nc_window_t *nc_init_scoreboard();
+
+/* Draws latency overlay rectangle */
+nc_window_t *nc_init_latency();
 
 /* Draws user commands */
-WINDOW *nc_init_astronaut(MOVEMENT_ORIENTATION player_orientation,
-                          int player_id, int starting_row);
+nc_window_t *nc_init_astronaut(MOVEMENT_ORIENTATION player_orientation,
+                               int player_id, int starting_row);
 
 /* Draws the elements necessary for a given game when initializing */
-void nc_draw_init_game(WINDOW *game_window, WINDOW *score_window, game_t game);
+void nc_draw_init_game(nc_window_t *game_window, nc_window_t *score_window,
+                       game_t *game);
+
+/* Returns the number of terminal rows used by the game window */
+int nc_space_window_rows();
+
+/******************** Viewport ********************/
+
+/* Moves the viewport so its top left corner is on the given board position
+ * (clamped to the board) and redraws the game window if it changed */
+void nc_set_viewport(nc_window_t *game_window, game_t *game, int row, int col);
+
+/* Recenters the viewport on a position if it got close to the edges */
+void nc_follow_position(nc_window_t *game_window, game_t *game,
+                        position_t position);
+
+/* Scrolls the viewport according to a key (arrows or WASD), returning
+ * true if the key was a scroll key */
+bool nc_scroll_viewport(nc_window_t *game_window, game_t *game, int key);
+
+/* Redraws all the visible elements of the game window */
+void nc_redraw_space(nc_window_t *game_window, game_t *game);
+
+/* Shows a message on the entire screen */
+void nc_show_message(const char *message);
+
+/******************** Refreshing screen ********************/
+
+/* Marks a window to be written to the terminal on the next flush */
+void nc_stage(nc_window_t *win);
+
+/* Writes every staged window to the terminal (a frame) */
+void nc_flush();
+
+/* Writes a single window to the terminal */
+void nc_refresh(nc_window_t *win);
+
+/* Returns the counters of the render backend */
+render_stats_t nc_get_render_stats();
 
 /******************** Updating screen ********************/
 
@@ -36,30 +132,40 @@ void nc_draw_init_game(WINDOW *game_window, WINDOW *score_window, game_t game);
 int __compare_players(const void *a, const void *b);
 
 /* Resets and updates the scoreboard */
-void nc_update_scoreboard(WINDOW *win, player_t *players, int aliens_alive);
+void nc_update_scoreboard(nc_window_t *win, player_t *players,
+                          int aliens_alive);
 
 /* Adds a player to the screen */
-void nc_add_player(WINDOW *win, player_t player);
+void nc_add_player(nc_window_t *win, player_t player);
 
 /* Move a player on the screen */
-void nc_move_player(WINDOW *win, player_t player, position_t old_pos);
+void nc_move_player(nc_window_t *win, player_t player, position_t old_pos);
 
 /* Draws the zap line on the screen */
-void nc_draw_zap(WINDOW *win, game_t *game, player_t *player_zap);
+void nc_draw_zap(nc_window_t *win, game_t *game, player_t *player_zap);
 
 /* Adds a alien to the screen */
-void nc_add_alien(WINDOW *game_window, position_t *position, bool regenerated);
+void nc_add_alien(nc_window_t *game_window, position_t *position,
+                  bool regenerated);
+
+/* Prints the latency percentiles (in ms) of the game updates on the overlay */
+void nc_update_latency(nc_window_t *win, const histogram_t *receive_lag,
+                       const histogram_t *render_lag, uint64_t missed_updates);
+
+/* Prints the current score on the astronaut window */
+void nc_update_astronaut_score(nc_window_t *win, int score);
 
 /******************** Cleaning screen ********************/
 
 /* Cleans a position from the screen */
-void nc_clean_position(WINDOW *win, position_t position);
+void nc_clean_position(nc_window_t *win, position_t position);
 
 /* Cleans a zap from the screen */
-void nc_clean_zap(WINDOW *win, game_t *game, MOVEMENT_ORIENTATION orientation,
-                  int index);
+void nc_clean_zap(nc_window_t *win, game_t *game,
+                  MOVEMENT_ORIENTATION orientation, int index);
 
-/* Stops and cleanup ncurses */
+/* Stops and cleanup the render backend (printing its counters if the
+ * RENDER_STATS_ENV environment variable is set) */
 void nc_cleanup();
 
 #endif // NCURSES_WRAPPER_H
\ No newline at end of file
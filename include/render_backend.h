@@ -0,0 +1,82 @@
+/* Defines the interface implemented by each render backend */
+
+#ifndef RENDER_BACKEND_H
+#define RENDER_BACKEND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Environment variable used to choose the backend (ncurses by default) */
+#define RENDER_BACKEND_ENV "SPACE_RENDERER"
+
+/* Environment variable that makes nc_cleanup print the render stats */
+#define RENDER_STATS_ENV "SPACE_RENDER_STATS"
+
+/* Styles of a cell (a color optionally combined with NC_BOLD) */
+#define NC_COLOR_DEFAULT 0
+#define NC_COLOR_RED 1
+#define NC_COLOR_YELLOW 2
+#define NC_COLOR_GREEN 3
+#define NC_COLOR_MASK 0xff
+#define NC_BOLD 0x100
+
+/* A window of the render backend */
+typedef struct {
+  /* Size and position on the terminal */
+  int rows;
+  int cols;
+  int start_row;
+  int start_col;
+  /* Backend specific (e.g. the ncurses WINDOW) */
+  void *handle;
+} nc_window_t;
+
+/* Counters kept for every backend */
+typedef struct {
+  uint64_t frames;
+  uint64_t bytes;
+  uint64_t last_frame_bytes;
+} render_stats_t;
+
+/*
+  The drawing functions (nc_*) only use these primitives, so they work the
+  same way with every backend:
+    - ncurses: the original implementation
+    - null: keeps no screen at all (only the game state is applied), used to
+      run headless displays
+    - ansi: keeps its own screen and writes the changed cells of each frame
+      with a single write()
+*/
+typedef struct {
+  const char *name;
+  /* Prepares the terminal and returns its size */
+  void (*init)(int *rows, int *cols);
+  /* Creates the backend part of a window (size and position already set) */
+  void (*create_window)(nc_window_t *win);
+  /* Frees the backend part of a window */
+  void (*destroy_window)(nc_window_t *win);
+  /* Draws a character on a window position */
+  void (*put_char)(nc_window_t *win, int row, int col, char ch, int style);
+  /* Draws a text on a window position */
+  void (*print)(nc_window_t *win, int row, int col, const char *text);
+  /* Draws a border around the window */
+  void (*draw_box)(nc_window_t *win);
+  /* Clears the window */
+  void (*erase_window)(nc_window_t *win);
+  /* Marks the window to be written on the next flush */
+  void (*stage)(nc_window_t *win);
+  /* Writes the staged windows to the terminal, returning the bytes written */
+  size_t (*flush)(void);
+  /* Restores the terminal */
+  void (*cleanup)(void);
+} render_backend_t;
+
+extern const render_backend_t render_backend_ncurses;
+extern const render_backend_t render_backend_null;
+extern const render_backend_t render_backend_ansi;
+
+/* Returns the backend with the given name (NULL if there isn't one) */
+const render_backend_t *render_backend_find(const char *name);
+
+#endif // RENDER_BACKEND_H
@@ -0,0 +1,92 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "comms.h"
+#include "game_def.h"
+#include <assert.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Number of commands the queue can hold (must be a power of 2) */
+#define RENDER_QUEUE_SIZE 1024
+
+/*
+  The client programs have a single UI thread that owns ncurses and the game
+  state shown on the screen. The other threads (roles) never draw, instead
+  they push commands to this queue, which the UI thread consumes in order.
+*/
+typedef enum {
+  /* A display role got the current game state (data is a
+   * display_connect_response_t) */
+  RENDER_GAME_INIT,
+  /* A display role received an update from the server (msg_type, data and
+   * header are the ones received from the socket) */
+  RENDER_GAME_UPDATE,
+  /* A zap finished its time on screen (orientation and index) */
+  RENDER_CLEAN_ZAP,
+  /* The astronaut role connected (value is the player id) */
+  RENDER_ASTRONAUT_INIT,
+  /* The astronaut role got a new score (value is the score) */
+  RENDER_ASTRONAUT_SCORE,
+  /* The server accepted an action of the astronaut role, which is applied
+   * right away instead of waiting for the broadcast (data is the
+   * action_request_t and value is the player score after it) */
+  RENDER_LOCAL_ACTION,
+  /* A key that scrolls the viewport was pressed (value is the key) */
+  RENDER_SCROLL,
+  /* A role stopped (data is an optional message to print after ncurses is
+   * closed) */
+  RENDER_ROLE_DONE
+} RENDER_COMMAND_TYPE;
+
+typedef struct {
+  RENDER_COMMAND_TYPE type;
+  /* Only used by RENDER_GAME_UPDATE */
+  MESSAGE_TYPE msg_type;
+  /* Dynamically allocated, the UI thread frees it after applying it */
+  void *data;
+  /* Meaning depends on the type */
+  int value;
+  /* Used by RENDER_ASTRONAUT_INIT and RENDER_CLEAN_ZAP */
+  MOVEMENT_ORIENTATION orientation;
+  /* The col/row of the zap to clean */
+  int index;
+  /* Used by RENDER_GAME_UPDATE, to measure its latency */
+  update_header_t header;
+  uint64_t received_ns;
+} render_command_t;
+
+/* Bounded multi-producer single-consumer lock-free queue (each cell has a
+ * sequence number telling if it is ready to be written or read) */
+typedef struct render_queue {
+  struct {
+    atomic_size_t sequence;
+    render_command_t command;
+  } cells[RENDER_QUEUE_SIZE];
+  /* Next position to be written (shared by the producers) */
+  atomic_size_t enqueue_pos;
+  /* Next position to be read (only used by the consumer) */
+  size_t dequeue_pos;
+  /* Counts the commands in the queue so the consumer sleeps when idle */
+  sem_t available;
+} render_queue_t;
+
+/* Initializes the queue */
+void render_queue_init(render_queue_t *queue);
+
+/* Pushes a command to the queue (yields while the queue is full) */
+void render_queue_push(render_queue_t *queue, render_command_t *command);
+
+/* Pops a command from the queue, blocking while it is empty */
+void render_queue_pop(render_queue_t *queue, render_command_t *command);
+
+/* Returns true if there are no commands waiting */
+bool render_queue_empty(render_queue_t *queue);
+
+/* Destroys the queue */
+void render_queue_destroy(render_queue_t *queue);
+
+#endif // RENDER_QUEUE_H
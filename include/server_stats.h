@@ -0,0 +1,89 @@
+/* Defines the telemetry kept by the game-server */
+
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include "comms.h"
+#include "histogram.h"
+#include "utils.h"
+#include "zeromq_wrapper.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/* Interval between the stats published on STATS_TOPIC */
+#define STATS_PUBLISH_INTERVAL 1000 // ms
+
+/* Requests answered without the game lock after which the main loop adds their
+ * service times to the stats, if the lock is free */
+#define STATS_LOCK_FREE_FLUSH 64
+
+/*
+  Every value is recorded while holding the game lock (the lock hold time is
+  measured right before unlocking), so the stats need no synchronization of
+  their own. They are recorded in one of two intervals: the stats thread swaps
+  them under the lock, and summarizes and clears the previous one after
+  unlocking, as nobody records in it until the next swap. The main loop keeps
+  the service times of the requests answered without the lock apart, and adds
+  them to the others the next time it holds it
+*/
+typedef struct {
+  /* Indexed by MESSAGE_TYPE (only the requests are used) */
+  histogram_t service_time[N_MESSAGE_TYPES];
+  /* Indexed by LOCK_USER */
+  histogram_t lock_wait[N_LOCK_USERS];
+  histogram_t lock_hold[N_LOCK_USERS];
+  /* Start of the interval (monotonic ns) */
+  uint64_t start_ns;
+} stats_interval_t;
+
+typedef struct server_stats {
+  stats_interval_t intervals[2];
+  /* The one being recorded (see above) */
+  stats_interval_t *current;
+  /* Only used by the main loop (see above) */
+  histogram_t lock_free_service_time[N_MESSAGE_TYPES];
+  int lock_free_pending;
+  /* Requests shed, counted by the main loop without the lock (atomically) */
+  uint64_t shed[N_MESSAGE_TYPES];
+} server_stats_t;
+
+/* Clears the stats and starts an interval */
+void server_stats_init(server_stats_t *stats);
+
+/* Locks the game lock measuring the wait, returning when it was acquired */
+uint64_t server_stats_lock(server_stats_t *stats, pthread_mutex_t *lock,
+                           LOCK_USER user);
+
+/* Unlocks the game lock measuring how long it was held */
+void server_stats_unlock(server_stats_t *stats, pthread_mutex_t *lock,
+                         LOCK_USER user, uint64_t acquired_ns);
+
+/* Records the time taken by a request received at received_ns (must hold the
+ * game lock) */
+void server_stats_record_service(server_stats_t *stats, MESSAGE_TYPE msg_type,
+                                 uint64_t received_ns);
+
+/* Records the time taken by a request answered without the game lock (only
+ * called by the main loop) */
+void server_stats_record_lock_free(server_stats_t *stats,
+                                   pthread_mutex_t *lock, MESSAGE_TYPE msg_type,
+                                   uint64_t received_ns);
+
+/* Counts a request shed by the admission control (only called by the main
+ * loop, without the game lock) */
+void server_stats_record_shed(server_stats_t *stats, MESSAGE_TYPE msg_type);
+
+/* Starts a new interval, returning the previous one (must hold the game
+ * lock) */
+stats_interval_t *server_stats_swap(server_stats_t *stats);
+
+/* Fills the update with an interval returned by server_stats_swap and clears
+ * it (without the game lock) */
+void server_stats_summarize(server_stats_t *stats, stats_interval_t *interval,
+                            stats_update_t *stats_update);
+
+/* Threaded function responsible for publishing the stats periodically */
+void *stats_publish_thread(void *void_args);
+
+#endif // SERVER_STATS_H
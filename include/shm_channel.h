@@ -0,0 +1,134 @@
+/* Defines the shared memory channel of the game-server: a POSIX shared memory
+ * segment with the game state and a ring of the latest game updates, which the
+ * displays of the same machine read instead of subscribing to the updates */
+
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#include "comms.h"
+#include "game_def.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Environment variable with the name of the segment (e.g. "/space-invaders").
+ * The server only creates it and the displays only read it when it is set,
+ * and the displays use zmq when it doesn't exist */
+#define SHM_ENV "SPACE_SHM"
+
+#define SHM_MAGIC "SPACESHM"
+#define SHM_VERSION 3
+
+/* Updates kept in the ring (a display that falls further behind reads the
+ * whole game again) */
+#define SHM_RING_SIZE 1024
+
+/* Aliens updates kept (they are too big for the ring) */
+#define SHM_ALIENS_SLOTS 4
+
+/* Time a display waits when there are no new updates (us) */
+#define SHM_POLL_US 500
+
+/*
+  Every entry has its own seqlock: the writer sets its sequence to
+  SHM_WRITING, writes the entry and then sets the sequence of the update. A
+  reader copies the entry and only uses the copy if the sequence is the one it
+  wants both before and after copying. The game has a seqlock counter that is
+  odd while it is written. The updates keep the sequence numbers of the ones
+  published with zmq, and the game tells the first update that isn't applied
+  to it, so a display can mix both. A restarted server reuses the segment and
+  its game has a new epoch (see update_header_t), so the displays that still
+  read it know the sequences started over.
+*/
+
+#define SHM_WRITING UINT64_MAX
+
+typedef struct {
+  /* Sequence of the update (SHM_WRITING while the entry is written) */
+  uint64_t sequence;
+  uint64_t sent_ns;
+  /* MESSAGE_TYPE */
+  uint32_t msg_type;
+  union {
+    action_request_t action_request;
+    disconnect_request_t disconnect_request;
+    /* Slot of an ALIENS_UPDATE */
+    uint32_t aliens_slot;
+  } data;
+} shm_update_t;
+
+typedef struct {
+  /* Sequence of the update (SHM_WRITING while the slot is written) */
+  uint64_t sequence;
+  aliens_update_t aliens_update;
+} shm_aliens_slot_t;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  /* Build configuration (only the same one can read it) */
+  int32_t space_size;
+  int32_t max_players;
+  int32_t n_aliens;
+  /* Seqlock counter of the game (odd while it is written) */
+  uint64_t game_lock;
+  /* Next aliens slot written */
+  uint32_t next_aliens_slot;
+  shm_update_t ring[SHM_RING_SIZE];
+  shm_aliens_slot_t aliens_slots[SHM_ALIENS_SLOTS];
+  /* The game sent to the displays when they connect */
+  display_connect_response_t game;
+} shm_segment_t;
+
+typedef struct shm_channel {
+  char *name;
+  shm_segment_t *segment;
+} shm_channel_t;
+
+typedef enum {
+  /* The update wasn't written yet */
+  SHM_NOT_YET,
+  SHM_READ,
+  /* The update was overwritten, the game must be read again */
+  SHM_LOST
+} SHM_READ_RESULT;
+
+/******************** Writer (game-server) ********************/
+
+/* Creates the segment with the first game state (exits if it can't) */
+shm_channel_t *shm_channel_create(const char *name, const game_t *game);
+
+/* Writes a game update already published with zmq (the caller serializes the
+ * writes, e.g. with io_lock) */
+void shm_channel_write_update(shm_channel_t *channel, MESSAGE_TYPE msg_type,
+                              const void *msg, uint64_t sequence);
+
+/* Writes the game state, in which the updates up to next_sequence are applied.
+ * aliens_changed tells if the aliens changed since the last one */
+void shm_channel_write_game(shm_channel_t *channel, const game_t *game,
+                            bool aliens_changed, uint64_t next_sequence);
+
+/* Unmaps and removes the segment */
+void shm_channel_destroy(shm_channel_t *channel);
+
+/******************** Readers (displays) ********************/
+
+/* Maps a segment to be read, returning NULL if it doesn't exist or is from a
+ * different build */
+const shm_segment_t *shm_channel_map(const char *name);
+
+/* Copies the game state (with the sequence of the next update to apply) */
+void shm_channel_read_game(const shm_segment_t *segment,
+                           display_connect_response_t *game);
+
+/* Copies the update with the given sequence (aliens_update receives the
+ * contents of an ALIENS_UPDATE) */
+SHM_READ_RESULT shm_channel_read_update(const shm_segment_t *segment,
+                                        uint64_t sequence,
+                                        shm_update_t *update,
+                                        aliens_update_t *aliens_update);
+
+/* Unmaps a segment mapped by shm_channel_map */
+void shm_channel_unmap(const shm_segment_t *segment);
+
+#endif // SHM_CHANNEL_H
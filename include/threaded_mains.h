@@ -1,13 +1,19 @@
 #ifndef THREADED_FUNCTIONS_H
 #define THREADED_FUNCTIONS_H
 
+#include "admission.h"
 #include "comms.h"
 #include "game_def.h"
+#include "lobby.h"
 #include "ncurses_wrapper.h"
+#include "render_queue.h"
+#include "shm_channel.h"
+#include "ui.h"
 #include "utils.h"
 #include "zeromq_wrapper.h"
 #include <ncurses.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <time.h>
@@ -15,12 +21,12 @@
 #include <zmq.h>
 
 typedef struct {
-  bool threaded;           /* Whether or not it is running in threaded mode */
-  bool *terminate_threads; /* Shared variable responsible for terminating all
-                              threads */
-  pthread_mutex_t
-      *ncurses_lock; /* The lock used to access ncurses in threaded mode */
-
+  void *zmq_context;              /* Shared by all the roles of the program */
+  ui_t *ui;                       /* Receives the draw commands of the roles */
+  atomic_bool *terminate_threads; /* Shared variable responsible for
+                                     terminating all threads */
+  lobby_placement_t *placement;   /* Shard of the astronaut, followed by the
+                                     display (NULL if not placed by a lobby) */
 } threaded_mains_args_t;
 
 /* Thread ready implementation of the astronaut client main */
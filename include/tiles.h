@@ -0,0 +1,121 @@
+/* Defines the tiles of the board: square areas with a topic each, where the
+ * game-server publishes the aliens in them, so a display only receives the
+ * aliens of the part of the board it shows */
+
+#ifndef TILES_H
+#define TILES_H
+
+#include "comms.h"
+#include "game_def.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Environment variable with the size of the tiles (the server only publishes
+ * them when it is set) */
+#define TILES_ENV "SPACE_TILE_SIZE"
+
+/* Smallest tile size (smaller ones cost a message per few cells) */
+#define TILES_MIN_SIZE 4
+
+/* Tile of the ALIENS_TILE_UPDATE that ends every tick (without aliens) */
+#define TILES_TICK_END -1
+
+/*
+  After every ALIENS_UPDATE, the server publishes an ALIENS_TILE_UPDATE on the
+  topic of each tile whose aliens changed (TILES_TOPIC + tile), with the same
+  update header, listing the aliens in the tile after the tick and the ones
+  that were in it before (dead or in another tile now). The tiles without
+  aliens, or whose aliens didn't move, are skipped. The tick then ends with
+  an ALIENS_TILE_UPDATE of TILES_TICK_END on PLAYER_UPDATES_TOPIC, so a
+  display receives every tick. The other game updates are also published on
+  PLAYER_UPDATES_TOPIC, as a zap crosses the whole board and the scores are of
+  the whole game.
+
+  A display subscribes to PLAYER_UPDATES_TOPIC and to the tiles of its
+  viewport instead of GAME_UPDATES_TOPIC. A tile without updates didn't
+  change, but only while the display was subscribed to it: the aliens of a
+  tile that comes into view are unknown until it changes, so they are removed
+  and then replaced by the ones listed (see tiles_view_follow).
+*/
+
+typedef struct tiles {
+  int tile_size;
+  int per_side;
+  int n_tiles;
+  /* Aliens listed on each tile in the current tick, and if any of them
+   * changed */
+  int *counts;
+  bool *changed;
+  /* Where the message of each tile starts in buffer */
+  size_t *offsets;
+  /* The messages of every tile, one after the other */
+  char *buffer;
+} tiles_t;
+
+/* Tiles of a display, with the ones it shows and the ones whose aliens are
+ * known (shown since they were last received) */
+typedef struct {
+  int tile_size;
+  int n_tiles;
+  /* Area shown (row, col, height and width), -1 if none yet */
+  int area[4];
+  bool *visible;
+  bool *known;
+} tiles_view_t;
+
+/******************** Board ********************/
+
+/* Returns the tile size set by TILES_ENV (within TILES_MIN_SIZE and the board
+ * size), or 0 if the board isn't split */
+int tiles_size_from_env();
+
+/* Returns the number of tiles on each side of the board */
+int tiles_per_side(int tile_size);
+
+/* Returns the tile of a board position */
+int tile_of(position_t position, int tile_size);
+
+/******************** Server ********************/
+
+/* Creates the tiles of the given size */
+tiles_t *tiles_create(int tile_size);
+
+/* Publishes the aliens of each tile after a tick (from the previous generation
+ * to the next one), with the header of its ALIENS_UPDATE */
+void tiles_publish_aliens(tiles_t *tiles, void *pub_socket,
+                          const aliens_update_t *previous,
+                          const aliens_update_t *next, int aliens_alive,
+                          const update_header_t *header);
+
+/* Frees the tiles */
+void tiles_destroy(tiles_t *tiles);
+
+/******************** Displays ********************/
+
+/* Subscribes to the tiles of a board area (height rows and width cols from
+ * row/col) and unsubscribes from the others, given the ones subscribed
+ * (updated). An empty area still gets its top left tile */
+void tiles_subscribe_area(void *sub_socket, int tile_size, int row, int col,
+                          int height, int width, bool *subscribed);
+
+/* Initializes the tiles of a display (all of them known) */
+void tiles_view_init(tiles_view_t *view, int tile_size);
+
+/* Marks every tile as known (the whole game was received) */
+void tiles_view_sync(tiles_view_t *view);
+
+/* Sets the area shown (the tiles subscribed to, as in tiles_subscribe_area),
+ * forgetting the tiles that aren't shown. Returns true if a tile shown isn't
+ * known, so its aliens must be removed until it is updated */
+bool tiles_view_follow(tiles_view_t *view, int row, int col, int height,
+                       int width);
+
+/* Marks a tile as updated, returning false if its aliens weren't known (they
+ * are replaced by the ones listed) */
+bool tiles_view_update(tiles_view_t *view, int tile);
+
+/* Frees the tiles of a display */
+void tiles_view_destroy(tiles_view_t *view);
+
+#endif // TILES_H
@@ -0,0 +1,60 @@
+/* Defines the tracepoints, compiled in with -DSPACE_TRACE ("make TRACE=1") and
+ * costing nothing otherwise */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+  Each thread records its events in its own ring buffer (only the newest
+  TRACE_RING_SIZE are kept), without any lock. The rings are written as a
+  Chrome trace (open with chrome://tracing or https://ui.perfetto.dev) when the
+  program exits or receives SIGUSR1.
+
+  Usage:
+    TRACE_INIT("game-server");      once in main, before creating threads
+    TRACE_THREAD_NAME("aliens");    optional, names the calling thread
+    TRACE_BEGIN("tick");            starts a span (names must be literals)
+    TRACE_END("tick");              ends the last span started by the thread
+*/
+#ifdef SPACE_TRACE
+
+#include <stdint.h>
+
+/* Events kept per thread (must be a power of 2) */
+#define TRACE_RING_SIZE 16384
+
+/* Maximum number of rings (threads that exit give their ring to new ones) */
+#define TRACE_MAX_THREADS 128
+
+/* Environment variable with the path of the trace file (by default
+ * "trace-<program>-<pid>.json" on the current directory) */
+#define TRACE_FILE_ENV "SPACE_TRACE_FILE"
+
+#define TRACE_INIT(program) trace_init(program)
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+#define TRACE_BEGIN(name) trace_record(name, 'B')
+#define TRACE_END(name) trace_record(name, 'E')
+
+/* Starts the tracer: blocks SIGUSR1 (threads created later inherit it), waits
+ * for it on a thread that dumps the trace and dumps it again at exit */
+void trace_init(const char *program);
+
+/* Names the calling thread on the trace */
+void trace_thread_name(const char *name);
+
+/* Records an event of the calling thread (phase is the Chrome trace one) */
+void trace_record(const char *name, char phase);
+
+/* Writes every ring to the trace file */
+void trace_dump();
+
+#else
+
+#define TRACE_INIT(program) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+
+#endif // SPACE_TRACE
+
+#endif // TRACE_H
@@ -0,0 +1,86 @@
+#ifndef UI_H
+#define UI_H
+
+#include "comms.h"
+#include "game_def.h"
+#include "histogram.h"
+#include "ncurses_wrapper.h"
+#include "render_queue.h"
+#include "utils.h"
+#include <ncurses.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* How long the roles wait for input before checking if they should stop */
+#define UI_INPUT_POLL_MS 100
+
+/* Maximum number of roles a program can run */
+#define UI_MAX_ROLES 2
+
+/* Environment variable that shows the latency overlay below the scoreboard */
+#define UI_LATENCY_OVERLAY_ENV "SPACE_LATENCY_OVERLAY"
+
+/* Maximum number of game updates applied before repainting the screen */
+#define UI_MAX_PENDING_UPDATES 256
+
+/*
+  The UI is owned by a single thread (the main one), which is the only one
+  using the render backend and holding the game state shown on the screen.
+  The roles (astronaut client and outer space display) send it draw commands
+  through the render queue.
+*/
+typedef struct {
+  render_queue_t render_queue;
+  /* Draws the game and scoreboard windows */
+  bool has_display;
+  /* Draws the astronaut window (and the astronaut reads the keyboard) */
+  bool has_astronaut;
+  /* Readiness handshake (set after the render backend is initialized) */
+  pthread_mutex_t ready_lock;
+  pthread_cond_t ready_cond;
+  bool ready;
+  /* Latency of the game updates since the server published them, until the
+   * display role received them and until they were on the screen (only
+   * used by the UI thread and dumped when it stops) */
+  histogram_t receive_lag;
+  histogram_t render_lag;
+  /* Game updates that never arrived (gaps in their sequence) */
+  uint64_t missed_updates;
+  /* The viewport, packed as 16 bits for each of row, col, height and width
+   * (written by the UI thread, read by the display role to choose the tiles
+   * it subscribes to) */
+  _Atomic uint64_t visible_area;
+} ui_t;
+
+/* Initializes the UI state (the render backend is only initialized by
+ * ui_main) */
+void ui_init(ui_t *ui, bool has_display, bool has_astronaut);
+
+/* Runs the UI loop on the calling thread until every role is done */
+void ui_main(ui_t *ui);
+
+/* Blocks until the UI thread initialized the render backend (and the
+ * terminal) */
+void ui_wait_ready(ui_t *ui);
+
+/* Tells the UI thread that a role stopped, with an optional message to print
+ * once the render backend is closed */
+void ui_role_done(ui_t *ui, char *message);
+
+/* Destroys the UI state */
+void ui_destroy(ui_t *ui);
+
+/* Returns the part of the board shown on the screen (it changes as the
+ * viewport is scrolled or follows the player) */
+viewport_t ui_visible_area(ui_t *ui);
+
+/* Reads a key directly from the terminal (arrows are converted to the ncurses
+ * KEY_* values), returning ERR if none was pressed within timeout_ms */
+int ui_read_key(int timeout_ms);
+
+#endif // UI_H
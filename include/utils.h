@@ -1,82 +1,114 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "game_clock.h"
+#include "game_core.h"
 #include "game_def.h"
 #include "ncurses_wrapper.h"
+#include "render_queue.h"
+#include "tiles.h"
 #include "zeromq_wrapper.h"
 #include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 /******************** Client requests handling ********************/
 
 /* Handles the state and screen updates when a player connects */
 void handle_player_connect(
-    WINDOW *game_window,
+    nc_window_t *game_window,
     astronaut_connect_response_t *astronaut_connect_response, int *tokens,
     game_t *game);
 
-/* Handles the state and screen updates when a player makes an action */
+/* Handles the state and screen updates when a player makes an action on the
+ * game game points to (the zap is cleaned using the locks or, if not NULL,
+ * the render queue, and game is only kept by the cleaning thread in the first
+ * case). The aliens killed are added to kills if it isn't NULL */
 void handle_player_action(action_request_t *action_request,
-                          player_t *current_player, WINDOW *game_window,
-                          game_t *game, pthread_mutex_t *lock);
+                          player_t *current_player, nc_window_t *game_window,
+                          game_t **game, aliens_kills_t *kills,
+                          pthread_mutex_t *lock, pthread_mutex_t *io_lock,
+                          render_queue_t *render_queue);
 
 /* Handles the state and screen updates when a player disconnects */
-void handle_player_disconnect(WINDOW *game_window, player_t *current_player);
+void handle_player_disconnect(nc_window_t *game_window, game_t *game,
+                              int player_id);
+
+/* Handles the state and screen updates when a new round starts (the whole game
+ * state is replaced) */
+void handle_new_round(nc_window_t *game_window,
+                      display_connect_response_t *round_started,
+                      game_t *game);
 
 /* Handles the state and screen updates when the aliens positions are updated */
-void handle_aliens_updates(WINDOW *game_window,
+void handle_aliens_updates(nc_window_t *game_window,
                            aliens_update_t *alien_update_request, game_t *game);
 
+/* Handles the state and screen updates when the aliens of a tile are updated
+ * (see include/tiles.h) */
+void handle_aliens_tile_update(nc_window_t *game_window,
+                               aliens_tile_update_t *tile_update,
+                               tiles_view_t *view, game_t *game);
+
+/* Handles the state and screen updates when the viewport moved: the aliens of
+ * the tiles that came into view aren't known, so they are removed until their
+ * tile is updated (see tiles_view_follow) */
+void handle_tiles_shown(nc_window_t *game_window, tiles_view_t *view,
+                        game_t *game);
+
 /******************** Aliens management ********************/
 
 /* Threaded function responsible for updating the aliens */
 void *aliens_update_thread(void *void_args);
 
-/* Places the alien on the board */
-void place_alien(alien_t *alien);
-
 /******************** Player management ********************/
 
-/* Places the player on the board */
-void place_player(player_t *player);
-
-/* Finds an available position for a player and initializes it */
-int find_position_and_init_player(game_t *game, int *tokens);
-
-/* Updates state when a player zaps and kills the aliens */
-void player_zap(WINDOW *win, game_t *game, int player_id);
-
 /* Threaded function responsible for cleaning the zap after sleeping */
 void *clean_zap_thread(void *void_args);
 
-/* Spawns the thread to clean the zap */
+/* Spawns the thread to clean the zap (if render_queue isn't NULL the thread
+ * sends the clean command to the UI thread instead of using the locks, and
+ * game must be NULL, as it may not outlive the call) */
 void spawn_clean_zap_thread(MOVEMENT_ORIENTATION orientation, int index,
-                            game_t *game, WINDOW *game_window,
-                            pthread_mutex_t *lock);
+                            game_t **game, nc_window_t *game_window,
+                            pthread_mutex_t *lock, pthread_mutex_t *io_lock,
+                            render_queue_t *render_queue);
 
 /******************** Miscellaneous ********************/
 
-/* Inits all the players and aliens on the board */
-void init_game(game_t *game, int *tokens);
-
-/* Update the position of a player or alien */
-void update_position(position_t *position, MOVEMENT_DIRECTION direction);
+/* Publishes a game update and, if shm isn't NULL, writes it to the shared
+ * memory channel with the same sequence. If tiles isn't NULL, the updates of
+ * the players are also published on PLAYER_UPDATES_TOPIC */
+void publish_game_update(void *pub_socket, struct shm_channel *shm,
+                         struct tiles *tiles, MESSAGE_TYPE msg_type,
+                         void *msg);
 
 /* Copies the game state to the connect reply */
 void copy_game_state_for_display(display_connect_response_t *response,
-                                 game_t *game);
+                                 const game_t *game);
 
 /* Finds and prints the winning player */
 void print_winning_player(game_t *game);
 
-/* Converts an ID to a symbol */
+/* Converts an ID to the symbol drawn on the board (the ids after the last
+ * symbol reuse them) */
 char id_to_symbol(int id);
 
-/* Returns the current timestamp in ms since epoch */
-uint64_t get_timestamp_ms();
+/* Writes the name of a player on the scoreboards into label (at least
+ * PLAYER_LABEL_SIZE bytes): its symbol, followed by how many times the symbols
+ * were reused before it (e.g. "A", then "A1" when there are more players than
+ * symbols). Returns label */
+char *id_to_label(int id, char *label);
+
+/* Returns the time in ns of the monotonic clock (only comparable between
+ * processes of the same machine) */
+uint64_t get_monotonic_ns();
+
+/* Returns a connect request with a new random client id (see
+ * astronaut_connect_request_t) */
+astronaut_connect_request_t new_connect_request();
 
 #endif // UTILS_H
\ No newline at end of file
@@ -6,13 +6,20 @@
 #include "utils.h"
 
 /* Validates the connect request and returns the status code  */
-int validate_connect_request(game_t game);
+int validate_connect_request(const game_t *game);
+
+/* Returns the player connected by the client of a connect request if the
+ * request was already applied (e.g. resent while the server restarted), or -1
+ * if it wasn't */
+int find_resent_connect(astronaut_connect_request_t request,
+                        const game_t *game, const uint64_t *client_ids);
 
 /* Validates the action request and returns the status code */
-int validate_action_request(action_request_t request, game_t game, int *tokens,
+int validate_action_request(action_request_t request, const game_t *game,
+                            const int *tokens,
                             action_response_t *action_response);
 
 /* Validates  the request and returns status code */
-int validate_disconnect_request(disconnect_request_t request, game_t game,
-                                int *tokens);
+int validate_disconnect_request(disconnect_request_t request,
+                                const game_t *game, const int *tokens);
 #endif // VALIDATORS_H
\ No newline at end of file
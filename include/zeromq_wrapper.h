@@ -9,6 +9,11 @@
 #include <string.h>
 #include <zmq.h>
 
+/* Time waiting for each reply of zmq_request, and how many times the request is
+ * sent before giving up (enough for the game-server to restart) */
+#define REQUEST_TIMEOUT_MS 2000
+#define REQUEST_ATTEMPTS 5
+
 /******************** Socket creation and initialization ********************/
 
 /* Initializes zmq and gets context */
@@ -26,6 +31,21 @@ void zmq_connect_socket(void *socket, char *address);
 /* Subscribe to publisher */
 void zmq_subscribe(void *socket, PUBSUB_TOPICS topic);
 
+/* Unsubscribe from a topic of the publisher */
+void zmq_unsubscribe(void *socket, PUBSUB_TOPICS topic);
+
+/* Returns the address in the environment variable env or, if not set,
+ * default_address */
+char *zmq_address_from_env(const char *env, char *default_address);
+
+/* Returns the REQREP address the clients connect to (SERVER_REQREP_ENV or
+ * SERVER_ZMQ_REQREP_ADDRESS) */
+char *zmq_server_reqrep_address();
+
+/* Returns the PUBSUB address the clients connect to (SERVER_PUBSUB_ENV or
+ * SERVER_ZMQ_PUBSUB_ADDRESS) */
+char *zmq_server_pubsub_address();
+
 /******************** Sending and receiving messages ********************/
 
 /*
@@ -38,20 +58,56 @@ If topic==NOTOPIC then no topic is expected
 void *zmq_receive_msg(void *socket, MESSAGE_TYPE *msg_type,
                       PUBSUB_TOPICS topic);
 
+/* Same as zmq_receive_msg, but also returns the update header of the
+ * GAME_UPDATES_TOPIC messages (discarded when header==NULL). The messages of
+ * PLAYER_UPDATES_TOPIC and the tile topics have it too */
+void *zmq_receive_stamped_msg(void *socket, MESSAGE_TYPE *msg_type,
+                              PUBSUB_TOPICS topic, update_header_t *header);
+
 /* Send messages, first the type then the actual message.
 
   If msg_size==-1, then it uses the get_msg_size function to get the size
   If topic==NOTOPIC then no topic is sent at the beggining
+  If topic==GAME_UPDATES_TOPIC then the update header is sent after the topic
 */
 void zmq_send_msg(void *socket, MESSAGE_TYPE msg_type, void *msg, int msg_size,
                   PUBSUB_TOPICS topic);
 
+/* Same as zmq_send_msg, but the messages of PLAYER_UPDATES_TOPIC and the tile
+ * topics carry the given update header (the one of a GAME_UPDATES_TOPIC
+ * message is always a new one) */
+void zmq_send_stamped_msg(void *socket, MESSAGE_TYPE msg_type, void *msg,
+                          int msg_size, PUBSUB_TOPICS topic,
+                          const update_header_t *header);
+
+/* Sends a request and waits for the reply, resending it on a new socket (a REQ
+ * socket can't send again before receiving) when the server doesn't reply in
+ * REQUEST_TIMEOUT_MS, e.g. while it restarts. Returns NULL if none of the
+ * REQUEST_ATTEMPTS got a reply. A request may be applied twice if only its
+ * reply was lost */
+void *zmq_request(void **req_socket, void *context, char *address,
+                  MESSAGE_TYPE request_type, void *request,
+                  MESSAGE_TYPE *reply_type);
+
+/* Starts a new epoch of the game updates, from the real time clock so a
+ * server restarted gets another one (called before publishing any) */
+void zmq_start_update_epoch();
+
+/* Returns the epoch of the game updates published */
+uint64_t zmq_update_epoch();
+
+/* Returns the sequence of the next game update published */
+uint64_t zmq_next_update_sequence();
+
+/* Returns the header of the last game update published */
+update_header_t zmq_last_update_header();
+
 /* Broadcasts the scores updates messages using protobuf protocol */
 void zmq_broadcast_scores_updates(void *pub_socket, game_t *game);
 
 /******************** Cleanup ********************/
 
-/* Cleanup zmq */
+/* Cleanup zmq (sockets and context are only closed if not NULL) */
 void zmq_cleanup(void *context, void *socket1, void *socket2);
 
 /******************** Utilities ********************/
@@ -2,10 +2,29 @@
 
 int main() {
   threaded_mains_args_t args;
-  args.threaded = false;
-  args.ncurses_lock = NULL;
-  args.terminate_threads = NULL;
+  ui_t ui;
+  atomic_bool terminate_threads = false;
+  pthread_t astronaut_client;
+
+  /* Before any thread is created (see include/trace.h) */
+  TRACE_INIT("astronaut-client");
+  game_clock_init();
+  ui_init(&ui, false, true);
+  args.zmq_context = zmq_get_context();
+  args.ui = &ui;
+  args.terminate_threads = &terminate_threads;
+  args.placement = NULL;
+
+  assert(pthread_create(&astronaut_client, NULL, astronaut_client_main,
+                        &args) == 0);
+
+  /* The main thread owns the screen */
+  ui_main(&ui);
+
+  pthread_join(astronaut_client, NULL);
+
+  ui_destroy(&ui);
+  zmq_cleanup(args.zmq_context, NULL, NULL);
 
-  astronaut_client_main(&args);
   return 0;
-}
\ No newline at end of file
+}
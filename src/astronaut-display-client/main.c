@@ -2,30 +2,37 @@
 
 int main() {
   threaded_mains_args_t args;
-  pthread_mutex_t ncurses_lock;
-  bool terminate_threads = false;
+  ui_t ui;
+  atomic_bool terminate_threads = false;
+  lobby_placement_t placement = {0};
   pthread_t astronaut_client, outer_space_display;
 
-  assert(pthread_mutex_init(&ncurses_lock, NULL) == 0);
-  args.threaded = true;
-  args.ncurses_lock = &ncurses_lock;
+  /* Before any thread is created (see include/trace.h) */
+  TRACE_INIT("astronaut-display-client");
+  game_clock_init();
+
+  /* Both roles share the zmq context and send their draw commands to the UI
+   * thread, which only lets them read the terminal once it is initialized */
+  ui_init(&ui, true, true);
+  args.zmq_context = zmq_get_context();
+  args.ui = &ui;
   args.terminate_threads = &terminate_threads;
+  /* The display waits for the astronaut to be placed on a shard */
+  args.placement = getenv(LOBBY_ENV) != NULL ? &placement : NULL;
 
   assert(pthread_create(&outer_space_display, NULL, outer_space_display_main,
                         &args) == 0);
-
-  /* The astronaut client should only start after the outer space display
-   * is initialized, however, as active wait cant be used (to wait for a flag
-   * for example) sleep a bit to allow it to finish */
-  usleep(250000); // 0.25 s
-
   assert(pthread_create(&astronaut_client, NULL, astronaut_client_main,
                         &args) == 0);
 
+  /* The main thread owns the screen */
+  ui_main(&ui);
+
   pthread_join(astronaut_client, NULL);
   pthread_join(outer_space_display, NULL);
 
-  pthread_mutex_destroy(&ncurses_lock);
+  ui_destroy(&ui);
+  zmq_cleanup(args.zmq_context, NULL, NULL);
 
   return 0;
-}
\ No newline at end of file
+}
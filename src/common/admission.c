@@ -0,0 +1,109 @@
+/* Contains the admission control of the game-server (see
+ * include/admission.h) */
+
+#include "admission.h"
+#include "utils.h"
+#include <stdlib.h>
+
+/* Returns the rate in the environment variable env or, if not set,
+ * default_rate */
+static int rate_from_env(const char *env, int default_rate) {
+  const char *rate_env = getenv(env);
+  int rate = rate_env != NULL ? atoi(rate_env) : default_rate;
+
+  return rate > 0 ? rate : 0;
+}
+
+/* Initializes a bucket with the given requests per second (0 for no limit) */
+void token_bucket_init(token_bucket_t *bucket, int rate) {
+  bucket->interval_ns = rate > 0 ? 1000000000ULL / rate : 0;
+  bucket->capacity_ns = rate > 0 ? ADMISSION_BURST_S * 1000000000ULL : 0;
+  bucket->full_ns = 0;
+}
+
+/* Takes a token, returning false (and the ns until there is one in retry_ns)
+ * if the bucket is empty */
+bool token_bucket_take(token_bucket_t *bucket, uint64_t now_ns,
+                       uint64_t *retry_ns) {
+  uint64_t full_ns;
+
+  if (bucket->interval_ns == 0)
+    return true;
+
+  full_ns = bucket->full_ns > now_ns ? bucket->full_ns : now_ns;
+  full_ns += bucket->interval_ns;
+  if (full_ns - now_ns > bucket->capacity_ns) {
+    *retry_ns = full_ns - now_ns - bucket->capacity_ns;
+    return false;
+  }
+
+  bucket->full_ns = full_ns;
+  return true;
+}
+
+/* Initializes the limits from the environment */
+void admission_init(admission_t *admission) {
+  int player_rate =
+      rate_from_env(ADMISSION_PLAYER_RATE_ENV, ADMISSION_PLAYER_RATE);
+
+  for (int i = 0; i < MAX_PLAYERS; i++)
+    token_bucket_init(&admission->players[i], player_rate);
+  token_bucket_init(&admission->invalid, player_rate);
+  token_bucket_init(
+      &admission->connects,
+      rate_from_env(ADMISSION_CONNECT_RATE_ENV, ADMISSION_CONNECT_RATE));
+
+  admission->window_start_ns = get_monotonic_ns();
+  admission->window_idle_ns = 0;
+  admission->overloaded = false;
+}
+
+/* Records the time the main loop waited for a request (from wait_start_ns to
+ * received_ns), ending the window when it is over */
+void admission_record_wait(admission_t *admission, uint64_t wait_start_ns,
+                           uint64_t received_ns) {
+  uint64_t elapsed_ns = received_ns - admission->window_start_ns;
+
+  admission->window_idle_ns += received_ns - wait_start_ns;
+  if (elapsed_ns < ADMISSION_WINDOW_MS * 1000000ULL)
+    return;
+
+  /* Busy for the percentage of the window it wasn't waiting */
+  admission->overloaded =
+      admission->window_idle_ns * 100 <
+      elapsed_ns * (100 - ADMISSION_BUSY_PERCENTAGE);
+  admission->window_start_ns = received_ns;
+  admission->window_idle_ns = 0;
+}
+
+/* Checks if a request received at now_ns is admitted, given the tokens of the
+ * players. If it isn't, retry_ns has the time until it would be */
+bool admission_admit(admission_t *admission, MESSAGE_TYPE msg_type,
+                     const void *request, const int *tokens, uint64_t now_ns,
+                     uint64_t *retry_ns) {
+  const action_request_t *action_request;
+
+  switch (msg_type) {
+  case DISPLAY_CONNECT_REQUEST:
+  case ASTRONAUT_CONNECT_REQUEST:
+    /* New load is the first to go when the server can't keep up */
+    if (admission->overloaded) {
+      *retry_ns = ADMISSION_WINDOW_MS * 1000000ULL;
+      return false;
+    }
+    return token_bucket_take(&admission->connects, now_ns, retry_ns);
+
+  case ACTION_REQUEST:
+    action_request = (const action_request_t *)request;
+    /* Only the requests of the player count against its limit, the rest
+     * share one */
+    if (action_request->id < 0 || action_request->id >= MAX_PLAYERS ||
+        tokens[action_request->id] != action_request->token)
+      return token_bucket_take(&admission->invalid, now_ns, retry_ns);
+    return token_bucket_take(&admission->players[action_request->id], now_ns,
+                             retry_ns);
+
+  default:
+    return true;
+  }
+}
@@ -0,0 +1,137 @@
+/* Contains the pool of threads that move the aliens (see
+ * include/aliens_pool.h) */
+
+#include "aliens_pool.h"
+#include "trace.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Returns the first alien of a worker's range (a multiple of
+ * ALIENS_RANGE_ALIGN aliens). The update isn't cache line aligned, so two
+ * workers can still write to the cache line at the end of a range, but the
+ * ranges keep the same offset in their cache lines */
+static int range_start(int n_workers, int index) {
+  int start = (int)((int64_t)N_ALIENS * index / n_workers);
+
+  return index == n_workers ? N_ALIENS : start - start % ALIENS_RANGE_ALIGN;
+}
+
+/* Moves the range of a worker for the current tick */
+static void move_range(aliens_pool_t *pool, int index) {
+  aliens_move_range(pool->aliens, pool->aliens_update, &pool->rng,
+                    range_start(pool->n_workers, index),
+                    range_start(pool->n_workers, index + 1));
+}
+
+/* Threaded function of each worker but the first one */
+static void *aliens_worker_thread(void *void_args) {
+  aliens_worker_t *worker = (aliens_worker_t *)void_args;
+  aliens_pool_t *pool = worker->pool;
+  uint64_t last_tick = 0;
+
+  TRACE_THREAD_NAME("aliens worker");
+
+  pthread_mutex_lock(&pool->lock);
+  while (true) {
+    while (pool->tick == last_tick && !pool->stopping)
+      pthread_cond_wait(&pool->work_ready, &pool->lock);
+    if (pool->stopping)
+      break;
+    last_tick = pool->tick;
+    pthread_mutex_unlock(&pool->lock);
+
+    TRACE_BEGIN("move");
+    move_range(pool, worker->index);
+    TRACE_END("move");
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->working == 0)
+      pthread_cond_signal(&pool->work_done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+/* Returns the number of workers set by ALIEN_WORKERS_ENV or, if not set, the
+ * default for the board size and the cores */
+int aliens_pool_default_workers() {
+  const char *workers_env = getenv(ALIEN_WORKERS_ENV);
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int n_workers = N_ALIENS / ALIENS_PER_WORKER;
+
+  if (workers_env != NULL)
+    n_workers = atoi(workers_env);
+  else if (n_workers > cores)
+    n_workers = (int)cores;
+
+  if (n_workers < 1)
+    return 1;
+  return n_workers < MAX_ALIEN_WORKERS ? n_workers : MAX_ALIEN_WORKERS;
+}
+
+/* Starts a pool with n_workers (including the caller of aliens_pool_move) */
+aliens_pool_t *aliens_pool_create(int n_workers) {
+  aliens_pool_t *pool = (aliens_pool_t *)calloc(1, sizeof(aliens_pool_t));
+
+  assert(pool != NULL);
+  assert(n_workers >= 1 && n_workers <= MAX_ALIEN_WORKERS);
+
+  pool->n_workers = n_workers;
+  assert(pthread_mutex_init(&pool->lock, NULL) == 0);
+  assert(pthread_cond_init(&pool->work_ready, NULL) == 0);
+  assert(pthread_cond_init(&pool->work_done, NULL) == 0);
+
+  for (int i = 1; i < n_workers; i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].index = i;
+    assert(pthread_create(&pool->threads[i], NULL, aliens_worker_thread,
+                          &pool->workers[i]) == 0);
+  }
+
+  return pool;
+}
+
+/* Same as aliens_move, splitting the aliens between the workers */
+void aliens_pool_move(aliens_pool_t *pool, const alien_t *aliens,
+                      aliens_update_t *aliens_update, game_rng_t *rng) {
+  if (pool->n_workers == 1) {
+    aliens_move(aliens, aliens_update, rng);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->aliens = aliens;
+  pool->aliens_update = aliens_update;
+  pool->rng = *rng;
+  pool->working = pool->n_workers - 1;
+  pool->tick++;
+  pthread_cond_broadcast(&pool->work_ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  move_range(pool, 0);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->working > 0)
+    pthread_cond_wait(&pool->work_done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+
+  game_rng_skip(rng, N_ALIENS);
+}
+
+/* Stops the workers and frees the pool */
+void aliens_pool_destroy(aliens_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->work_ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (int i = 1; i < pool->n_workers; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->work_ready);
+  pthread_cond_destroy(&pool->work_done);
+  free(pool);
+}
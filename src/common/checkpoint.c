@@ -0,0 +1,153 @@
+/* Contains the checkpoints of the game-server (see include/checkpoint.h) */
+
+#include "checkpoint.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Returns the hash of the contents of a slot (FNV-1a over 64 bit words) */
+static uint64_t slot_hash(const checkpoint_slot_t *slot) {
+  const uint8_t *start = (const uint8_t *)&slot->rng;
+  size_t size = sizeof(checkpoint_slot_t) - offsetof(checkpoint_slot_t, rng);
+  uint64_t hash = 0xcbf29ce484222325, word;
+
+  for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    memcpy(&word, start + i, sizeof(uint64_t));
+    hash = (hash ^ word) * 0x100000001b3;
+  }
+  for (size_t i = size - size % sizeof(uint64_t); i < size; i++)
+    hash = (hash ^ start[i]) * 0x100000001b3;
+
+  return hash;
+}
+
+/* Checks if a slot has a complete checkpoint */
+static bool slot_valid(const checkpoint_slot_t *slot) {
+  return slot->sequence != 0 && slot->hash == slot_hash(slot);
+}
+
+/* Opens (or creates) the checkpoint file, exiting if it can't or if it was
+ * created by a different build */
+checkpoint_t *checkpoint_open(const char *path) {
+  checkpoint_t *checkpoint = (checkpoint_t *)calloc(1, sizeof(checkpoint_t));
+  checkpoint_file_t *file;
+  struct stat file_stat;
+  bool created;
+
+  assert(checkpoint != NULL);
+
+  checkpoint->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (checkpoint->fd == -1 || fstat(checkpoint->fd, &file_stat) != 0) {
+    printf("Couldn't open the checkpoint file %s.\n", path);
+    exit(-1);
+  }
+
+  created = file_stat.st_size == 0;
+  if (created)
+    assert(ftruncate(checkpoint->fd, sizeof(checkpoint_file_t)) == 0);
+  else if ((size_t)file_stat.st_size != sizeof(checkpoint_file_t)) {
+    printf("%s isn't a checkpoint of this build (SPACE_SIZE=%d).\n", path,
+           SPACE_SIZE);
+    exit(-1);
+  }
+
+  file = (checkpoint_file_t *)mmap(NULL, sizeof(checkpoint_file_t),
+                                   PROT_READ | PROT_WRITE, MAP_SHARED,
+                                   checkpoint->fd, 0);
+  assert(file != MAP_FAILED);
+  checkpoint->file = file;
+  assert(pthread_mutex_init(&checkpoint->lock, NULL) == 0);
+
+  if (created) {
+    memcpy(file->magic, CHECKPOINT_MAGIC, sizeof(file->magic));
+    file->version = CHECKPOINT_VERSION;
+    file->space_size = SPACE_SIZE;
+    file->max_players = MAX_PLAYERS;
+    file->n_aliens = N_ALIENS;
+    file->latest_slot = 0;
+  } else if (memcmp(file->magic, CHECKPOINT_MAGIC, sizeof(file->magic)) != 0 ||
+             file->version != CHECKPOINT_VERSION ||
+             file->space_size != SPACE_SIZE ||
+             file->max_players != MAX_PLAYERS || file->n_aliens != N_ALIENS) {
+    printf("%s isn't a checkpoint of this build (SPACE_SIZE=%d).\n", path,
+           SPACE_SIZE);
+    exit(-1);
+  }
+
+  return checkpoint;
+}
+
+/* Restores the latest valid checkpoint, returning false if there isn't one */
+bool checkpoint_restore(checkpoint_t *checkpoint, game_t *game, int *tokens,
+                        uint64_t *client_ids, game_rng_t *rng) {
+  checkpoint_file_t *file = checkpoint->file;
+  checkpoint_slot_t *slot = &file->slots[file->latest_slot % 2];
+
+  /* The latest one might not have reached the disk */
+  if (!slot_valid(slot))
+    slot = &file->slots[(file->latest_slot + 1) % 2];
+  if (!slot_valid(slot))
+    return false;
+
+  memcpy(game, &slot->game, sizeof(game_t));
+  memcpy(tokens, slot->tokens, sizeof(slot->tokens));
+  memcpy(client_ids, slot->client_ids, sizeof(slot->client_ids));
+  *rng = slot->rng;
+
+  return true;
+}
+
+/* Saves a checkpoint of a snapshot, unless a newer one was already saved (it
+ * can be called by any thread, without the game lock) */
+void checkpoint_save(checkpoint_t *checkpoint, const game_snapshot_t *snapshot,
+                     uint64_t ts) {
+  checkpoint_file_t *file = checkpoint->file;
+  uint32_t latest;
+  checkpoint_slot_t *slot;
+
+  pthread_mutex_lock(&checkpoint->lock);
+
+  /* A thread that saves a newer snapshot may have got here first */
+  if (snapshot->version <= checkpoint->saved_version) {
+    pthread_mutex_unlock(&checkpoint->lock);
+    return;
+  }
+
+  latest = file->latest_slot % 2;
+  slot = &file->slots[1 - latest];
+  slot->sequence = file->slots[latest].sequence + 1;
+  slot->saved_ts = ts;
+  slot->rng = snapshot->rng;
+  memcpy(slot->tokens, snapshot->tokens, sizeof(slot->tokens));
+  memcpy(slot->client_ids, snapshot->client_ids, sizeof(slot->client_ids));
+  memcpy(&slot->game, &snapshot->game, sizeof(game_t));
+  slot->hash = slot_hash(slot);
+
+  /* Only now the new checkpoint replaces the previous one */
+  __atomic_store_n(&file->latest_slot, 1 - latest, __ATOMIC_RELEASE);
+  checkpoint->saved_version = snapshot->version;
+
+  /* Let the kernel write it to the disk in the background */
+  msync(file, sizeof(checkpoint_file_t), MS_ASYNC);
+  pthread_mutex_unlock(&checkpoint->lock);
+}
+
+/* Closes the file, discarding the checkpoints if the match ended (so the next
+ * server starts a new one) */
+void checkpoint_close(checkpoint_t *checkpoint, bool match_ended) {
+  if (match_ended) {
+    checkpoint->file->slots[0].sequence = 0;
+    checkpoint->file->slots[1].sequence = 0;
+  }
+
+  assert(munmap(checkpoint->file, sizeof(checkpoint_file_t)) == 0);
+  close(checkpoint->fd);
+  pthread_mutex_destroy(&checkpoint->lock);
+  free(checkpoint);
+}
@@ -0,0 +1,114 @@
+/* Contains the clocks used by the game rules */
+
+#include "game_clock.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The clock used (monotonic until game_clock_init) and its state */
+static const game_clock_t *active_clock = &game_clock_monotonic;
+static atomic_uint_fast64_t cached_ms;
+static double virtual_speed = 1;
+static atomic_uint_fast64_t virtual_offset_ms;
+
+/* Returns the time of the monotonic clock in ns */
+static uint64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/******************** Clocks ********************/
+
+static uint64_t monotonic_now_ms() { return monotonic_ns() / 1000000; }
+
+/* Used by the clocks that are always up to date */
+static void no_refresh() {}
+
+static uint64_t cached_now_ms() {
+  return atomic_load_explicit(&cached_ms, memory_order_relaxed);
+}
+
+/* Stores the current time, unless another thread stored a later one */
+static void cached_refresh() {
+  uint64_t now_ms = monotonic_now_ms();
+  uint64_t old_ms = atomic_load_explicit(&cached_ms, memory_order_relaxed);
+
+  while (old_ms < now_ms &&
+         !atomic_compare_exchange_weak_explicit(&cached_ms, &old_ms, now_ms,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+    ;
+}
+
+static uint64_t virtual_now_ms() {
+  return (uint64_t)(monotonic_ns() * virtual_speed / 1e6) +
+         atomic_load_explicit(&virtual_offset_ms, memory_order_relaxed);
+}
+
+const game_clock_t game_clock_monotonic = {
+    .name = "monotonic", .now_ms = monotonic_now_ms, .refresh = no_refresh};
+
+const game_clock_t game_clock_cached = {
+    .name = "cached", .now_ms = cached_now_ms, .refresh = cached_refresh};
+
+const game_clock_t game_clock_virtual = {
+    .name = "virtual", .now_ms = virtual_now_ms, .refresh = no_refresh};
+
+/******************** Interface ********************/
+
+/* Chooses the clock from the environment variables (exits if unknown) */
+void game_clock_init() {
+  const char *name = getenv(GAME_CLOCK_ENV);
+  const char *speed = getenv(GAME_CLOCK_SPEED_ENV);
+
+  game_clock_use(name != NULL ? name : game_clock_cached.name,
+                 speed != NULL ? atof(speed) : 1);
+}
+
+/* Chooses the clock by name (speed is only used by the virtual clock) */
+void game_clock_use(const char *name, double speed) {
+  const game_clock_t *clocks[] = {&game_clock_monotonic, &game_clock_cached,
+                                  &game_clock_virtual};
+
+  active_clock = NULL;
+  for (size_t i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+    if (strcmp(clocks[i]->name, name) == 0)
+      active_clock = clocks[i];
+  }
+
+  if (active_clock == NULL || speed < 0) {
+    printf("Unknown clock '%s' or speed %g (use monotonic, cached or virtual "
+           "with a speed >= 0).\n",
+           name, speed);
+    exit(-1);
+  }
+
+  virtual_speed = speed;
+  game_clock_refresh();
+}
+
+/* Returns the current time (ms) */
+uint64_t game_clock_now_ms() { return active_clock->now_ms(); }
+
+/* Reads the time again, called once per event handled */
+void game_clock_refresh() { active_clock->refresh(); }
+
+/* Moves the virtual clock forward */
+void game_clock_advance_ms(uint64_t ms) {
+  atomic_fetch_add_explicit(&virtual_offset_ms, ms, memory_order_relaxed);
+}
+
+/* Sleeps for a time of the clock (a virtual clock with speed 0 is advanced
+ * instead) */
+void game_clock_sleep_ms(uint64_t ms) {
+  if (active_clock != &game_clock_virtual)
+    usleep(ms * 1000);
+  else if (virtual_speed > 0)
+    usleep((useconds_t)(ms * 1000 / virtual_speed));
+  else
+    game_clock_advance_ms(ms);
+}
@@ -0,0 +1,464 @@
+/* Contains the game rules, which only change the game state (no drawing and
+ * no messages, so they can run headless) */
+
+#include "game_core.h"
+
+/******************** Random numbers ********************/
+
+/* Starts the generator (the same seed gives the same game) */
+void game_rng_seed(game_rng_t *rng, uint64_t seed) { rng->state = seed; }
+
+/* Returns the next random number (splitmix64) */
+uint32_t game_rng_next(game_rng_t *rng) {
+  uint64_t z = (rng->state += 0x9e3779b97f4a7c15);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+/* Advances the generator as if n numbers were returned (as each number only
+ * depends on how many came before it, a part of the sequence can be computed
+ * without the ones before it) */
+void game_rng_skip(game_rng_t *rng, uint64_t n) {
+  rng->state += n * 0x9e3779b97f4a7c15;
+}
+
+/******************** Aliens management ********************/
+
+/* Starts tracking the aliens killed, at current_ts (ms) */
+void aliens_regeneration_init(aliens_regeneration_t *regeneration,
+                              game_t *game, uint64_t current_ts) {
+  regeneration->last_aliens_alive = game->aliens_alive;
+  regeneration->last_aliens_change_ts = current_ts;
+}
+
+/* Returns how many aliens the tick at current_ts (ms) should regenerate */
+int aliens_regeneration_count(aliens_regeneration_t *regeneration,
+                              game_t *game, uint64_t current_ts) {
+  int aliens_to_regenerate = 0;
+
+  /* Means some aliens were zapped */
+  if (regeneration->last_aliens_alive > game->aliens_alive)
+    regeneration->last_aliens_change_ts = current_ts;
+  /* Means that no aliens were zapped or regenerated in the last
+   * ALIEN_REGENERATION_DELAY interval*/
+  else if (current_ts - regeneration->last_aliens_change_ts >
+           ALIEN_REGENERATION_DELAY) {
+    aliens_to_regenerate =
+        (int)(ALIEN_REGENERATION_FACTOR * game->aliens_alive);
+    regeneration->last_aliens_change_ts = current_ts;
+  }
+
+  regeneration->last_aliens_alive = game->aliens_alive;
+
+  return aliens_to_regenerate;
+}
+
+/* Computes the next positions of every alien into aliens_update. The dead ones
+ * also move, so the random numbers used don't depend on the aliens killed and
+ * it can run without the game lock, from the positions of the last generation
+ * (only changed by aliens_commit and new rounds) */
+void aliens_move(const alien_t *aliens, aliens_update_t *aliens_update,
+                 game_rng_t *rng) {
+  aliens_move_range(aliens, aliens_update, rng, 0, N_ALIENS);
+  game_rng_skip(rng, N_ALIENS);
+}
+
+/* Same as aliens_move for the aliens in [start, end), with rng as it is at
+ * the start of the tick (it isn't changed). Each alien uses the same random
+ * number whichever range it is moved in, so the ranges can be moved in any
+ * order or in parallel with the same result */
+void aliens_move_range(const alien_t *aliens, aliens_update_t *aliens_update,
+                       const game_rng_t *rng, int start, int end) {
+  game_rng_t range_rng = *rng;
+
+  game_rng_skip(&range_rng, (uint64_t)start);
+  for (int i = start; i < end; i++) {
+    aliens_update->aliens[i].position = aliens[i].position;
+    update_position(&aliens_update->aliens[i].position,
+                    (MOVEMENT_DIRECTION)(game_rng_next(&range_rng) % 4));
+  }
+}
+
+/* Applies the positions computed by aliens_move to the game, with the aliens
+ * alive now (the ones killed meanwhile stay dead) plus up to
+ * aliens_to_regenerate dead aliens, which come back (returns how many were).
+ * aliens_update is left with the new generation, to be published */
+int aliens_commit(game_t *game, aliens_update_t *aliens_update,
+                  int aliens_to_regenerate) {
+  int aliens_regenerated = 0;
+  alien_t *alien;
+
+  for (int i = 0; i < N_ALIENS; i++) {
+    alien = &aliens_update->aliens[i];
+    alien->alive = game->aliens[i].alive;
+
+    /* Alien regeneration */
+    if (!alien->alive && aliens_regenerated < aliens_to_regenerate) {
+      alien->alive = true;
+      aliens_regenerated++;
+    }
+  }
+
+  memcpy(&game->aliens, &aliens_update->aliens, sizeof(alien_t) * N_ALIENS);
+  game->aliens_alive += aliens_regenerated;
+
+  return aliens_regenerated;
+}
+
+/* Same as aliens_commit, but into next, which has the generation of
+ * aliens_update with the aliens alive at the last commit: only the kills made
+ * since then are applied (kills) before regenerating, and next gets the
+ * players of the game, so it can replace it (returns how many aliens were
+ * regenerated) */
+int aliens_commit_kills(const game_t *game, game_t *next,
+                        aliens_update_t *aliens_update,
+                        const aliens_kills_t *kills, int aliens_to_regenerate) {
+  int aliens_regenerated = 0, index;
+
+  for (int i = 0; i < kills->n_killed; i++) {
+    index = kills->killed[i];
+    next->aliens[index].alive = false;
+    aliens_update->aliens[index].alive = false;
+  }
+
+  /* Only searched when some are regenerated, which is rare (see
+   * aliens_regeneration_count) */
+  for (int i = 0; i < N_ALIENS && aliens_regenerated < aliens_to_regenerate;
+       i++) {
+    if (!next->aliens[i].alive) {
+      next->aliens[i].alive = true;
+      aliens_update->aliens[i].alive = true;
+      aliens_regenerated++;
+    }
+  }
+
+  memcpy(next->players, game->players, sizeof(game->players));
+  memcpy(next->row_players, game->row_players, sizeof(game->row_players));
+  memcpy(next->col_players, game->col_players, sizeof(game->col_players));
+  next->aliens_alive = game->aliens_alive + aliens_regenerated;
+
+  return aliens_regenerated;
+}
+
+/* Moves the aliens and applies it to the game (aliens_move followed by
+ * aliens_commit), regenerating up to aliens_to_regenerate dead aliens (returns
+ * how many were) */
+int aliens_tick(game_t *game, aliens_update_t *aliens_update,
+                int aliens_to_regenerate, game_rng_t *rng) {
+  aliens_move(game->aliens, aliens_update, rng);
+  return aliens_commit(game, aliens_update, aliens_to_regenerate);
+}
+
+/* Places the alien on the board */
+void place_alien(alien_t *alien, game_rng_t *rng) {
+  position_t *position = &alien->position;
+
+  /* Alien can only be on the "inner" space square */
+  position->row = game_rng_next(rng) % (SPACE_SIZE - 4) + 2;
+  position->col = game_rng_next(rng) % (SPACE_SIZE - 4) + 2;
+}
+
+/******************** Player management ********************/
+
+/* Adds a connected player to the lists of its row and column */
+static void lanes_add(game_t *game, player_t *player) {
+  player->next_in_row = game->row_players[player->position.row];
+  game->row_players[player->position.row] = player->id;
+  player->next_in_col = game->col_players[player->position.col];
+  game->col_players[player->position.col] = player->id;
+}
+
+/* Removes a player from the lists of its row and column */
+static void lanes_remove(game_t *game, player_t *player) {
+  player_id_t *link = &game->row_players[player->position.row];
+
+  while (*link != -1 && *link != player->id)
+    link = &game->players[*link].next_in_row;
+  if (*link == player->id)
+    *link = player->next_in_row;
+
+  link = &game->col_players[player->position.col];
+  while (*link != -1 && *link != player->id)
+    link = &game->players[*link].next_in_col;
+  if (*link == player->id)
+    *link = player->next_in_col;
+}
+
+/* Places the player on the board. The ids go around the edge lanes (top,
+ * right, bottom and left, then the inner lanes next to them), starting at the
+ * middle of the lane and, for every 8 players, one cell further away from it
+ * on alternating sides */
+void place_player(player_t *player) {
+  position_t *position = &player->position;
+  int id = player->id;
+  /* 0 on the outer lanes, 1 on the inner ones */
+  int depth = (id / 4) % 2;
+  int slot = id / 8;
+  int offset = slot % 2 == 1 ? (slot + 1) / 2 : -(slot / 2);
+  /* Position along the lane, which players can't leave ([2, SPACE_SIZE - 3]) */
+  int lane_size = SPACE_SIZE - 4;
+  int along =
+      2 + ((SPACE_SIZE / 2 - 2 + offset) % lane_size + lane_size) % lane_size;
+
+  // With 8 players, the board starts like:
+  //        0
+  //        4
+  // 3 7         5 1
+  //        6
+  //        2
+
+  player->orientation = id % 2 == 0 ? HORIZONTAL : VERTICAL;
+
+  switch (id % 4) {
+  case 0: /* Top */
+    position->col = along;
+    position->row = depth;
+    break;
+  case 1: /* Right */
+    position->col = SPACE_SIZE - 1 - depth;
+    position->row = along;
+    break;
+  case 2: /* Bottom */
+    position->col = along;
+    position->row = SPACE_SIZE - 1 - depth;
+    break;
+  default: /* Left */
+    position->col = depth;
+    position->row = along;
+    break;
+  }
+}
+
+/* Finds an available position for a player and initializes it */
+int find_position_and_init_player(game_t *game, int *tokens) {
+
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    player_t *player = &game->players[i];
+
+    if (!player->connected) {
+      player->connected = true;
+      player->last_shot = 0;
+      player->last_stunned = 0;
+      place_player(player);
+      lanes_add(game, player);
+      player->score = 0;
+
+      /* Displays will use this function but don't manage authentication */
+      if (tokens != NULL)
+        tokens[i] = rand();
+
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/* Updates state when a player zaps at current_ts (ms), killing the aliens and
+ * stunning the players on its lane (the lane is drawn over by the zap, so the
+ * aliens don't need to be cleaned from the screen). The aliens killed are
+ * added to kills if it isn't NULL */
+void player_zap(game_t *game, int player_id, uint64_t current_ts,
+                aliens_kills_t *kills) {
+  int aliens_killed = 0;
+  alien_t *alien;
+  player_t *player = &game->players[player_id];
+  /* The zap of a horizontal player goes along its column, and vice-versa */
+  int lane_index = player->orientation == HORIZONTAL ? player->position.col
+                                                     : player->position.row;
+
+  /* Check aliens that were killed */
+  for (int i = 0; i < N_ALIENS; i++) {
+    alien = &game->aliens[i];
+
+    /* Alien dies if it is alive and aligned with the player zap */
+    if (alien->alive && ((player->orientation == VERTICAL &&
+                          alien->position.row == player->position.row) ||
+                         (player->orientation == HORIZONTAL &&
+                          alien->position.col == player->position.col))) {
+      aliens_killed++;
+      game->aliens_alive--;
+      alien->alive = false;
+      if (kills != NULL)
+        kills->killed[kills->n_killed++] = i;
+    }
+  }
+
+  player->last_shot = current_ts;
+  player->score += aliens_killed;
+
+  /* Players are stunned if aligned with the player that shot (only the ones
+   * on its lane are checked) */
+  for (int i = lane_first_player(game, player->orientation, lane_index);
+       i != -1; i = lane_next_player(game, player->orientation, i))
+    if (i != player_id)
+      game->players[i].last_stunned = current_ts;
+}
+
+/* Moves a player (keeping the players of each row and column) */
+void player_move(game_t *game, int player_id, MOVEMENT_DIRECTION direction) {
+  player_t *player = &game->players[player_id];
+
+  lanes_remove(game, player);
+  update_position(&player->position, direction);
+  lanes_add(game, player);
+}
+
+/* Disconnects a player, freeing its position */
+void player_leave(game_t *game, int player_id) {
+  player_t *player = &game->players[player_id];
+
+  if (player->connected)
+    lanes_remove(game, player);
+  player->connected = false;
+}
+
+/* Returns the first connected player on a row (orientation==VERTICAL, the
+ * lane of a vertical zap) or column (HORIZONTAL), -1 if none */
+int lane_first_player(game_t *game, MOVEMENT_ORIENTATION orientation,
+                      int index) {
+  return orientation == VERTICAL ? game->row_players[index]
+                                 : game->col_players[index];
+}
+
+/* Returns the next player on the same lane as player_id, -1 if none */
+int lane_next_player(game_t *game, MOVEMENT_ORIENTATION orientation,
+                     int player_id) {
+  return orientation == VERTICAL ? game->players[player_id].next_in_row
+                                 : game->players[player_id].next_in_col;
+}
+
+/******************** Miscellaneous ********************/
+
+/* Places every alien on the board, alive */
+static void init_aliens(game_t *game, game_rng_t *rng) {
+  game->aliens_alive = N_ALIENS;
+
+  for (int i = 0; i < N_ALIENS; i++) {
+    alien_t *alien = &game->aliens[i];
+
+    alien->alive = true;
+    place_alien(alien, rng);
+  }
+}
+
+/* Inits all the players and aliens on the board */
+void init_game(game_t *game, int *tokens, game_rng_t *rng) {
+
+  /* Nobody connected yet */
+  for (int i = 0; i < SPACE_SIZE; i++) {
+    game->row_players[i] = -1;
+    game->col_players[i] = -1;
+  }
+
+  /* Init players */
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    player_t *player = &game->players[i];
+
+    player->connected = false;
+    player->id = i;
+    player->last_shot = 0;
+    player->last_stunned = 0;
+    place_player(player);
+    player->next_in_row = -1;
+    player->next_in_col = -1;
+    player->score = -1;
+    tokens[i] = -1;
+  }
+
+  init_aliens(game, rng);
+}
+
+/* Starts a new round once every alien was killed: the connected players keep
+ * their ids (and tokens) but go back to their places with no score, and every
+ * alien is placed again */
+void start_round(game_t *game, game_rng_t *rng) {
+
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    player_t *player = &game->players[i];
+
+    if (!player->connected)
+      continue;
+
+    player->last_shot = 0;
+    player->last_stunned = 0;
+    lanes_remove(game, player);
+    place_player(player);
+    lanes_add(game, player);
+    player->score = 0;
+  }
+
+  init_aliens(game, rng);
+}
+
+/* Update the position of a player or alien */
+void update_position(position_t *position, MOVEMENT_DIRECTION direction) {
+
+  switch (direction) {
+  case UP:
+    position->row--;
+
+    /* Revert if out of bounds */
+    if (position->row < 2)
+      position->row++;
+    break;
+  case DOWN:
+    position->row++;
+
+    /* Revert if out of bounds */
+    if (position->row >= SPACE_SIZE - 2)
+      position->row--;
+    break;
+  case RIGHT:
+    position->col++;
+
+    /* Revert if out of bounds */
+    if (position->col >= SPACE_SIZE - 2)
+      position->col--;
+    break;
+  case LEFT:
+    position->col--;
+
+    /* Revert if out of bounds */
+    if (position->col < 2)
+      position->col++;
+    break;
+
+  default:
+    break;
+  }
+}
+
+/* Adds a value to a FNV-1a hash */
+static uint64_t hash_value(uint64_t hash, int value) {
+  return (hash ^ (uint32_t)value) * 0x100000001b3;
+}
+
+/* Returns a hash of the players and aliens (used to check that a replayed
+ * game didn't diverge) */
+uint64_t game_checksum(const game_t *game) {
+  uint64_t hash = 0xcbf29ce484222325;
+  const player_t *player;
+  const alien_t *alien;
+
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    player = &game->players[i];
+    hash = hash_value(hash, player->connected ? player->score : -1);
+    hash = hash_value(hash, player->position.row);
+    hash = hash_value(hash, player->position.col);
+  }
+
+  /* The position of dead aliens doesn't matter */
+  for (int i = 0; i < N_ALIENS; i++) {
+    alien = &game->aliens[i];
+    hash = hash_value(hash, alien->alive);
+    if (alien->alive) {
+      hash = hash_value(hash, alien->position.row);
+      hash = hash_value(hash, alien->position.col);
+    }
+  }
+
+  return hash;
+}
@@ -0,0 +1,95 @@
+/* Contains the snapshots of the game (see include/game_snapshot.h) */
+
+#include "game_snapshot.h"
+#include <assert.h>
+#include <sched.h>
+#include <string.h>
+
+/* Copies the game to a slot, skipping the aliens if it already has them */
+static void snapshot_copy(snapshot_pool_t *pool, game_snapshot_t *slot,
+                          const game_t *game, const int *tokens,
+                          const uint64_t *client_ids, const game_rng_t *rng) {
+  slot->rng = *rng;
+  memcpy(slot->tokens, tokens, sizeof(slot->tokens));
+  memcpy(slot->client_ids, client_ids, sizeof(slot->client_ids));
+  memcpy(slot->game.players, game->players, sizeof(game->players));
+  memcpy(slot->game.row_players, game->row_players,
+         sizeof(game->row_players));
+  memcpy(slot->game.col_players, game->col_players,
+         sizeof(game->col_players));
+  slot->game.aliens_alive = game->aliens_alive;
+
+  if (slot->aliens_version != pool->aliens_version) {
+    memcpy(slot->game.aliens, game->aliens, sizeof(game->aliens));
+    slot->aliens_version = pool->aliens_version;
+  }
+}
+
+/* Publishes the first snapshot */
+void snapshot_pool_init(snapshot_pool_t *pool, const game_t *game,
+                        const int *tokens, const uint64_t *client_ids,
+                        const game_rng_t *rng) {
+  memset(pool, 0, sizeof(snapshot_pool_t));
+
+  /* Every slot starts without the aliens */
+  pool->aliens_version = 1;
+  snapshot_copy(pool, &pool->slots[0], game, tokens, client_ids, rng);
+  pool->slots[0].version = 1;
+  pool->latest = &pool->slots[0];
+}
+
+/* Publishes a snapshot of the game (the caller serializes the publishes and
+ * the changes to the game, e.g. with a lock). aliens_changed tells if the
+ * aliens changed since the last one and next_update_sequence is the sequence
+ * of the first update that isn't applied to it yet */
+void snapshot_publish(snapshot_pool_t *pool, const game_t *game,
+                      const int *tokens, const uint64_t *client_ids,
+                      const game_rng_t *rng, bool aliens_changed,
+                      uint64_t next_update_sequence) {
+  game_snapshot_t *latest = pool->latest, *slot = NULL;
+
+  /* A reader keeps a slot for a single request (the aliens thread, to save a
+   * tick), so one is free soon */
+  while (slot == NULL) {
+    for (int i = 0; i < SNAPSHOT_SLOTS && slot == NULL; i++) {
+      if (&pool->slots[i] != latest &&
+          __atomic_load_n(&pool->slots[i].readers, __ATOMIC_SEQ_CST) == 0)
+        slot = &pool->slots[i];
+    }
+    if (slot == NULL)
+      sched_yield();
+  }
+
+  if (aliens_changed)
+    pool->aliens_version++;
+  snapshot_copy(pool, slot, game, tokens, client_ids, rng);
+  slot->next_update_sequence = next_update_sequence;
+  slot->version = latest->version + 1;
+
+  /* Only now the readers can get it */
+  __atomic_store_n(&pool->latest, slot, __ATOMIC_SEQ_CST);
+}
+
+/* Returns the latest snapshot, which doesn't change until it is released */
+const game_snapshot_t *snapshot_acquire(snapshot_pool_t *pool) {
+  game_snapshot_t *slot;
+
+  while (true) {
+    slot = __atomic_load_n(&pool->latest, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&slot->readers, 1, __ATOMIC_SEQ_CST);
+
+    /* If it is still the latest one, the writer won't take it */
+    if (__atomic_load_n(&pool->latest, __ATOMIC_SEQ_CST) == slot)
+      return slot;
+
+    __atomic_sub_fetch(&slot->readers, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+/* Releases a snapshot returned by snapshot_acquire */
+void snapshot_release(const game_snapshot_t *snapshot) {
+  int readers = __atomic_sub_fetch(&((game_snapshot_t *)snapshot)->readers, 1,
+                                   __ATOMIC_SEQ_CST);
+
+  assert(readers >= 0);
+}
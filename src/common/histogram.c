@@ -0,0 +1,88 @@
+/* Contains the fixed size histogram used to keep latency percentiles */
+
+#include "histogram.h"
+
+/* Returns the bucket of a value */
+static int bucket_index(uint64_t value) {
+  int magnitude;
+
+  if (value < HISTOGRAM_SUB_BUCKETS)
+    return (int)value;
+
+  /* Position of the highest bit, whose following bits choose the sub bucket */
+  magnitude = 63 - __builtin_clzll(value);
+  return (magnitude - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS +
+         (int)((value >> (magnitude - HISTOGRAM_SUB_BUCKET_BITS)) -
+               HISTOGRAM_SUB_BUCKETS);
+}
+
+/* Returns the highest value kept by a bucket */
+static uint64_t bucket_highest_value(int index) {
+  int magnitude;
+  uint64_t lowest;
+
+  if (index < HISTOGRAM_SUB_BUCKETS)
+    return (uint64_t)index;
+
+  magnitude = index / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKET_BITS - 1;
+  lowest = (uint64_t)(HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS)
+           << (magnitude - HISTOGRAM_SUB_BUCKET_BITS);
+
+  return lowest + ((uint64_t)1 << (magnitude - HISTOGRAM_SUB_BUCKET_BITS)) - 1;
+}
+
+/* Clears the histogram */
+void histogram_reset(histogram_t *histogram) {
+  memset(histogram, 0, sizeof(histogram_t));
+}
+
+/* Records a value */
+void histogram_record(histogram_t *histogram, uint64_t value) {
+  histogram->counts[bucket_index(value)]++;
+  histogram->total++;
+  if (value > histogram->max)
+    histogram->max = value;
+}
+
+/* Adds the values recorded by another histogram */
+void histogram_merge(histogram_t *histogram, const histogram_t *other) {
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    histogram->counts[i] += other->counts[i];
+
+  histogram->total += other->total;
+  if (other->max > histogram->max)
+    histogram->max = other->max;
+}
+
+/* Returns the value at the given percentile (0-100), which is the highest
+ * value of its bucket (0 if nothing was recorded) */
+uint64_t histogram_percentile(const histogram_t *histogram, double percentile) {
+  uint64_t target, seen = 0, value;
+
+  if (histogram->total == 0)
+    return 0;
+
+  /* Rank of the value (at least the first one) */
+  target = (uint64_t)(percentile / 100.0 * (double)histogram->total + 0.5);
+  if (target == 0)
+    target = 1;
+
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += histogram->counts[i];
+    if (seen >= target) {
+      value = bucket_highest_value(i);
+      return value < histogram->max ? value : histogram->max;
+    }
+  }
+
+  return histogram->max;
+}
+
+/* Prints the count, p50, p99 and max of a histogram of nanoseconds as ms */
+void histogram_print_ms(FILE *stream, const char *name,
+                        const histogram_t *histogram) {
+  fprintf(stream, "%-8s n=%-8lu p50=%.3fms p99=%.3fms max=%.3fms\n", name,
+          (unsigned long)histogram->total,
+          histogram_percentile(histogram, 50) / 1e6,
+          histogram_percentile(histogram, 99) / 1e6, histogram->max / 1e6);
+}
@@ -0,0 +1,185 @@
+/* Contains the journal of a match (see include/journal.h) */
+
+#include "journal.h"
+#include "game_core.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Grows the file and maps it again */
+static void journal_grow(journal_t *journal) {
+  size_t new_size = journal->mapped_size + JOURNAL_GROWTH;
+
+  if (journal->header != NULL)
+    assert(munmap(journal->header, journal->mapped_size) == 0);
+
+  assert(ftruncate(journal->fd, (off_t)new_size) == 0);
+  journal->header = (journal_header_t *)mmap(
+      NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, journal->fd, 0);
+  assert(journal->header != MAP_FAILED);
+  journal->mapped_size = new_size;
+}
+
+/* Returns the size of a journal with the given number of records */
+static size_t journal_size(uint64_t n_records) {
+  return sizeof(journal_header_t) + n_records * sizeof(journal_record_t);
+}
+
+/* Creates the journal of a match (exits if the file can't be created) */
+journal_t *journal_create(const char *path, uint64_t seed, uint64_t start_ts) {
+  journal_t *journal = (journal_t *)calloc(1, sizeof(journal_t));
+  journal_header_t *header;
+
+  assert(journal != NULL);
+
+  journal->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (journal->fd == -1) {
+    printf("Couldn't create the journal %s.\n", path);
+    exit(-1);
+  }
+  journal_grow(journal);
+
+  header = journal->header;
+  memcpy(header->magic, JOURNAL_MAGIC, sizeof(header->magic));
+  header->version = JOURNAL_VERSION;
+  header->space_size = SPACE_SIZE;
+  header->max_players = MAX_PLAYERS;
+  header->n_aliens = N_ALIENS;
+  header->seed = seed;
+  header->start_ts = start_ts;
+  header->n_records = 0;
+
+  return journal;
+}
+
+/* Appends a record (the caller serializes the appends, e.g. with the game
+ * lock) */
+void journal_append(journal_t *journal, const journal_record_t *record) {
+  uint64_t n_records = journal->header->n_records;
+
+  if (journal_size(n_records + 1) > journal->mapped_size)
+    journal_grow(journal);
+
+  memcpy((journal_record_t *)(journal->header + 1) + n_records, record,
+         sizeof(journal_record_t));
+  /* Only counted once written */
+  journal->header->n_records = n_records + 1;
+}
+
+/* Appends an input accepted by the server (action_request is only used by
+ * JOURNAL_ACTION) */
+void journal_append_input(journal_t *journal, JOURNAL_RECORD_TYPE type,
+                          int player_id, const action_request_t *action_request,
+                          uint64_t ts) {
+  journal_record_t record;
+
+  memset(&record, 0, sizeof(journal_record_t));
+  record.type = type;
+  record.player_id = player_id;
+  record.ts = ts;
+  if (type == JOURNAL_ACTION) {
+    record.data.action.action_type = action_request->action_type;
+    record.data.action.movement_direction =
+        action_request->movement_direction;
+  }
+
+  journal_append(journal, &record);
+}
+
+/* Appends an aliens tick, with the aliens alive after it, and returns its
+ * index (its checksum is written later, see journal_set_checksum) */
+uint64_t journal_append_tick(journal_t *journal, int aliens_regenerated,
+                             const game_t *game, uint64_t ts) {
+  journal_record_t record;
+
+  memset(&record, 0, sizeof(journal_record_t));
+  record.type = JOURNAL_TICK;
+  record.player_id = -1;
+  record.ts = ts;
+  record.data.tick.aliens_regenerated = aliens_regenerated;
+  record.data.tick.aliens_alive = game->aliens_alive;
+
+  journal_append(journal, &record);
+  return journal->header->n_records - 1;
+}
+
+/* Writes the checksum of the game after the tick with the given index. It can
+ * be called while other records are appended (without the game lock) */
+void journal_set_checksum(journal_t *journal, uint64_t index,
+                          const game_t *game) {
+  uint64_t checksum = game_checksum(game);
+  /* Written to the file instead of the mapping, which an append can move */
+  off_t offset = (off_t)(journal_size(index) +
+                         offsetof(journal_record_t, data.tick.checksum));
+
+  assert(pwrite(journal->fd, &checksum, sizeof(checksum), offset) ==
+         sizeof(checksum));
+}
+
+/* Appends the start of a new round, with the game state after it */
+void journal_append_round(journal_t *journal, game_t *game, uint64_t ts) {
+  journal_record_t record;
+
+  memset(&record, 0, sizeof(journal_record_t));
+  record.type = JOURNAL_ROUND;
+  record.player_id = -1;
+  record.ts = ts;
+  record.data.tick.aliens_alive = game->aliens_alive;
+  record.data.tick.checksum = game_checksum(game);
+
+  journal_append(journal, &record);
+}
+
+/* Truncates the file to the records written and closes it */
+void journal_close(journal_t *journal) {
+  size_t size = journal_size(journal->header->n_records);
+
+  assert(munmap(journal->header, journal->mapped_size) == 0);
+  assert(ftruncate(journal->fd, (off_t)size) == 0);
+  close(journal->fd);
+  free(journal);
+}
+
+/* Maps a journal to be read, returning NULL if it isn't valid */
+const journal_header_t *journal_map(const char *path, size_t *mapped_size) {
+  int fd = open(path, O_RDONLY);
+  struct stat file_stat;
+  journal_header_t *header;
+
+  if (fd == -1)
+    return NULL;
+
+  if (fstat(fd, &file_stat) != 0 ||
+      (size_t)file_stat.st_size < sizeof(journal_header_t)) {
+    close(fd);
+    return NULL;
+  }
+
+  header = (journal_header_t *)mmap(NULL, (size_t)file_stat.st_size,
+                                    PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (header == MAP_FAILED)
+    return NULL;
+
+  /* A crashed server leaves the file bigger than the records */
+  if (memcmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != JOURNAL_VERSION ||
+      journal_size(header->n_records) > (size_t)file_stat.st_size) {
+    munmap(header, (size_t)file_stat.st_size);
+    return NULL;
+  }
+
+  *mapped_size = (size_t)file_stat.st_size;
+  return header;
+}
+
+/* Returns the first record of a mapped journal */
+const journal_record_t *journal_records(const journal_header_t *header) {
+  return (const journal_record_t *)(header + 1);
+}
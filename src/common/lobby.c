@@ -0,0 +1,81 @@
+/* Contains the parts of the lobby used by the servers and the astronauts (see
+ * include/lobby.h) */
+
+#include "lobby.h"
+#include "zeromq_wrapper.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zmq.h>
+
+/******************** Shards (game-server) ********************/
+
+/* Creates the socket that pushes the status of the server to the lobby, or
+ * returns NULL if LOBBY_SHARDS_ENV isn't set */
+void *lobby_shard_socket(void *context) {
+  char *address = getenv(LOBBY_SHARDS_ENV);
+  void *lobby_socket;
+  /* Only the latest status matters, and none is kept on exit */
+  int high_water_mark = 1, linger = 0;
+
+  if (address == NULL)
+    return NULL;
+
+  if (strlen(zmq_server_reqrep_address()) >= ADDRESS_SIZE ||
+      strlen(zmq_server_pubsub_address()) >= ADDRESS_SIZE) {
+    printf("The addresses of the server are too long for the lobby.\n");
+    exit(-1);
+  }
+
+  lobby_socket = zmq_create_socket(context, ZMQ_PUSH);
+  assert(zmq_setsockopt(lobby_socket, ZMQ_SNDHWM, &high_water_mark,
+                        sizeof(int)) == 0);
+  assert(zmq_setsockopt(lobby_socket, ZMQ_LINGER, &linger, sizeof(int)) == 0);
+  zmq_connect_socket(lobby_socket, address);
+
+  return lobby_socket;
+}
+
+/* Pushes the status of the server to the lobby (dropped if it can't be sent
+ * right away) */
+void lobby_report_shard(void *lobby_socket, const game_t *game) {
+  shard_status_t status = {0};
+  MESSAGE_TYPE msg_type = SHARD_STATUS;
+
+  strcpy(status.reqrep_address, zmq_server_reqrep_address());
+  strcpy(status.pubsub_address, zmq_server_pubsub_address());
+  for (int i = 0; i < MAX_PLAYERS; i++)
+    status.players += game->players[i].connected;
+  status.free_slots = MAX_PLAYERS - status.players;
+  status.aliens_alive = game->aliens_alive;
+
+  /* A message is sent whole or not at all, so only the first part can fail
+   * (zmq_send_msg would block until the lobby is back) */
+  if (zmq_send(lobby_socket, &msg_type, sizeof(MESSAGE_TYPE),
+               ZMQ_SNDMORE | ZMQ_DONTWAIT) == -1)
+    return;
+  assert(zmq_send(lobby_socket, &status, sizeof(status), 0) != -1);
+}
+
+/******************** Astronauts ********************/
+
+/* Returns the address the astronauts send their connect request to (the one
+ * of the lobby or, without one, of the server) */
+char *lobby_connect_address() {
+  return zmq_address_from_env(LOBBY_ENV, zmq_server_reqrep_address());
+}
+
+/* Moves a REQ socket from the lobby to the shard that accepted the astronaut,
+ * given the response to its connect request. Returns false (and leaves the
+ * socket as it is) if the response came from a game-server */
+bool lobby_follow_shard(void *req_socket, const char *lobby_address,
+                        const astronaut_connect_response_t *response) {
+  if (response->reqrep_address[0] == '\0')
+    return false;
+
+  /* The socket isn't waiting for a reply, so it can change its peer */
+  assert(zmq_disconnect(req_socket, lobby_address) == 0);
+  zmq_connect_socket(req_socket, (char *)response->reqrep_address);
+  return true;
+}
@@ -1,104 +1,325 @@
-/* Contains utility wrappers around the ncurses library */
+/* Contains the drawing functions, implemented on top of the render backend
+ * primitives (ncurses by default) */
 
 #include "ncurses_wrapper.h"
 
+/* The viewport of the game window */
+viewport_t nc_viewport = {0, 0, SPACE_SIZE, SPACE_SIZE};
+
+/* The backend used to draw and its counters */
+static const render_backend_t *backend = &render_backend_ncurses;
+static render_stats_t stats;
+
+/* Size of the terminal */
+static int screen_rows, screen_cols;
+
+/******************** Backend helpers ********************/
+
+/* Returns the backend with the given name (NULL if there isn't one) */
+const render_backend_t *render_backend_find(const char *name) {
+  const render_backend_t *backends[] = {
+      &render_backend_ncurses, &render_backend_null, &render_backend_ansi};
+
+  for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+    if (strcmp(backends[i]->name, name) == 0)
+      return backends[i];
+  }
+
+  return NULL;
+}
+
+/* Creates a window on the given terminal position */
+static nc_window_t *nc_new_window(int rows, int cols, int start_row,
+                                  int start_col) {
+  nc_window_t *win = (nc_window_t *)malloc(sizeof(nc_window_t));
+  assert(win != NULL);
+
+  win->rows = rows;
+  win->cols = cols;
+  win->start_row = start_row;
+  win->start_col = start_col;
+  backend->create_window(win);
+
+  return win;
+}
+
+/* Frees a window (what it drew stays on the terminal) */
+static void nc_delete_window(nc_window_t *win) {
+  backend->destroy_window(win);
+  free(win);
+}
+
+/* Formats and draws a text on a window position */
+static void nc_printf(nc_window_t *win, int row, int col, const char *format,
+                      ...) {
+  char text[128];
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+
+  backend->print(win, row, col, text);
+}
+
 /******************** Initialization functions ********************/
 
-/* Initializes ncurses */
+/* Initializes the render backend (chosen with the RENDER_BACKEND_ENV
+ * environment variable) */
 void nc_init() {
-  initscr();
-  cbreak();
-  keypad(stdscr, TRUE);
-  noecho();
-  curs_set(0); // Hide the cursor
-
-  /* Draw letters and lasers with color */
-  start_color();
-  init_pair(1, COLOR_RED, COLOR_BLACK);
-  init_pair(2, COLOR_YELLOW, COLOR_BLACK);
-  init_pair(3, COLOR_GREEN, COLOR_BLACK);
+  const char *name = getenv(RENDER_BACKEND_ENV);
+
+  if (name != NULL) {
+    backend = render_backend_find(name);
+    if (backend == NULL) {
+      printf("Unknown renderer '%s' (use ncurses, null or ansi).\n", name);
+      exit(-1);
+    }
+  }
+
+  backend->init(&screen_rows, &screen_cols);
 }
 
-/* Draws game rectangle */
-WINDOW *nc_init_space() {
+/* Draws game rectangle, sized to the viewport that fits in the terminal
+ * (leaving reserved_rows free below it) */
+nc_window_t *nc_init_space(int reserved_rows) {
+  int max_height = screen_rows - 2 - reserved_rows;
+  int max_width = screen_cols - 2 - 2 - SCOREBOARD_WIDTH;
+
+  /* Only the part of the board that fits in the terminal is shown (but at
+   * least one cell, as ncurses can't create empty windows, unless the backend
+   * has no terminal at all) */
+  nc_viewport.row = 0;
+  nc_viewport.col = 0;
+  nc_viewport.height = SPACE_SIZE < max_height ? SPACE_SIZE : max_height;
+  nc_viewport.width = SPACE_SIZE < max_width ? SPACE_SIZE : max_width;
+  if (nc_viewport.height < 1)
+    nc_viewport.height = screen_rows > 0 ? 1 : 0;
+  if (nc_viewport.width < 1)
+    nc_viewport.width = screen_cols > 0 ? 1 : 0;
 
   /*
     Creates a window and draws a border
     Adding +2 on each dimension for the border
   */
-  WINDOW *win = newwin(SPACE_SIZE + 2, SPACE_SIZE + 2, 0, 0);
-  assert(win != NULL);
+  nc_window_t *win =
+      nc_new_window(nc_viewport.height + 2, nc_viewport.width + 2, 0, 0);
 
-  box(win, 0, 0);
-  wrefresh(win);
+  backend->draw_box(win);
+  nc_refresh(win);
 
   return win;
 }
 
 /* Draws score rectangle */
-WINDOW *nc_init_scoreboard() {
+nc_window_t *nc_init_scoreboard() {
 
-  WINDOW *win = newwin(MAX_PLAYERS + 2 + 2 + 2, 16, 0, SPACE_SIZE + 4);
-  assert(win != NULL);
+  nc_window_t *win =
+      nc_new_window(SCOREBOARD_ROWS, SCOREBOARD_WIDTH, 0, nc_viewport.width + 4);
+
+  backend->draw_box(win);
+
+  nc_printf(win, 1, 1, "  SCOREBOARD  ");
+  nc_printf(win, 2, 1, "--------------");
+
+  nc_printf(win, 3 + SCOREBOARD_PLAYERS, 1, "--------------");
+  nc_printf(win, 4 + SCOREBOARD_PLAYERS, 1, "* ALIVE  - %d", N_ALIENS);
+
+  nc_refresh(win);
+
+  return win;
+}
+
+/* Draws latency overlay rectangle */
+nc_window_t *nc_init_latency() {
 
-  box(win, 0, 0);
+  nc_window_t *win =
+      nc_new_window(LATENCY_WINDOW_ROWS, LATENCY_WINDOW_WIDTH, SCOREBOARD_ROWS,
+                    nc_viewport.width + 4);
 
-  wmove(win, 1, 1);
-  wprintw(win, "  SCOREBOARD  ");
-  wmove(win, 2, 1);
-  wprintw(win, "--------------");
+  backend->draw_box(win);
 
-  wmove(win, 11, 1);
-  wprintw(win, "--------------");
-  wmove(win, 12, 1);
-  wprintw(win, "* ALIVE  - %d", N_ALIENS);
+  nc_printf(win, 1, 1, "ms     p50   p99   max");
 
-  wrefresh(win);
+  nc_refresh(win);
 
   return win;
 }
 
 /* Draws user commands */
-WINDOW *nc_init_astronaut(MOVEMENT_ORIENTATION player_orientation,
-                          int player_id, int starting_row) {
+nc_window_t *nc_init_astronaut(MOVEMENT_ORIENTATION player_orientation,
+                               int player_id, int starting_row) {
 
-  WINDOW *win = newwin(11, 40, starting_row, 0);
-  assert(win != NULL);
+  nc_window_t *win = nc_new_window(ASTRONAUT_WINDOW_ROWS, 40, starting_row, 0);
 
-  box(win, 0, 0);
+  backend->draw_box(win);
 
   /* Print game instructions */
-  wmove(win, 1, 1);
-  wprintw(win, "You are playing as player: %c", id_to_symbol(player_id));
-  wmove(win, 3, 1);
-  wprintw(win, "Controls:");
-  wmove(win, 4, 1);
+  char label[PLAYER_LABEL_SIZE];
+
+  nc_printf(win, 1, 1, "You are playing as player: %s",
+            id_to_label(player_id, label));
+  nc_printf(win, 3, 1, "Controls:");
   if (player_orientation == VERTICAL) {
-    wprintw(win, "\t UP ARROW\t-> Move up");
-    wmove(win, 5, 1);
-    wprintw(win, "\t DOWN ARROW\t-> Move down");
+    nc_printf(win, 4, 1, "\t UP ARROW\t-> Move up");
+    nc_printf(win, 5, 1, "\t DOWN ARROW\t-> Move down");
 
   } else {
-    wprintw(win, "\t RIGHT ARROW\t-> Move right");
-    wmove(win, 5, 1);
-    wprintw(win, "\t LEFT ARROW\t-> Move left");
+    nc_printf(win, 4, 1, "\t RIGHT ARROW\t-> Move right");
+    nc_printf(win, 5, 1, "\t LEFT ARROW\t-> Move left");
   }
-  wmove(win, 6, 1);
-  wprintw(win, "\t SPACEBAR\t-> Zap");
-  wmove(win, 7, 1);
-  wprintw(win, "\t q/Q\t\t-> Stop playing");
+  nc_printf(win, 6, 1, "\t SPACEBAR\t-> Zap");
+  nc_printf(win, 7, 1, "\t q/Q\t\t-> Stop playing");
 
-  wrefresh(win);
+  nc_refresh(win);
 
   return win;
 }
 
 /* Draws the elements necessary for a given game when initializing */
-void nc_draw_init_game(WINDOW *game_window, WINDOW *score_window, game_t game) {
+void nc_draw_init_game(nc_window_t *game_window, nc_window_t *score_window,
+                       game_t *game) {
+
+  nc_redraw_space(game_window, game);
+
+  nc_update_scoreboard(score_window, game->players, game->aliens_alive);
+
+  nc_stage(game_window);
+  nc_stage(score_window);
+  nc_flush();
+}
+
+/* Returns the number of terminal rows used by the game window */
+int nc_space_window_rows() { return nc_viewport.height + 2; }
+
+/* Shows a message on the entire screen */
+void nc_show_message(const char *message) {
+  nc_window_t *win = nc_new_window(screen_rows, screen_cols, 0, 0);
+
+  backend->print(win, 0, 0, message);
+  nc_refresh(win);
+  nc_delete_window(win);
+}
+
+/******************** Refreshing screen ********************/
+
+/* Marks a window to be written to the terminal on the next flush */
+void nc_stage(nc_window_t *win) { backend->stage(win); }
+
+/* Writes every staged window to the terminal (a frame) */
+void nc_flush() {
+  TRACE_BEGIN("render");
+  stats.last_frame_bytes = backend->flush();
+  TRACE_END("render");
+  stats.bytes += stats.last_frame_bytes;
+  stats.frames++;
+}
+
+/* Writes a single window to the terminal */
+void nc_refresh(nc_window_t *win) {
+  nc_stage(win);
+  nc_flush();
+}
+
+/* Returns the counters of the render backend */
+render_stats_t nc_get_render_stats() { return stats; }
+
+/******************** Viewport ********************/
+
+/* Moves the viewport so its top left corner is on the given board position
+ * (clamped to the board) and redraws the game window if it changed */
+void nc_set_viewport(nc_window_t *game_window, game_t *game, int row, int col) {
+
+  /* Clamp so the viewport never shows anything outside the board */
+  if (row > SPACE_SIZE - nc_viewport.height)
+    row = SPACE_SIZE - nc_viewport.height;
+  if (col > SPACE_SIZE - nc_viewport.width)
+    col = SPACE_SIZE - nc_viewport.width;
+  if (row < 0)
+    row = 0;
+  if (col < 0)
+    col = 0;
+
+  if (row == nc_viewport.row && col == nc_viewport.col)
+    return;
+
+  nc_viewport.row = row;
+  nc_viewport.col = col;
+
+  nc_redraw_space(game_window, game);
+  nc_refresh(game_window);
+}
+
+/* Recenters the viewport on a position if it got close to the edges */
+void nc_follow_position(nc_window_t *game_window, game_t *game,
+                        position_t position) {
+  /* Nothing to follow when the backend has no screen */
+  if (nc_viewport.height == 0 || nc_viewport.width == 0)
+    return;
+
+  int margin_rows = VIEWPORT_FOLLOW_MARGIN < nc_viewport.height / 2
+                        ? VIEWPORT_FOLLOW_MARGIN
+                        : nc_viewport.height / 2;
+  int margin_cols = VIEWPORT_FOLLOW_MARGIN < nc_viewport.width / 2
+                        ? VIEWPORT_FOLLOW_MARGIN
+                        : nc_viewport.width / 2;
+
+  /* Still comfortably inside the viewport */
+  if (position.row >= nc_viewport.row + margin_rows &&
+      position.row < nc_viewport.row + nc_viewport.height - margin_rows &&
+      position.col >= nc_viewport.col + margin_cols &&
+      position.col < nc_viewport.col + nc_viewport.width - margin_cols)
+    return;
+
+  nc_set_viewport(game_window, game, position.row - nc_viewport.height / 2,
+                  position.col - nc_viewport.width / 2);
+}
+
+/* Scrolls the viewport according to a key (arrows or WASD), returning
+ * true if the key was a scroll key */
+bool nc_scroll_viewport(nc_window_t *game_window, game_t *game, int key) {
+  /* Scroll half a screen at a time */
+  int row_step = nc_viewport.height / 2 > 0 ? nc_viewport.height / 2 : 1;
+  int col_step = nc_viewport.width / 2 > 0 ? nc_viewport.width / 2 : 1;
+
+  switch (key) {
+  case KEY_UP:
+  case 'w':
+    row_step = -row_step;
+    col_step = 0;
+    break;
+  case KEY_DOWN:
+  case 's':
+    col_step = 0;
+    break;
+  case KEY_LEFT:
+  case 'a':
+    row_step = 0;
+    col_step = -col_step;
+    break;
+  case KEY_RIGHT:
+  case 'd':
+    row_step = 0;
+    break;
+  default:
+    return false;
+  }
+
+  nc_set_viewport(game_window, game, nc_viewport.row + row_step,
+                  nc_viewport.col + col_step);
+
+  return true;
+}
 
-  /* Draw aliens */
+/* Redraws all the visible elements of the game window */
+void nc_redraw_space(nc_window_t *game_window, game_t *game) {
+
+  backend->erase_window(game_window);
+  backend->draw_box(game_window);
+
+  /* Draw aliens (the ones outside the viewport are skipped by nc_add_alien) */
   for (int i = 0; i < N_ALIENS; i++) {
-    alien_t *alien = &game.aliens[i];
+    alien_t *alien = &game->aliens[i];
 
     if (alien->alive)
       nc_add_alien(game_window, &alien->position, false);
@@ -106,16 +327,11 @@ void nc_draw_init_game(WINDOW *game_window, WINDOW *score_window, game_t game) {
 
   /* Draw players */
   for (int i = 0; i < MAX_PLAYERS; i++) {
-    player_t *player = &game.players[i];
+    player_t *player = &game->players[i];
 
     if (player->connected)
       nc_add_player(game_window, *player);
   }
-
-  nc_update_scoreboard(score_window, game.players, game.aliens_alive);
-
-  wrefresh(game_window);
-  wrefresh(score_window);
 }
 
 /******************** Updating screen ********************/
@@ -139,9 +355,12 @@ int __compare_players(const void *a, const void *b) {
 }
 
 /* Resets and updates the scoreboard */
-void nc_update_scoreboard(WINDOW *win, player_t *players, int aliens_alive) {
+void nc_update_scoreboard(nc_window_t *win, player_t *players,
+                          int aliens_alive) {
 
-  player_t copy_players[MAX_PLAYERS];
+  /* Static as it can be too big for the stack with many players */
+  static player_t copy_players[MAX_PLAYERS];
+  char label[PLAYER_LABEL_SIZE];
 
   // Create copy to be sorted
   for (int i = 0; i < MAX_PLAYERS; i++) {
@@ -154,126 +373,161 @@ void nc_update_scoreboard(WINDOW *win, player_t *players, int aliens_alive) {
   // Sort scores
   qsort(&copy_players, MAX_PLAYERS, sizeof(player_t), __compare_players);
 
-  // Print scoreboard
-  for (int i = 0; i < MAX_PLAYERS; i++) {
-    wmove(win, 3 + i, 1);
-    wprintw(win, "              ");
+  // Print scoreboard (only the best scores fit)
+  for (int i = 0; i < SCOREBOARD_PLAYERS; i++) {
+    nc_printf(win, 3 + i, 1, "              ");
 
-    if (copy_players[i].connected) {
-      wmove(win, 3 + i, 1);
-      wprintw(win, "Player %c - %3d", id_to_symbol(copy_players[i].id),
-              copy_players[i].score);
-    }
+    if (copy_players[i].connected)
+      nc_printf(win, 3 + i, 1, "Player %-2s- %3d",
+                id_to_label(copy_players[i].id, label), copy_players[i].score);
   }
 
   /* Update alive aliens */
-  wmove(win, 12, 1);
-  wprintw(win, "* ALIVE  - %3d", aliens_alive);
+  nc_printf(win, 4 + SCOREBOARD_PLAYERS, 1, "* ALIVE  - %3d", aliens_alive);
 }
 
 /* Adds a player to the screen */
-void nc_add_player(WINDOW *win, player_t player) {
-  wmove(win, POS_TO_WIN(player.position.row), POS_TO_WIN(player.position.col));
-  waddch(win, id_to_symbol(player.id) | A_BOLD);
+void nc_add_player(nc_window_t *win, player_t player) {
+  if (!NC_IS_VISIBLE(player.position))
+    return;
+
+  backend->put_char(win, ROW_TO_WIN(player.position.row),
+                    COL_TO_WIN(player.position.col), id_to_symbol(player.id),
+                    NC_BOLD);
 }
 
 /* Move a player on the screen */
-void nc_move_player(WINDOW *win, player_t player, position_t old_pos) {
-  wmove(win, POS_TO_WIN(old_pos.row), POS_TO_WIN(old_pos.col));
-  waddch(win, ' ' | A_BOLD);
-
-  wmove(win, POS_TO_WIN(player.position.row), POS_TO_WIN(player.position.col));
-  waddch(win, id_to_symbol(player.id) | A_BOLD);
+void nc_move_player(nc_window_t *win, player_t player, position_t old_pos) {
+  nc_clean_position(win, old_pos);
+  nc_add_player(win, player);
 }
 
 /* Draws the zap line on the screen */
-void nc_draw_zap(WINDOW *win, game_t *game, player_t *player_zap) {
+void nc_draw_zap(nc_window_t *win, game_t *game, player_t *player_zap) {
   player_t *other_player;
-
-  /* Draw laser in green (color pair 2) */
-  wattron(win, COLOR_PAIR(2));
-  for (int i = 0; i < SPACE_SIZE; i++) {
-
-    if (player_zap->orientation == VERTICAL) {
-      wmove(win, POS_TO_WIN(player_zap->position.row), POS_TO_WIN(i));
-      waddch(win, '-');
-    } else {
-      wmove(win, POS_TO_WIN(i), POS_TO_WIN(player_zap->position.col));
-      waddch(win, '|');
+  /* The zap of a horizontal player goes along its column, and vice-versa */
+  int lane_index = player_zap->orientation == HORIZONTAL
+                       ? player_zap->position.col
+                       : player_zap->position.row;
+
+  /* Draw laser in yellow, only on the visible part of the lane */
+  if (player_zap->orientation == VERTICAL) {
+    if (player_zap->position.row >= nc_viewport.row &&
+        player_zap->position.row < nc_viewport.row + nc_viewport.height) {
+      for (int i = 0; i < nc_viewport.width; i++)
+        backend->put_char(win, ROW_TO_WIN(player_zap->position.row),
+                          POS_TO_WIN(i), '-', NC_COLOR_YELLOW);
+    }
+  } else {
+    if (player_zap->position.col >= nc_viewport.col &&
+        player_zap->position.col < nc_viewport.col + nc_viewport.width) {
+      for (int i = 0; i < nc_viewport.height; i++)
+        backend->put_char(win, POS_TO_WIN(i),
+                          COL_TO_WIN(player_zap->position.col), '|',
+                          NC_COLOR_YELLOW);
     }
   }
-  wattroff(win, COLOR_PAIR(2));
 
   /* Add player that shot back to the screen */
   nc_add_player(win, *player_zap);
 
-  /* Signal players that were stunned with red letters (color pair 1) */
-  wattron(win, COLOR_PAIR(1));
-  for (int i = 0; i < MAX_PLAYERS; i++) {
+  /* Signal players that were stunned (the others on its lane) with red
+   * letters */
+  for (int i = lane_first_player(game, player_zap->orientation, lane_index);
+       i != -1; i = lane_next_player(game, player_zap->orientation, i)) {
     other_player = &game->players[i];
 
-    /* Player is stunned if aligned with the player that shot */
-    if (other_player->connected && other_player->id != player_zap->id) {
-      if ((player_zap->orientation == HORIZONTAL &&
-           player_zap->position.col == other_player->position.col) ||
-          (player_zap->orientation == VERTICAL &&
-           player_zap->position.row == other_player->position.row)) {
-        wmove(win, POS_TO_WIN(other_player->position.row),
-              POS_TO_WIN(other_player->position.col));
-        waddch(win, id_to_symbol(other_player->id) | A_BOLD);
-      }
-    }
+    if (other_player->id != player_zap->id &&
+        NC_IS_VISIBLE(other_player->position))
+      backend->put_char(win, ROW_TO_WIN(other_player->position.row),
+                        COL_TO_WIN(other_player->position.col),
+                        id_to_symbol(other_player->id), NC_COLOR_RED | NC_BOLD);
   }
-  wattroff(win, COLOR_PAIR(1));
 
-  wrefresh(win);
+  nc_refresh(win);
 };
 
 /* Adds a alien to the screen */
-void nc_add_alien(WINDOW *game_window, position_t *position, bool regenerated) {
+void nc_add_alien(nc_window_t *game_window, position_t *position,
+                  bool regenerated) {
 
-  if (regenerated)
-    wattron(game_window, COLOR_PAIR(3));
+  if (!NC_IS_VISIBLE(*position))
+    return;
 
-  wmove(game_window, POS_TO_WIN(position->row), POS_TO_WIN(position->col));
-  waddch(game_window, '*' | A_BOLD);
+  backend->put_char(game_window, ROW_TO_WIN(position->row),
+                    COL_TO_WIN(position->col), '*',
+                    regenerated ? NC_COLOR_GREEN | NC_BOLD : NC_BOLD);
+}
+
+/* Prints the latency percentiles (in ms) of the game updates on the overlay */
+void nc_update_latency(nc_window_t *win, const histogram_t *receive_lag,
+                       const histogram_t *render_lag, uint64_t missed_updates) {
+  nc_printf(win, 2, 1, "recv %5.1f %5.1f %5.1f",
+            histogram_percentile(receive_lag, 50) / 1e6,
+            histogram_percentile(receive_lag, 99) / 1e6,
+            receive_lag->max / 1e6);
+  nc_printf(win, 3, 1, "rndr %5.1f %5.1f %5.1f",
+            histogram_percentile(render_lag, 50) / 1e6,
+            histogram_percentile(render_lag, 99) / 1e6, render_lag->max / 1e6);
+  nc_printf(win, 4, 1, "lost %-17lu", (unsigned long)missed_updates);
+}
 
-  if (regenerated)
-    wattroff(game_window, COLOR_PAIR(3));
+/* Prints the current score on the astronaut window */
+void nc_update_astronaut_score(nc_window_t *win, int score) {
+  nc_printf(win, 9, 1, "Current score: %d", score);
 }
 
 /******************** Cleaning screen ********************/
 
 /* Cleans a position from the screen */
-void nc_clean_position(WINDOW *win, position_t position) {
-  wmove(win, POS_TO_WIN(position.row), POS_TO_WIN(position.col));
-  waddch(win, ' ' | A_BOLD);
+void nc_clean_position(nc_window_t *win, position_t position) {
+  if (!NC_IS_VISIBLE(position))
+    return;
+
+  backend->put_char(win, ROW_TO_WIN(position.row), COL_TO_WIN(position.col),
+                    ' ', NC_BOLD);
 }
 
 /* Cleans a zap from the screen */
-void nc_clean_zap(WINDOW *win, game_t *game, MOVEMENT_ORIENTATION orientation,
-                  int index) {
+void nc_clean_zap(nc_window_t *win, game_t *game,
+                  MOVEMENT_ORIENTATION orientation, int index) {
   player_t *other_player;
 
-  /* Clean entire row/col */
-  for (int i = 0; i < SPACE_SIZE; i++) {
-    if (orientation == VERTICAL)
-      wmove(win, POS_TO_WIN(index), POS_TO_WIN(i));
-    else
-      wmove(win, POS_TO_WIN(i), POS_TO_WIN(index));
-
-    waddch(win, ' ');
+  /* Clean the visible part of the row/col */
+  if (orientation == VERTICAL) {
+    if (index >= nc_viewport.row &&
+        index < nc_viewport.row + nc_viewport.height)
+      for (int i = 0; i < nc_viewport.width; i++)
+        backend->put_char(win, ROW_TO_WIN(index), POS_TO_WIN(i), ' ',
+                          NC_COLOR_DEFAULT);
+  } else {
+    if (index >= nc_viewport.col && index < nc_viewport.col + nc_viewport.width)
+      for (int i = 0; i < nc_viewport.height; i++)
+        backend->put_char(win, POS_TO_WIN(i), COL_TO_WIN(index), ' ',
+                          NC_COLOR_DEFAULT);
   }
 
-  /* Add back players */
-  for (int i = 0; i < MAX_PLAYERS; i++) {
+  /* Add back the players on the row/col */
+  for (int i = lane_first_player(game, orientation, index); i != -1;
+       i = lane_next_player(game, orientation, i)) {
     other_player = &game->players[i];
-    if (other_player->connected)
-      nc_add_player(win, *other_player);
+    nc_add_player(win, *other_player);
   }
 
-  wrefresh(win);
+  nc_refresh(win);
 };
 
-/* Stops and cleanup ncurses */
-void nc_cleanup() { endwin(); }
+/* Stops and cleanup the render backend (printing its counters if the
+ * RENDER_STATS_ENV environment variable is set) */
+void nc_cleanup() {
+  backend->cleanup();
+
+  if (getenv(RENDER_STATS_ENV) != NULL)
+    fprintf(stderr,
+            "Renderer %s: %lu frames, %lu bytes (%.1f bytes/frame, last "
+            "frame %lu bytes)\n",
+            backend->name, (unsigned long)stats.frames,
+            (unsigned long)stats.bytes,
+            stats.frames > 0 ? (double)stats.bytes / stats.frames : 0.0,
+            (unsigned long)stats.last_frame_bytes);
+}
@@ -0,0 +1,279 @@
+/* Render backend that writes ANSI escape sequences directly to the terminal.
+ * It keeps the screen in memory and, on each flush, builds a single buffer
+ * with the cells that changed since the previous frame */
+
+#include "render_backend.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* Size used when the terminal size can't be read */
+#define ANSI_DEFAULT_ROWS 24
+#define ANSI_DEFAULT_COLS 80
+
+/* Style that never matches a real one, so every cell is written at first */
+#define ANSI_UNKNOWN_STYLE 0xffff
+
+typedef struct {
+  char ch;
+  uint16_t style;
+} ansi_cell_t;
+
+/* What the terminal currently shows and what the next frame should show */
+static ansi_cell_t *front_screen, *back_screen;
+static int screen_rows, screen_cols;
+/* Buffer with the escape sequences of a frame */
+static char *frame;
+static size_t frame_size, frame_capacity;
+/* Style the terminal is currently using */
+static int current_style;
+/* Terminal settings to restore on cleanup */
+static struct termios saved_termios;
+static bool termios_saved;
+
+/* Appends bytes to the frame buffer */
+static void frame_append(const char *bytes, size_t size) {
+  if (frame_size + size > frame_capacity) {
+    frame_capacity = (frame_size + size) * 2;
+    frame = (char *)realloc(frame, frame_capacity);
+    assert(frame != NULL);
+  }
+
+  memcpy(frame + frame_size, bytes, size);
+  frame_size += size;
+}
+
+/* Writes the whole buffer to stdout */
+static void write_all(const char *bytes, size_t size) {
+  ssize_t n;
+
+  while (size > 0) {
+    n = write(STDOUT_FILENO, bytes, size);
+    if (n <= 0)
+      return;
+    bytes += n;
+    size -= (size_t)n;
+  }
+}
+
+/* Fills cells with blanks */
+static void fill_blank(ansi_cell_t *cells, size_t n, uint16_t style) {
+  for (size_t i = 0; i < n; i++) {
+    cells[i].ch = ' ';
+    cells[i].style = style;
+  }
+}
+
+/* Prepares the terminal and returns its size */
+static void ansi_init(int *rows, int *cols) {
+  struct winsize size;
+  struct termios raw;
+  const char *setup = "\x1b[?1049h" /* Alternate screen */
+                      "\x1b[?25l"   /* Hide cursor */
+                      "\x1b[0m\x1b[2J";
+
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0) {
+    screen_rows = size.ws_row;
+    screen_cols = size.ws_col;
+  } else {
+    screen_rows = ANSI_DEFAULT_ROWS;
+    screen_cols = ANSI_DEFAULT_COLS;
+  }
+
+  /* Same input mode as ncurses' cbreak and noecho */
+  if (tcgetattr(STDIN_FILENO, &saved_termios) == 0) {
+    termios_saved = true;
+    raw = saved_termios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+  }
+
+  front_screen = (ansi_cell_t *)malloc(sizeof(ansi_cell_t) * screen_rows *
+                                       screen_cols);
+  back_screen = (ansi_cell_t *)malloc(sizeof(ansi_cell_t) * screen_rows *
+                                      screen_cols);
+  assert(front_screen != NULL && back_screen != NULL);
+  fill_blank(front_screen, screen_rows * screen_cols, ANSI_UNKNOWN_STYLE);
+  fill_blank(back_screen, screen_rows * screen_cols, NC_COLOR_DEFAULT);
+  current_style = NC_COLOR_DEFAULT;
+
+  write_all(setup, strlen(setup));
+
+  *rows = screen_rows;
+  *cols = screen_cols;
+}
+
+/* Creates the backend part of a window (size and position already set) */
+static void ansi_create_window(nc_window_t *win) {
+  ansi_cell_t *cells =
+      (ansi_cell_t *)malloc(sizeof(ansi_cell_t) * win->rows * win->cols);
+  assert(cells != NULL);
+
+  fill_blank(cells, win->rows * win->cols, NC_COLOR_DEFAULT);
+  win->handle = cells;
+}
+
+/* Frees the backend part of a window */
+static void ansi_destroy_window(nc_window_t *win) { free(win->handle); }
+
+/* Draws a character on a window position */
+static void ansi_put_char(nc_window_t *win, int row, int col, char ch,
+                          int style) {
+  ansi_cell_t *cell;
+
+  if (row < 0 || row >= win->rows || col < 0 || col >= win->cols)
+    return;
+
+  cell = &((ansi_cell_t *)win->handle)[row * win->cols + col];
+  cell->ch = ch;
+  cell->style = (uint16_t)style;
+}
+
+/* Draws a text on a window position */
+static void ansi_print(nc_window_t *win, int row, int col, const char *text) {
+  for (int i = 0; text[i] != '\0'; i++) {
+    /* Tabs are expanded like ncurses does (every 8 columns) */
+    if (text[i] == '\t') {
+      do
+        ansi_put_char(win, row, col++, ' ', NC_COLOR_DEFAULT);
+      while (col % 8 != 0);
+      continue;
+    }
+
+    ansi_put_char(win, row, col++, text[i], NC_COLOR_DEFAULT);
+  }
+}
+
+/* Draws a border around the window */
+static void ansi_draw_box(nc_window_t *win) {
+  for (int col = 1; col < win->cols - 1; col++) {
+    ansi_put_char(win, 0, col, '-', NC_COLOR_DEFAULT);
+    ansi_put_char(win, win->rows - 1, col, '-', NC_COLOR_DEFAULT);
+  }
+  for (int row = 1; row < win->rows - 1; row++) {
+    ansi_put_char(win, row, 0, '|', NC_COLOR_DEFAULT);
+    ansi_put_char(win, row, win->cols - 1, '|', NC_COLOR_DEFAULT);
+  }
+  ansi_put_char(win, 0, 0, '+', NC_COLOR_DEFAULT);
+  ansi_put_char(win, 0, win->cols - 1, '+', NC_COLOR_DEFAULT);
+  ansi_put_char(win, win->rows - 1, 0, '+', NC_COLOR_DEFAULT);
+  ansi_put_char(win, win->rows - 1, win->cols - 1, '+', NC_COLOR_DEFAULT);
+}
+
+/* Clears the window */
+static void ansi_erase(nc_window_t *win) {
+  fill_blank((ansi_cell_t *)win->handle, win->rows * win->cols,
+             NC_COLOR_DEFAULT);
+}
+
+/* Marks the window to be written on the next flush */
+static void ansi_stage(nc_window_t *win) {
+  ansi_cell_t *cells = (ansi_cell_t *)win->handle;
+  int screen_row, screen_col;
+
+  /* Copy the window to the next frame (clipped to the terminal) */
+  for (int row = 0; row < win->rows; row++) {
+    screen_row = win->start_row + row;
+    if (screen_row < 0 || screen_row >= screen_rows)
+      continue;
+
+    for (int col = 0; col < win->cols; col++) {
+      screen_col = win->start_col + col;
+      if (screen_col < 0 || screen_col >= screen_cols)
+        continue;
+
+      back_screen[screen_row * screen_cols + screen_col] =
+          cells[row * win->cols + col];
+    }
+  }
+}
+
+/* Appends the escape sequence that changes to a style */
+static void append_style(int style) {
+  char sequence[16];
+  int n;
+  const char *colors[] = {"", ";31", ";33", ";32"};
+  int color = style & NC_COLOR_MASK;
+
+  n = snprintf(sequence, sizeof(sequence), "\x1b[0%s%sm",
+               style & NC_BOLD ? ";1" : "", color < 4 ? colors[color] : "");
+  frame_append(sequence, (size_t)n);
+  current_style = style;
+}
+
+/* Writes the staged windows to the terminal, returning the bytes written */
+static size_t ansi_flush() {
+  char sequence[24];
+  int n;
+  int cursor_row = -1, cursor_col = -1;
+  ansi_cell_t *front, *back;
+
+  frame_size = 0;
+
+  for (int row = 0; row < screen_rows; row++) {
+    for (int col = 0; col < screen_cols; col++) {
+      front = &front_screen[row * screen_cols + col];
+      back = &back_screen[row * screen_cols + col];
+
+      if (front->ch == back->ch && front->style == back->style)
+        continue;
+
+      /* Only move the cursor when the cells aren't contiguous */
+      if (row != cursor_row || col != cursor_col) {
+        n = snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", row + 1,
+                     col + 1);
+        frame_append(sequence, (size_t)n);
+      }
+      if (back->style != current_style)
+        append_style(back->style);
+
+      frame_append(&back->ch, 1);
+      *front = *back;
+      cursor_row = row;
+      cursor_col = col + 1;
+    }
+  }
+
+  /* The whole frame goes in a single write */
+  if (frame_size > 0)
+    write_all(frame, frame_size);
+
+  return frame_size;
+}
+
+/* Restores the terminal */
+static void ansi_cleanup() {
+  const char *restore = "\x1b[0m"
+                        "\x1b[?25h"    /* Show cursor */
+                        "\x1b[?1049l"; /* Leave alternate screen */
+
+  write_all(restore, strlen(restore));
+  if (termios_saved)
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+
+  free(front_screen);
+  free(back_screen);
+  free(frame);
+  front_screen = back_screen = NULL;
+  frame = NULL;
+  frame_capacity = 0;
+}
+
+const render_backend_t render_backend_ansi = {
+    .name = "ansi",
+    .init = ansi_init,
+    .create_window = ansi_create_window,
+    .destroy_window = ansi_destroy_window,
+    .put_char = ansi_put_char,
+    .print = ansi_print,
+    .draw_box = ansi_draw_box,
+    .erase_window = ansi_erase,
+    .stage = ansi_stage,
+    .flush = ansi_flush,
+    .cleanup = ansi_cleanup};
@@ -0,0 +1,55 @@
+/* Render backend that doesn't draw anything, used to run headless programs
+ * that only apply the game state (e.g. load tests and benchmarks) */
+
+#include "render_backend.h"
+
+/* Prepares the terminal and returns its size */
+static void null_init(int *rows, int *cols) {
+  /* An empty terminal makes the viewport as small as possible, so almost
+   * every drawing function returns right away */
+  *rows = 0;
+  *cols = 0;
+}
+
+/* Creates the backend part of a window (size and position already set) */
+static void null_create_window(nc_window_t *win) { win->handle = NULL; }
+
+/* Draws a character on a window position */
+static void null_put_char(nc_window_t *win, int row, int col, char ch,
+                          int style) {
+  (void)win;
+  (void)row;
+  (void)col;
+  (void)ch;
+  (void)style;
+}
+
+/* Draws a text on a window position */
+static void null_print(nc_window_t *win, int row, int col, const char *text) {
+  (void)win;
+  (void)row;
+  (void)col;
+  (void)text;
+}
+
+/* Used for the operations that only receive the window */
+static void null_window_operation(nc_window_t *win) { (void)win; }
+
+/* Writes the staged windows to the terminal, returning the bytes written */
+static size_t null_flush() { return 0; }
+
+/* Restores the terminal */
+static void null_cleanup() {}
+
+const render_backend_t render_backend_null = {
+    .name = "null",
+    .init = null_init,
+    .create_window = null_create_window,
+    .destroy_window = null_window_operation,
+    .put_char = null_put_char,
+    .print = null_print,
+    .draw_box = null_window_operation,
+    .erase_window = null_window_operation,
+    .stage = null_window_operation,
+    .flush = null_flush,
+    .cleanup = null_cleanup};
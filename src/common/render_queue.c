@@ -0,0 +1,83 @@
+/* Contains the lock-free queue used to send draw commands to the UI thread */
+
+#include "render_queue.h"
+
+/* Initializes the queue */
+void render_queue_init(render_queue_t *queue) {
+  /* Cell i is free to be written when its sequence is i */
+  for (size_t i = 0; i < RENDER_QUEUE_SIZE; i++)
+    atomic_init(&queue->cells[i].sequence, i);
+
+  atomic_init(&queue->enqueue_pos, 0);
+  queue->dequeue_pos = 0;
+  assert(sem_init(&queue->available, 0, 0) == 0);
+}
+
+/* Pushes a command to the queue (yields while the queue is full) */
+void render_queue_push(render_queue_t *queue, render_command_t *command) {
+  size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+  size_t sequence;
+
+  while (true) {
+    sequence = atomic_load_explicit(
+        &queue->cells[pos & (RENDER_QUEUE_SIZE - 1)].sequence,
+        memory_order_acquire);
+
+    if (sequence == pos) {
+      /* Cell is free, try to claim it (pos is updated if another producer
+       * claimed it first) */
+      if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos,
+                                                pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (sequence < pos) {
+      /* Queue is full, let the UI thread catch up */
+      sched_yield();
+      pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    } else {
+      /* Another producer wrote it meanwhile */
+      pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    }
+  }
+
+  queue->cells[pos & (RENDER_QUEUE_SIZE - 1)].command = *command;
+
+  /* Mark the cell as ready to be read */
+  atomic_store_explicit(&queue->cells[pos & (RENDER_QUEUE_SIZE - 1)].sequence,
+                        pos + 1, memory_order_release);
+  sem_post(&queue->available);
+}
+
+/* Pops a command from the queue, blocking while it is empty */
+void render_queue_pop(render_queue_t *queue, render_command_t *command) {
+  size_t pos = queue->dequeue_pos;
+
+  while (sem_wait(&queue->available) != 0)
+    ;
+
+  /* The semaphore counts finished pushes, but the producer that claimed this
+   * cell may still be finishing its write */
+  while (render_queue_empty(queue))
+    sched_yield();
+
+  *command = queue->cells[pos & (RENDER_QUEUE_SIZE - 1)].command;
+
+  /* Mark the cell as free for the next lap */
+  atomic_store_explicit(&queue->cells[pos & (RENDER_QUEUE_SIZE - 1)].sequence,
+                        pos + RENDER_QUEUE_SIZE, memory_order_release);
+  queue->dequeue_pos = pos + 1;
+}
+
+/* Returns true if there are no commands waiting */
+bool render_queue_empty(render_queue_t *queue) {
+  size_t pos = queue->dequeue_pos;
+
+  return atomic_load_explicit(
+             &queue->cells[pos & (RENDER_QUEUE_SIZE - 1)].sequence,
+             memory_order_acquire) != pos + 1;
+}
+
+/* Destroys the queue */
+void render_queue_destroy(render_queue_t *queue) {
+  sem_destroy(&queue->available);
+}
@@ -0,0 +1,179 @@
+/* Contains the telemetry kept by the game-server */
+
+#include "server_stats.h"
+#include "game_snapshot.h"
+#include "lobby.h"
+#include "trace.h"
+
+/* Fills a summary with the percentiles of a histogram */
+static void summarize_histogram(const histogram_t *histogram,
+                                latency_summary_t *summary) {
+  summary->count = histogram->total;
+  summary->p50 = histogram_percentile(histogram, 50);
+  summary->p99 = histogram_percentile(histogram, 99);
+  summary->max = histogram->max;
+}
+
+/* Adds the service times recorded without the game lock (must hold it) */
+static void merge_lock_free(server_stats_t *stats) {
+  for (int i = 0; i < N_MESSAGE_TYPES; i++) {
+    if (stats->lock_free_service_time[i].total == 0)
+      continue;
+
+    histogram_merge(&stats->current->service_time[i],
+                    &stats->lock_free_service_time[i]);
+    histogram_reset(&stats->lock_free_service_time[i]);
+  }
+
+  stats->lock_free_pending = 0;
+}
+
+/* Clears the histograms of an interval */
+static void interval_reset(stats_interval_t *interval) {
+  for (int i = 0; i < N_MESSAGE_TYPES; i++)
+    histogram_reset(&interval->service_time[i]);
+
+  for (int i = 0; i < N_LOCK_USERS; i++) {
+    histogram_reset(&interval->lock_wait[i]);
+    histogram_reset(&interval->lock_hold[i]);
+  }
+}
+
+/* Clears the stats and starts an interval */
+void server_stats_init(server_stats_t *stats) {
+  interval_reset(&stats->intervals[0]);
+  interval_reset(&stats->intervals[1]);
+  stats->current = &stats->intervals[0];
+  stats->current->start_ns = get_monotonic_ns();
+}
+
+/* Locks the game lock measuring the wait, returning when it was acquired */
+uint64_t server_stats_lock(server_stats_t *stats, pthread_mutex_t *lock,
+                           LOCK_USER user) {
+  uint64_t start_ns = get_monotonic_ns(), acquired_ns;
+
+  TRACE_BEGIN("lock wait");
+  pthread_mutex_lock(lock);
+  TRACE_END("lock wait");
+
+  acquired_ns = get_monotonic_ns();
+  histogram_record(&stats->current->lock_wait[user], acquired_ns - start_ns);
+
+  if (user == LOCK_MAIN_LOOP && stats->lock_free_pending > 0)
+    merge_lock_free(stats);
+
+  return acquired_ns;
+}
+
+/* Unlocks the game lock measuring how long it was held */
+void server_stats_unlock(server_stats_t *stats, pthread_mutex_t *lock,
+                         LOCK_USER user, uint64_t acquired_ns) {
+  histogram_record(&stats->current->lock_hold[user],
+                   get_monotonic_ns() - acquired_ns);
+
+  pthread_mutex_unlock(lock);
+}
+
+/* Records the time taken by a request received at received_ns (must hold the
+ * game lock) */
+void server_stats_record_service(server_stats_t *stats, MESSAGE_TYPE msg_type,
+                                 uint64_t received_ns) {
+  histogram_record(&stats->current->service_time[msg_type],
+                   get_monotonic_ns() - received_ns);
+}
+
+/* Records the time taken by a request answered without the game lock (only
+ * called by the main loop) */
+void server_stats_record_lock_free(server_stats_t *stats,
+                                   pthread_mutex_t *lock, MESSAGE_TYPE msg_type,
+                                   uint64_t received_ns) {
+  histogram_record(&stats->lock_free_service_time[msg_type],
+                   get_monotonic_ns() - received_ns);
+
+  /* Without waiting, so these requests never wait for the lock */
+  if (++stats->lock_free_pending >= STATS_LOCK_FREE_FLUSH &&
+      pthread_mutex_trylock(lock) == 0) {
+    merge_lock_free(stats);
+    pthread_mutex_unlock(lock);
+  }
+}
+
+/* Counts a request shed by the admission control (only called by the main
+ * loop, without the game lock) */
+void server_stats_record_shed(server_stats_t *stats, MESSAGE_TYPE msg_type) {
+  __atomic_fetch_add(&stats->shed[msg_type], 1, __ATOMIC_RELAXED);
+}
+
+/* Starts a new interval, returning the previous one (must hold the game
+ * lock) */
+stats_interval_t *server_stats_swap(server_stats_t *stats) {
+  stats_interval_t *previous = stats->current;
+
+  /* The other one was cleared when it was summarized */
+  stats->current = previous == &stats->intervals[0] ? &stats->intervals[1]
+                                                     : &stats->intervals[0];
+  stats->current->start_ns = get_monotonic_ns();
+  return previous;
+}
+
+/* Fills the update with an interval returned by server_stats_swap and clears
+ * it (without the game lock) */
+void server_stats_summarize(server_stats_t *stats, stats_interval_t *interval,
+                            stats_update_t *stats_update) {
+  /* It ended when the next one started */
+  stats_update->interval_ms =
+      (stats->current->start_ns - interval->start_ns) / 1000000;
+
+  for (int i = 0; i < N_MESSAGE_TYPES; i++)
+    summarize_histogram(&interval->service_time[i],
+                        &stats_update->service_time[i]);
+
+  for (int i = 0; i < N_LOCK_USERS; i++) {
+    summarize_histogram(&interval->lock_wait[i], &stats_update->lock_wait[i]);
+    summarize_histogram(&interval->lock_hold[i], &stats_update->lock_hold[i]);
+  }
+
+  /* Taken and cleared at once, as the main loop doesn't hold the lock */
+  for (int i = 0; i < N_MESSAGE_TYPES; i++)
+    stats_update->shed[i] =
+        __atomic_exchange_n(&stats->shed[i], 0, __ATOMIC_RELAXED);
+
+  interval_reset(interval);
+}
+
+/* Threaded function responsible for publishing the stats periodically */
+void *stats_publish_thread(void *void_args) {
+  stats_publish_thread_args_t *args = (stats_publish_thread_args_t *)void_args;
+  stats_update_t stats_update;
+  stats_interval_t *interval;
+  const game_snapshot_t *snapshot;
+  bool game_over = false;
+
+  TRACE_THREAD_NAME("stats publisher");
+
+  while (!game_over) {
+    usleep(STATS_PUBLISH_INTERVAL * 1000);
+
+    /* ========= Entering critical region ========= */
+    pthread_mutex_lock(args->lock);
+    interval = server_stats_swap(args->stats);
+    game_over = *args->game_over;
+    /* ========= Leaving critical region ========= */
+    pthread_mutex_unlock(args->lock);
+
+    server_stats_summarize(args->stats, interval, &stats_update);
+    pthread_mutex_lock(args->io_lock);
+    zmq_send_msg(args->pub_socket, STATS_UPDATE, &stats_update, -1,
+                 STATS_TOPIC);
+    pthread_mutex_unlock(args->io_lock);
+
+    /* From the latest snapshot, so the game lock isn't needed */
+    if (args->lobby_socket != NULL) {
+      snapshot = snapshot_acquire(args->snapshots);
+      lobby_report_shard(args->lobby_socket, &snapshot->game);
+      snapshot_release(snapshot);
+    }
+  }
+
+  return NULL;
+}
@@ -0,0 +1,237 @@
+/* Contains the shared memory channel of the game-server (see
+ * include/shm_channel.h) */
+
+#include "shm_channel.h"
+#include "utils.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Marks an entry as being written, before its contents change */
+static void entry_write_begin(uint64_t *sequence) {
+  __atomic_store_n(sequence, SHM_WRITING, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/* Checks, after copying an entry, that it wasn't written meanwhile */
+static bool entry_read_end(const uint64_t *sequence, uint64_t expected) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(sequence, __ATOMIC_RELAXED) == expected;
+}
+
+/******************** Writer (game-server) ********************/
+
+/* Creates the segment with the first game state (exits if it can't) */
+shm_channel_t *shm_channel_create(const char *name, const game_t *game) {
+  shm_channel_t *channel = (shm_channel_t *)calloc(1, sizeof(shm_channel_t));
+  shm_segment_t *segment;
+  int fd;
+
+  assert(channel != NULL);
+
+  /* A segment left by a server that crashed is reused (its displays may still
+   * have it mapped) and cleared below, and the epoch of the game tells them to
+   * read it again */
+  fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+  if (fd == -1 || ftruncate(fd, sizeof(shm_segment_t)) != 0) {
+    printf("Couldn't create the shared memory segment %s.\n", name);
+    exit(-1);
+  }
+
+  segment = (shm_segment_t *)mmap(NULL, sizeof(shm_segment_t),
+                                  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  assert(segment != MAP_FAILED);
+  close(fd);
+
+  channel->name = strdup(name);
+  channel->segment = segment;
+
+  memcpy(segment->magic, SHM_MAGIC, sizeof(segment->magic));
+  segment->space_size = SPACE_SIZE;
+  segment->max_players = MAX_PLAYERS;
+  segment->n_aliens = N_ALIENS;
+  /* Odd if the server that crashed was writing the game */
+  segment->game_lock += segment->game_lock % 2;
+  for (int i = 0; i < SHM_RING_SIZE; i++)
+    segment->ring[i].sequence = SHM_WRITING;
+  for (int i = 0; i < SHM_ALIENS_SLOTS; i++)
+    segment->aliens_slots[i].sequence = SHM_WRITING;
+  segment->game.status_code = 200;
+  shm_channel_write_game(channel, game, true, zmq_next_update_sequence());
+
+  /* Only now the readers can use it */
+  __atomic_store_n(&segment->version, SHM_VERSION, __ATOMIC_RELEASE);
+
+  return channel;
+}
+
+/* Writes a game update already published with zmq (the caller serializes the
+ * writes, e.g. with io_lock) */
+void shm_channel_write_update(shm_channel_t *channel, MESSAGE_TYPE msg_type,
+                              const void *msg, uint64_t sequence) {
+  shm_segment_t *segment = channel->segment;
+  shm_update_t *update = &segment->ring[sequence % SHM_RING_SIZE];
+  shm_aliens_slot_t *aliens_slot;
+
+  entry_write_begin(&update->sequence);
+  update->sent_ns = get_monotonic_ns();
+  update->msg_type = msg_type;
+
+  switch (msg_type) {
+  case ACTION_REQUEST:
+    memcpy(&update->data.action_request, msg, sizeof(action_request_t));
+    break;
+
+  case DISCONNECT_REQUEST:
+    memcpy(&update->data.disconnect_request, msg,
+           sizeof(disconnect_request_t));
+    break;
+
+  case ALIENS_UPDATE:
+    update->data.aliens_slot = segment->next_aliens_slot;
+    segment->next_aliens_slot =
+        (segment->next_aliens_slot + 1) % SHM_ALIENS_SLOTS;
+
+    aliens_slot = &segment->aliens_slots[update->data.aliens_slot];
+    entry_write_begin(&aliens_slot->sequence);
+    memcpy(&aliens_slot->aliens_update, msg, sizeof(aliens_update_t));
+    __atomic_store_n(&aliens_slot->sequence, sequence, __ATOMIC_RELEASE);
+    break;
+
+  default:
+    /* The rest have no contents (a ROUND_STARTED is read from the game) */
+    break;
+  }
+
+  __atomic_store_n(&update->sequence, sequence, __ATOMIC_RELEASE);
+}
+
+/* Writes the game state, in which the updates up to next_sequence are applied.
+ * aliens_changed tells if the aliens changed since the last one */
+void shm_channel_write_game(shm_channel_t *channel, const game_t *game,
+                            bool aliens_changed, uint64_t next_sequence) {
+  shm_segment_t *segment = channel->segment;
+  uint64_t game_lock = segment->game_lock;
+
+  __atomic_store_n(&segment->game_lock, game_lock + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  /* The players have no tokens, so they are copied as they are */
+  __atomic_store_n(&segment->game.epoch, zmq_update_epoch(), __ATOMIC_RELAXED);
+  segment->game.next_sequence = next_sequence;
+  memcpy(segment->game.game.players, game->players, sizeof(game->players));
+  memcpy(segment->game.game.row_players, game->row_players,
+         sizeof(game->row_players));
+  memcpy(segment->game.game.col_players, game->col_players,
+         sizeof(game->col_players));
+  segment->game.game.aliens_alive = game->aliens_alive;
+  if (aliens_changed)
+    memcpy(segment->game.game.aliens, game->aliens, sizeof(game->aliens));
+
+  __atomic_store_n(&segment->game_lock, game_lock + 2, __ATOMIC_RELEASE);
+}
+
+/* Unmaps and removes the segment */
+void shm_channel_destroy(shm_channel_t *channel) {
+  munmap(channel->segment, sizeof(shm_segment_t));
+  shm_unlink(channel->name);
+  free(channel->name);
+  free(channel);
+}
+
+/******************** Readers (displays) ********************/
+
+/* Maps a segment to be read, returning NULL if it doesn't exist or is from a
+ * different build */
+const shm_segment_t *shm_channel_map(const char *name) {
+  const shm_segment_t *segment;
+  struct stat segment_stat;
+  int fd = shm_open(name, O_RDONLY, 0);
+
+  if (fd == -1)
+    return NULL;
+  if (fstat(fd, &segment_stat) != 0 ||
+      (size_t)segment_stat.st_size != sizeof(shm_segment_t)) {
+    close(fd);
+    return NULL;
+  }
+
+  segment = (const shm_segment_t *)mmap(NULL, sizeof(shm_segment_t),
+                                        PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED)
+    return NULL;
+
+  if (__atomic_load_n(&segment->version, __ATOMIC_ACQUIRE) != SHM_VERSION ||
+      memcmp(segment->magic, SHM_MAGIC, sizeof(segment->magic)) != 0 ||
+      segment->space_size != SPACE_SIZE ||
+      segment->max_players != MAX_PLAYERS || segment->n_aliens != N_ALIENS) {
+    shm_channel_unmap(segment);
+    return NULL;
+  }
+
+  return segment;
+}
+
+/* Copies the game state (with the sequence of the next update to apply) */
+void shm_channel_read_game(const shm_segment_t *segment,
+                           display_connect_response_t *game) {
+  uint64_t game_lock;
+
+  while (true) {
+    game_lock = __atomic_load_n(&segment->game_lock, __ATOMIC_ACQUIRE);
+    if (game_lock % 2 == 0) {
+      memcpy(game, &segment->game, sizeof(display_connect_response_t));
+      if (entry_read_end(&segment->game_lock, game_lock))
+        return;
+    }
+    sched_yield();
+  }
+}
+
+/* Copies the update with the given sequence (aliens_update receives the
+ * contents of an ALIENS_UPDATE) */
+SHM_READ_RESULT shm_channel_read_update(const shm_segment_t *segment,
+                                        uint64_t sequence,
+                                        shm_update_t *update,
+                                        aliens_update_t *aliens_update) {
+  const shm_update_t *entry = &segment->ring[sequence % SHM_RING_SIZE];
+  const shm_aliens_slot_t *aliens_slot;
+  uint64_t entry_sequence =
+      __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE);
+
+  /* Still has an older update or is being written (if it is a newer one, the
+   * next read finds it) */
+  if (entry_sequence < sequence || entry_sequence == SHM_WRITING)
+    return SHM_NOT_YET;
+  if (entry_sequence > sequence)
+    return SHM_LOST;
+
+  memcpy(update, entry, sizeof(shm_update_t));
+  if (!entry_read_end(&entry->sequence, sequence))
+    return SHM_LOST;
+
+  if (update->msg_type == ALIENS_UPDATE) {
+    aliens_slot = &segment->aliens_slots[update->data.aliens_slot];
+    if (__atomic_load_n(&aliens_slot->sequence, __ATOMIC_ACQUIRE) != sequence)
+      return SHM_LOST;
+
+    memcpy(aliens_update, &aliens_slot->aliens_update,
+           sizeof(aliens_update_t));
+    if (!entry_read_end(&aliens_slot->sequence, sequence))
+      return SHM_LOST;
+  }
+
+  return SHM_READ;
+}
+
+/* Unmaps a segment mapped by shm_channel_map */
+void shm_channel_unmap(const shm_segment_t *segment) {
+  munmap((void *)segment, sizeof(shm_segment_t));
+}
@@ -1,21 +1,38 @@
-/* Contains applications main functions that have the option to be ran in a
- * secondary thread, and receive threaded_mains_args_t to manage execution */
+/* Contains applications main functions (roles) that run in a secondary thread
+ * and receive threaded_mains_args_t to manage execution. They never use
+ * the render backend directly, instead they send draw commands to the UI
+ * thread */
 
 #include "threaded_mains.h"
 
+/* Returns the message printed when the game-server stops replying (printed by
+ * the UI thread once the render backend is closed) */
+static char *server_lost_message() {
+  char *exit_message = (char *)malloc(64);
+
+  assert(exit_message != NULL);
+  snprintf(exit_message, 64, "Lost the connection to the game-server.\n");
+  return exit_message;
+}
+
 /* Thread ready implementation of the astronaut client main */
 void *astronaut_client_main(void *void_args) {
 
   /* Threaded args */
   threaded_mains_args_t *args = (threaded_mains_args_t *)void_args;
   /* ZeroMQ/comms related */
-  void *zmq_context = zmq_get_context();
-  void *req_socket = zmq_create_socket(zmq_context, ZMQ_REQ);
+  void *req_socket = zmq_create_socket(args->zmq_context, ZMQ_REQ);
+  /* The lobby, if any, until it places the astronaut on a shard */
+  char server_address[ADDRESS_SIZE];
   MESSAGE_TYPE msg_type;
   bool send_action_message = false;
-  /* Ncurses */
-  WINDOW *window;
-  /* Structs to receive and send the requests */
+  /* UI related */
+  render_command_t command;
+  char *exit_message = NULL;
+  action_request_t *local_action;
+  /* Structs to receive and send the requests (the connect one is the same
+   * when resent, so it gets the player created by the first one) */
+  astronaut_connect_request_t connect_request = new_connect_request();
   astronaut_connect_response_t *connect_response;
   action_request_t action_request;
   action_response_t *action_response;
@@ -30,51 +47,89 @@ void *astronaut_client_main(void *void_args) {
   int player_score = 0;
   MOVEMENT_ORIENTATION player_orientation;
   /* Zap/stunned timeout related */
-  uint64_t current_ts = get_timestamp_ms();
+  uint64_t current_ts = game_clock_now_ms();
   uint64_t next_allowed_zap_timestamp = current_ts;
   uint64_t next_allowed_action_timestamp = current_ts;
 
-  /* ZeroMQ initialization */
-  zmq_connect_socket(req_socket, SERVER_ZMQ_REQREP_ADDRESS);
+  TRACE_THREAD_NAME("astronaut role");
 
-  /* Connect to server to get player info */
-  zmq_send_msg(req_socket, ASTRONAUT_CONNECT_REQUEST, NULL, -1, NO_TOPIC);
-  connect_response = (astronaut_connect_response_t *)zmq_receive_msg(
-      req_socket, &msg_type, NO_TOPIC);
+  /* ZeroMQ initialization */
+  snprintf(server_address, ADDRESS_SIZE, "%s", lobby_connect_address());
+  zmq_connect_socket(req_socket, server_address);
+
+  /* Connect to server to get player info (the requests are retried while the
+   * server restarts, which resumes the match with the same players) */
+  connect_response = (astronaut_connect_response_t *)zmq_request(
+      &req_socket, args->zmq_context, server_address,
+      ASTRONAUT_CONNECT_REQUEST, &connect_request, &msg_type);
+
+  if (connect_response == NULL || connect_response->status_code != 200) {
+    if (connect_response == NULL)
+      exit_message = server_lost_message();
+    else {
+      /* Printed by the UI thread once the render backend is closed */
+      exit_message = (char *)malloc(64);
+      assert(exit_message != NULL);
+      if (connect_response->status_code == 429)
+        snprintf(exit_message, 64, "The server is busy, try again later.\n");
+      else
+        snprintf(exit_message, 64,
+                 "Game is full (%d players currently playing).\n",
+                 MAX_PLAYERS);
+    }
 
-  if (connect_response->status_code != 200) {
-    printf("Game is full (%d players currently playing).\n", MAX_PLAYERS);
-    zmq_cleanup(zmq_context, req_socket, NULL);
-    exit(-1);
+    free(connect_response);
+    zmq_cleanup(NULL, req_socket, NULL);
+    *args->terminate_threads = true;
+    ui_role_done(args->ui, exit_message);
+    return NULL;
   } else {
     player_id = connect_response->id;
     player_token = connect_response->token;
     player_orientation = connect_response->orientation;
   }
+
+  /* Placed by a lobby: the rest of the requests (and the display) go to the
+   * shard */
+  if (lobby_follow_shard(req_socket, server_address, connect_response)) {
+    snprintf(server_address, ADDRESS_SIZE, "%s",
+             connect_response->reqrep_address);
+    if (args->placement != NULL) {
+      memcpy(args->placement->reqrep_address, connect_response->reqrep_address,
+             ADDRESS_SIZE);
+      memcpy(args->placement->pubsub_address, connect_response->pubsub_address,
+             ADDRESS_SIZE);
+      args->placement->placed = true;
+    }
+  }
   free(connect_response);
 
-  /* Ncurses initialization */
-  if (args->threaded)
-    pthread_mutex_lock(args->ncurses_lock);
-  nc_init();
-  window =
-      nc_init_astronaut(player_orientation, player_id, args->threaded ? 22 : 0);
-  if (args->threaded)
-    pthread_mutex_unlock(args->ncurses_lock);
+  /* Draw the astronaut window (the display, if any, also follows the player) */
+  command.type = RENDER_ASTRONAUT_INIT;
+  command.data = NULL;
+  command.value = player_id;
+  command.orientation = player_orientation;
+  render_queue_push(&args->ui->render_queue, &command);
+
+  /* The keys are read directly from the terminal, so wait for the render
+   * backend to configure it */
+  ui_wait_ready(args->ui);
 
   /* Define known parts of the requests already */
   action_request.id = player_id;
   action_request.token = player_token;
+  action_request.sequence = 0;
   disconnect_request.id = player_id;
   disconnect_request.token = player_token;
 
-  /* Game loop */
-  while (!(stop_playing || (args->threaded && *args->terminate_threads))) {
-    key_pressed = wgetch(window);
-    current_ts = get_timestamp_ms();
+  /* Game loop (input is never blocked by the screen updates) */
+  while (!(stop_playing || *args->terminate_threads)) {
+    key_pressed = ui_read_key(UI_INPUT_POLL_MS);
+    game_clock_refresh();
+    current_ts = game_clock_now_ms();
 
     switch (key_pressed) {
-    case 65: // KEY_UP
+    case KEY_UP:
 
       /* Player is stunned */
       if (current_ts < next_allowed_action_timestamp)
@@ -87,7 +142,7 @@ void *astronaut_client_main(void *void_args) {
       action_request.movement_direction = UP;
       break;
 
-    case 66: // KEY_DOWN
+    case KEY_DOWN:
 
       /* Player is stunned */
       if (current_ts < next_allowed_action_timestamp)
@@ -100,7 +155,7 @@ void *astronaut_client_main(void *void_args) {
       action_request.movement_direction = DOWN;
       break;
 
-    case 68: // KEY_LEFT
+    case KEY_LEFT:
 
       /* Player is stunned */
       if (current_ts < next_allowed_action_timestamp)
@@ -113,7 +168,7 @@ void *astronaut_client_main(void *void_args) {
       action_request.movement_direction = LEFT;
       break;
 
-    case 67: // KEY_RIGHT
+    case KEY_RIGHT:
 
       /* Player is stunned */
       if (current_ts < next_allowed_action_timestamp)
@@ -144,172 +199,410 @@ void *astronaut_client_main(void *void_args) {
       /* Send disconnect message and stop playing */
       send_action_message = false;
       stop_playing = true;
-      if (args->threaded)
-        *args->terminate_threads = true;
-      zmq_send_msg(req_socket, DISCONNECT_REQUEST, &disconnect_request, -1,
-                   NO_TOPIC);
+      *args->terminate_threads = true;
       status_code_and_score_response =
-          (status_code_and_score_response_t *)zmq_receive_msg(
-              req_socket, &msg_type, NO_TOPIC);
+          (status_code_and_score_response_t *)zmq_request(
+              &req_socket, args->zmq_context, server_address,
+              DISCONNECT_REQUEST, &disconnect_request, &msg_type);
+      if (status_code_and_score_response == NULL) {
+        exit_message = server_lost_message();
+        break;
+      }
       assert(status_code_and_score_response->status_code == 200);
       player_score = status_code_and_score_response->player_score;
       free(status_code_and_score_response);
       break;
 
     default:
-      /* No messages are sent when another key is pressed */
+      /* No messages are sent when another key (or none) is pressed */
       send_action_message = false;
-      break;
+      continue;
     }
 
     /* Only send the message if a valid action key was pressed */
     if (send_action_message) {
-      zmq_send_msg(req_socket, ACTION_REQUEST, &action_request, -1, NO_TOPIC);
+      action_response = (action_response_t *)zmq_request(
+          &req_socket, args->zmq_context, server_address,
+          ACTION_REQUEST, &action_request, &msg_type);
 
-      action_response =
-          (action_response_t *)zmq_receive_msg(req_socket, &msg_type, NO_TOPIC);
+      if (action_response == NULL) {
+        exit_message = server_lost_message();
+        *args->terminate_threads = true;
+        break;
+      }
 
+      /* The server sends the time left, which is only comparable with the
+       * clock of this program */
+      game_clock_refresh();
+      current_ts = game_clock_now_ms();
       player_score = action_response->player_score;
       next_allowed_action_timestamp =
-          action_response->next_allowed_action_timestamp;
-      next_allowed_zap_timestamp = action_response->next_allowed_zap_timestamp;
+          current_ts + action_response->action_wait_ms;
+      next_allowed_zap_timestamp = current_ts + action_response->zap_wait_ms;
+
+      /* When sharing the screen with a display, apply the accepted action right
+       * away (its broadcast is ignored later) */
+      if (action_response->status_code == 200 && args->ui->has_display) {
+        local_action = (action_request_t *)malloc(sizeof(action_request_t));
+        assert(local_action != NULL);
+        *local_action = action_request;
+        local_action->token = -1; /* Invalidate token */
+
+        command.type = RENDER_LOCAL_ACTION;
+        command.data = local_action;
+        command.value = player_score;
+        render_queue_push(&args->ui->render_queue, &command);
+      }
+      action_request.sequence++;
 
       free(action_response);
 
       send_action_message = false;
     }
 
-    /* Position cursor and print current score */
-    if (args->threaded)
-      pthread_mutex_lock(args->ncurses_lock);
-    wmove(window, 9, 1);
-    wprintw(window, "Current score: %d", player_score);
-    if (args->threaded)
-      pthread_mutex_unlock(args->ncurses_lock);
+    /* Print current score */
+    command.type = RENDER_ASTRONAUT_SCORE;
+    command.data = NULL;
+    command.value = player_score;
+    render_queue_push(&args->ui->render_queue, &command);
   }
 
   /* Resources cleanup */
-  zmq_cleanup(zmq_context, req_socket, NULL);
-  if (args->threaded)
-    pthread_mutex_lock(args->ncurses_lock);
-  nc_cleanup();
-  if (args->threaded)
-    pthread_mutex_unlock(args->ncurses_lock);
+  zmq_cleanup(NULL, req_socket, NULL);
+  ui_role_done(args->ui, exit_message);
 
   return NULL;
 }
 
+/* Sends the keys pressed to the UI thread, which scrolls the viewport */
+static void display_push_keys(threaded_mains_args_t *args) {
+  render_command_t command;
+  int key_pressed;
+
+  while ((key_pressed = ui_read_key(0)) != ERR) {
+    command.type = RENDER_SCROLL;
+    command.data = NULL;
+    command.value = key_pressed;
+    render_queue_push(&args->ui->render_queue, &command);
+  }
+}
+
+/* Returns a buffer for an update given to the UI thread (which frees it, like
+ * the ones received with zmq) */
+static void *display_alloc_update(size_t size) {
+  void *data = malloc(size);
+
+  assert(data != NULL);
+  return data;
+}
+
+/* Reads the game from the shared memory channel until it has the updates
+ * before next_sequence, returning it to be given to the UI thread */
+static display_connect_response_t *
+display_read_shm_game(const shm_segment_t *segment, uint64_t next_sequence) {
+  display_connect_response_t *game = (display_connect_response_t *)
+      display_alloc_update(sizeof(display_connect_response_t));
+
+  /* The server writes the game right after the updates */
+  shm_channel_read_game(segment, game);
+  while (game->next_sequence < next_sequence) {
+    usleep(SHM_POLL_US);
+    shm_channel_read_game(segment, game);
+  }
+
+  return game;
+}
+
+/* Same as the display role of outer_space_display_main, but reading the game
+ * and the updates from the shared memory channel of the server (without a
+ * syscall per update) */
+static void display_from_shm(threaded_mains_args_t *args,
+                             const shm_segment_t *segment,
+                             bool scroll_with_keys) {
+  render_command_t command;
+  shm_update_t update;
+  SHM_READ_RESULT result;
+  aliens_update_t *aliens_update =
+      (aliens_update_t *)display_alloc_update(sizeof(aliens_update_t));
+  display_connect_response_t *game;
+  uint64_t epoch, next_sequence;
+  bool game_ended = false, restarted;
+
+  /* The UI thread takes ownership of the game state */
+  game = display_read_shm_game(segment, 0);
+  epoch = game->epoch;
+  next_sequence = game->next_sequence;
+  command.type = RENDER_GAME_INIT;
+  command.data = game;
+  render_queue_push(&args->ui->render_queue, &command);
+
+  if (scroll_with_keys)
+    ui_wait_ready(args->ui);
+
+  while (!(game_ended || *args->terminate_threads)) {
+    /* A restarted server started the sequences over (see shm_channel.h) */
+    restarted =
+        __atomic_load_n(&segment->game.epoch, __ATOMIC_RELAXED) != epoch;
+    result = restarted ? SHM_LOST
+                       : shm_channel_read_update(segment, next_sequence,
+                                                 &update, aliens_update);
+
+    /* Only waits (and reads the keys) when there is nothing new */
+    if (result == SHM_NOT_YET) {
+      if (scroll_with_keys)
+        display_push_keys(args);
+      usleep(SHM_POLL_US);
+      continue;
+    }
+
+    command.type = RENDER_GAME_UPDATE;
+    command.header.sequence = next_sequence;
+    command.header.sent_ns = update.sent_ns;
+
+    if (result == SHM_LOST || update.msg_type == ROUND_STARTED) {
+      /* Replaced by a newer game (or the one of a restarted server), drawn
+       * the same way as a new round (the updates lost are counted as
+       * missed) */
+      game = display_read_shm_game(segment,
+                                   restarted ? 0 : next_sequence + 1);
+      epoch = game->epoch;
+      command.msg_type = ROUND_STARTED;
+      command.data = game;
+      command.header.sequence = game->next_sequence - 1;
+      if (result == SHM_LOST)
+        command.header.sent_ns = get_monotonic_ns();
+      next_sequence = game->next_sequence;
+    } else {
+      command.msg_type = (MESSAGE_TYPE)update.msg_type;
+      command.data = NULL;
+      switch (update.msg_type) {
+      case ACTION_REQUEST:
+        command.data = display_alloc_update(sizeof(action_request_t));
+        memcpy(command.data, &update.data.action_request,
+               sizeof(action_request_t));
+        break;
+
+      case DISCONNECT_REQUEST:
+        command.data = display_alloc_update(sizeof(disconnect_request_t));
+        memcpy(command.data, &update.data.disconnect_request,
+               sizeof(disconnect_request_t));
+        break;
+
+      case ALIENS_UPDATE:
+        command.data = aliens_update;
+        aliens_update =
+            (aliens_update_t *)display_alloc_update(sizeof(aliens_update_t));
+        break;
+
+      case GAME_ENDED:
+        game_ended = true;
+        *args->terminate_threads = true;
+        break;
+
+      default:
+        break;
+      }
+      next_sequence++;
+    }
+
+    /* The UI thread applies the update and frees the message */
+    command.received_ns = get_monotonic_ns();
+    render_queue_push(&args->ui->render_queue, &command);
+  }
+
+  free(aliens_update);
+}
+
+/* Requests the game state to the server (again after a while if it is busy,
+ * see include/admission.h), returning it to be given to the UI thread */
+static display_connect_response_t *display_request_game(void *req_socket) {
+  display_connect_response_t *display_connect_response;
+  MESSAGE_TYPE msg_type;
+
+  while (true) {
+    zmq_send_msg(req_socket, DISPLAY_CONNECT_REQUEST, NULL, -1, NO_TOPIC);
+    display_connect_response = (display_connect_response_t *)zmq_receive_msg(
+        req_socket, &msg_type, NO_TOPIC);
+    if (display_connect_response->status_code != 429)
+      break;
+    free(display_connect_response);
+    usleep(ADMISSION_RETRY_MS * 1000);
+  }
+  assert(display_connect_response->status_code == 200);
+
+  return display_connect_response;
+}
+
+/* Subscribes to the tiles of the part of the board shown on the screen, if it
+ * changed since the last time (area) */
+static void display_follow_tiles(threaded_mains_args_t *args, void *sub_socket,
+                                 int tile_size, bool *subscribed,
+                                 viewport_t *area) {
+  viewport_t visible_area = ui_visible_area(args->ui);
+
+  if (memcmp(&visible_area, area, sizeof(viewport_t)) == 0)
+    return;
+
+  *area = visible_area;
+  tiles_subscribe_area(sub_socket, tile_size, area->row, area->col,
+                       area->height, area->width, subscribed);
+}
+
 /* Thread ready implementation of the outer-space-display main */
 void *outer_space_display_main(void *void_args) {
   /* Threaded args */
   threaded_mains_args_t *args = (threaded_mains_args_t *)void_args;
   /* ZeroMQ/comms related */
-  void *zmq_context = zmq_get_context();
-  void *req_socket = zmq_create_socket(zmq_context, ZMQ_REQ);
-  void *sub_socket = zmq_create_socket(zmq_context, ZMQ_SUB);
+  void *req_socket = zmq_create_socket(args->zmq_context, ZMQ_REQ);
+  void *sub_socket = zmq_create_socket(args->zmq_context, ZMQ_SUB);
   MESSAGE_TYPE msg_type;
+  /* UI related */
+  render_command_t command;
   /* Structs and temp pointer to receive/send requests/responses */
   void *temp_pointer;
   display_connect_response_t *display_connect_response;
-  action_request_t *action_request;
-  disconnect_request_t *disconnect_request;
-  aliens_update_t *alien_update_request;
-  /* Ncurses related */
-  WINDOW *game_window, *score_window;
   /* Game management related */
-  game_t *game;
   bool game_ended = false;
+  uint64_t epoch, next_sequence;
+  /* Tiles subscribed to, when the server splits the board (the ones of a tick
+   * have its sequence) */
+  int tile_size;
+  bool *subscribed = NULL;
+  viewport_t area = {-1, -1, -1, -1};
+  uint64_t tick_sequence = UINT64_MAX;
+  /* When there is no astronaut, the keyboard scrolls the viewport (unless
+   * there is no terminal, e.g. a headless display with the null renderer) */
+  bool scroll_with_keys = !args->ui->has_astronaut && isatty(STDIN_FILENO);
+  /* Shared memory channel of the server (NULL if not on the same machine) */
+  const char *shm_name = getenv(SHM_ENV);
+  const shm_segment_t *segment =
+      shm_name != NULL ? shm_channel_map(shm_name) : NULL;
+  zmq_pollitem_t poll_items[2] = {{sub_socket, 0, ZMQ_POLLIN, 0},
+                                  {NULL, STDIN_FILENO, ZMQ_POLLIN, 0}};
+
+  TRACE_THREAD_NAME("display role");
+
+  if (segment != NULL) {
+    display_from_shm(args, segment, scroll_with_keys);
+    shm_channel_unmap(segment);
+    zmq_cleanup(NULL, req_socket, sub_socket);
+    ui_role_done(args->ui, NULL);
+    return NULL;
+  }
 
-  /* ZeroMQ initialization */
-  zmq_connect_socket(req_socket, SERVER_ZMQ_REQREP_ADDRESS);
-  zmq_connect_socket(sub_socket, SERVER_ZMQ_PUBSUB_ADDRESS);
+  /* The display of an astronaut placed by a lobby follows it to its shard */
+  while (args->placement != NULL && !args->placement->placed) {
+    if (*args->terminate_threads) {
+      zmq_cleanup(NULL, req_socket, sub_socket);
+      ui_role_done(args->ui, NULL);
+      return NULL;
+    }
+    usleep(1000);
+  }
+
+  /* ZeroMQ initialization (the server, a shard or a space-relay) */
+  zmq_connect_socket(
+      req_socket,
+      zmq_address_from_env(DISPLAY_REQREP_ENV,
+                           args->placement != NULL
+                               ? args->placement->reqrep_address
+                               : zmq_server_reqrep_address()));
+  zmq_connect_socket(
+      sub_socket,
+      zmq_address_from_env(DISPLAY_PUBSUB_ENV,
+                           args->placement != NULL
+                               ? args->placement->pubsub_address
+                               : zmq_server_pubsub_address()));
   zmq_subscribe(sub_socket, GAME_UPDATES_TOPIC);
 
   /* Connect to server to get current game state */
-  zmq_send_msg(req_socket, DISPLAY_CONNECT_REQUEST, NULL, -1, NO_TOPIC);
-  display_connect_response = (display_connect_response_t *)zmq_receive_msg(
-      req_socket, &msg_type, NO_TOPIC);
-  assert(display_connect_response->status_code == 200);
-  game = &display_connect_response->game;
-
-  /* Ncurses initialization */
-  if (args->threaded)
-    pthread_mutex_lock(args->ncurses_lock);
-  nc_init();
-  game_window = nc_init_space();
-  score_window = nc_init_scoreboard();
-  nc_draw_init_game(game_window, score_window, *game);
-  if (args->threaded)
-    pthread_mutex_unlock(args->ncurses_lock);
-
-  /* Game loop */
-  while (!(game_ended || (args->threaded && *args->terminate_threads))) {
-    temp_pointer = zmq_receive_msg(sub_socket, &msg_type, GAME_UPDATES_TOPIC);
-
-    if (args->threaded)
-      pthread_mutex_lock(args->ncurses_lock);
-
-    switch (msg_type) {
-    case ASTRONAUT_CONNECT_REQUEST:
-      /* NULL because display doesn't send a reply or manage tokens */
-      handle_player_connect(game_window, NULL, NULL, game);
-      break;
+  display_connect_response = display_request_game(req_socket);
+  epoch = display_connect_response->epoch;
+  next_sequence = display_connect_response->next_sequence;
+  tile_size = display_connect_response->tile_size;
+
+  /* The UI thread takes ownership of the game state */
+  command.type = RENDER_GAME_INIT;
+  command.data = display_connect_response;
+  render_queue_push(&args->ui->render_queue, &command);
+
+  /* The keys are read directly from the terminal, so wait for the render
+   * backend to configure it */
+  if (scroll_with_keys || tile_size > 0)
+    ui_wait_ready(args->ui);
+
+  /* Only the visible aliens are received from now on (the updates received
+   * twice meanwhile are skipped as any other already applied) */
+  if (tile_size > 0) {
+    subscribed = (bool *)calloc(
+        tiles_per_side(tile_size) * tiles_per_side(tile_size), sizeof(bool));
+    assert(subscribed != NULL);
+    zmq_subscribe(sub_socket, PLAYER_UPDATES_TOPIC);
+    display_follow_tiles(args, sub_socket, tile_size, subscribed, &area);
+    zmq_unsubscribe(sub_socket, GAME_UPDATES_TOPIC);
+  }
 
-    case ACTION_REQUEST:
-      action_request = (action_request_t *)temp_pointer;
-      handle_player_action(action_request, &game->players[action_request->id],
-                           game_window, game, args->ncurses_lock);
-      break;
+  /* Game loop (polls with a timeout to notice when it should stop) */
+  while (!(game_ended || *args->terminate_threads)) {
+    assert(zmq_poll(poll_items, scroll_with_keys ? 2 : 1, UI_INPUT_POLL_MS) !=
+           -1);
 
-    case DISCONNECT_REQUEST:
-      disconnect_request = (disconnect_request_t *)temp_pointer;
-      handle_player_disconnect(game_window,
-                               &game->players[disconnect_request->id]);
-      break;
+    if (scroll_with_keys && (poll_items[1].revents & ZMQ_POLLIN))
+      display_push_keys(args);
+    if (tile_size > 0)
+      display_follow_tiles(args, sub_socket, tile_size, subscribed, &area);
 
-    case ALIENS_UPDATE:
-      alien_update_request = (aliens_update_t *)temp_pointer;
-      handle_aliens_updates(game_window, alien_update_request, game);
-      break;
+    if (!(poll_items[0].revents & ZMQ_POLLIN))
+      continue;
 
-    case GAME_ENDED:
-      game_ended = true;
-      if (args->threaded)
-        *args->terminate_threads = true;
-      break;
+    temp_pointer = zmq_receive_stamped_msg(sub_socket, &msg_type,
+                                           GAME_UPDATES_TOPIC, &command.header);
+    command.received_ns = get_monotonic_ns();
+
+    /* The server restarted (e.g. from a checkpoint) and started the sequences
+     * over, so its game replaces this one, drawn as a new round (the update
+     * is then skipped if the game already has it) */
+    if (command.header.epoch != epoch) {
+      display_connect_response = display_request_game(req_socket);
+      epoch = display_connect_response->epoch;
+      next_sequence = display_connect_response->next_sequence;
+      tick_sequence = UINT64_MAX;
+
+      command.type = RENDER_GAME_UPDATE;
+      command.msg_type = ROUND_STARTED;
+      command.data = display_connect_response;
+      render_queue_push(&args->ui->render_queue, &command);
+    }
 
-    default:
+    /* Already applied to the game state received (but for the other tiles of
+     * the last tick) */
+    if (command.header.sequence < next_sequence &&
+        !(msg_type == ALIENS_TILE_UPDATE &&
+          command.header.sequence == tick_sequence)) {
       if (temp_pointer != NULL)
         free(temp_pointer);
-      if (args->threaded)
-        pthread_mutex_unlock(args->ncurses_lock);
       continue;
     }
+    next_sequence = command.header.sequence + 1;
+    if (msg_type == ALIENS_TILE_UPDATE)
+      tick_sequence = command.header.sequence;
 
-    if (temp_pointer != NULL)
-      free(temp_pointer);
-
-    /* Update scoreboard and refresh game windows */
-    nc_update_scoreboard(score_window, game->players, game->aliens_alive);
-    wrefresh(game_window);
-    wrefresh(score_window);
+    if (msg_type == GAME_ENDED) {
+      game_ended = true;
+      *args->terminate_threads = true;
+    }
 
-    if (args->threaded)
-      pthread_mutex_unlock(args->ncurses_lock);
+    /* The UI thread applies the update and frees the message */
+    command.type = RENDER_GAME_UPDATE;
+    command.msg_type = msg_type;
+    command.data = temp_pointer;
+    render_queue_push(&args->ui->render_queue, &command);
   }
 
   /* Resources cleanup */
-  if (args->threaded)
-    pthread_mutex_lock(args->ncurses_lock);
-  /* It might have exited without the game ending (when running
-                  in threaded/joint mode and the user pressed Q) */
-  if (game_ended)
-    print_winning_player(game);
-  nc_cleanup();
-  if (args->threaded)
-    pthread_mutex_unlock(args->ncurses_lock);
-  free(display_connect_response);
-  zmq_cleanup(zmq_context, req_socket, sub_socket);
+  free(subscribed);
+  zmq_cleanup(NULL, req_socket, sub_socket);
+  ui_role_done(args->ui, NULL);
 
   return NULL;
-}
\ No newline at end of file
+}
@@ -0,0 +1,270 @@
+/* Contains the tiles of the board (see include/tiles.h) */
+
+#include "tiles.h"
+#include "zeromq_wrapper.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************** Board ********************/
+
+/* Returns the tile size set by TILES_ENV (within TILES_MIN_SIZE and the board
+ * size), or 0 if the board isn't split */
+int tiles_size_from_env() {
+  const char *tile_size_env = getenv(TILES_ENV);
+  int tile_size = tile_size_env != NULL ? atoi(tile_size_env) : 0;
+
+  if (tile_size <= 0)
+    return 0;
+  if (tile_size < TILES_MIN_SIZE)
+    tile_size = TILES_MIN_SIZE;
+  return tile_size < SPACE_SIZE ? tile_size : SPACE_SIZE;
+}
+
+/* Returns the number of tiles on each side of the board */
+int tiles_per_side(int tile_size) {
+  return (SPACE_SIZE + tile_size - 1) / tile_size;
+}
+
+/* Returns the tile of a board position */
+int tile_of(position_t position, int tile_size) {
+  return position.row / tile_size * tiles_per_side(tile_size) +
+         position.col / tile_size;
+}
+
+/* Marks the tiles of a board area (height rows and width cols from row/col),
+ * or only its top left one if it is empty */
+static void tiles_in_area(int tile_size, int row, int col, int height,
+                          int width, bool *in_area) {
+  int per_side = tiles_per_side(tile_size);
+  int first_row = row / tile_size, first_col = col / tile_size;
+  int last_row = (row + (height > 0 ? height - 1 : 0)) / tile_size;
+  int last_col = (col + (width > 0 ? width - 1 : 0)) / tile_size;
+
+  for (int tile_row = 0; tile_row < per_side; tile_row++)
+    for (int tile_col = 0; tile_col < per_side; tile_col++)
+      in_area[tile_row * per_side + tile_col] =
+          tile_row >= first_row && tile_row <= last_row &&
+          tile_col >= first_col && tile_col <= last_col;
+}
+
+/******************** Server ********************/
+
+/* Creates the tiles of the given size */
+tiles_t *tiles_create(int tile_size) {
+  tiles_t *tiles = (tiles_t *)calloc(1, sizeof(tiles_t));
+
+  assert(tiles != NULL);
+  assert(tile_size > 0);
+
+  tiles->tile_size = tile_size;
+  tiles->per_side = tiles_per_side(tile_size);
+  tiles->n_tiles = tiles->per_side * tiles->per_side;
+  tiles->counts = (int *)calloc(tiles->n_tiles, sizeof(int));
+  tiles->changed = (bool *)calloc(tiles->n_tiles, sizeof(bool));
+  tiles->offsets = (size_t *)calloc(tiles->n_tiles, sizeof(size_t));
+  /* An alien is listed at most twice (where it was and where it is) */
+  tiles->buffer = (char *)malloc(tiles->n_tiles * sizeof(aliens_tile_update_t) +
+                                 2 * N_ALIENS * sizeof(tile_alien_t));
+  assert(tiles->counts != NULL && tiles->changed != NULL &&
+         tiles->offsets != NULL && tiles->buffer != NULL);
+
+  return tiles;
+}
+
+/* Returns the message of a tile in the buffer */
+static aliens_tile_update_t *tile_message(tiles_t *tiles, int tile) {
+  return (aliens_tile_update_t *)(tiles->buffer + tiles->offsets[tile]);
+}
+
+/* Lists an alien on a tile (its place was counted by the first pass) */
+static void tile_list_alien(tiles_t *tiles, int tile, int index,
+                            const alien_t *alien) {
+  aliens_tile_update_t *message = tile_message(tiles, tile);
+  tile_alien_t *tile_alien = &message->aliens[message->n_aliens++];
+
+  tile_alien->index = index;
+  tile_alien->alien = *alien;
+}
+
+/* Publishes the aliens of each tile after a tick (from the previous generation
+ * to the next one), with the header of its ALIENS_UPDATE */
+void tiles_publish_aliens(tiles_t *tiles, void *pub_socket,
+                          const aliens_update_t *previous,
+                          const aliens_update_t *next, int aliens_alive,
+                          const update_header_t *header) {
+  const alien_t *before, *after;
+  int tile_before, tile_after;
+  size_t offset = 0, size;
+  aliens_tile_update_t *message, tick_end;
+  bool changed;
+
+  /*
+    Two passes over the aliens (a counting sort): the first counts the aliens
+    of each tile, so the messages can be laid out one after the other, and
+    the second lists them. The aliens dead before and after the tick aren't
+    listed anywhere
+  */
+  memset(tiles->counts, 0, tiles->n_tiles * sizeof(int));
+  memset(tiles->changed, 0, tiles->n_tiles * sizeof(bool));
+  for (int i = 0; i < N_ALIENS; i++) {
+    before = &previous->aliens[i];
+    after = &next->aliens[i];
+    tile_before = tile_of(before->position, tiles->tile_size);
+    tile_after = tile_of(after->position, tiles->tile_size);
+    changed = before->alive != after->alive ||
+              before->position.row != after->position.row ||
+              before->position.col != after->position.col;
+
+    if (after->alive) {
+      tiles->counts[tile_after]++;
+      tiles->changed[tile_after] |= changed;
+    }
+    if (before->alive && (!after->alive || tile_before != tile_after)) {
+      tiles->counts[tile_before]++;
+      tiles->changed[tile_before] = true;
+    }
+  }
+
+  for (int tile = 0; tile < tiles->n_tiles; tile++) {
+    tiles->offsets[tile] = offset;
+    message = tile_message(tiles, tile);
+    message->tile = tile;
+    message->aliens_alive = aliens_alive;
+    message->n_aliens = 0;
+    offset += sizeof(aliens_tile_update_t) +
+              tiles->counts[tile] * sizeof(tile_alien_t);
+  }
+
+  for (int i = 0; i < N_ALIENS; i++) {
+    before = &previous->aliens[i];
+    after = &next->aliens[i];
+    tile_before = tile_of(before->position, tiles->tile_size);
+    tile_after = tile_of(after->position, tiles->tile_size);
+
+    if (after->alive)
+      tile_list_alien(tiles, tile_after, i, after);
+    if (before->alive && (!after->alive || tile_before != tile_after))
+      tile_list_alien(tiles, tile_before, i, after);
+  }
+
+  /* Only the subscribers of each tile receive it, and only if it changed
+   * (the ones without aliens never do) */
+  for (int tile = 0; tile < tiles->n_tiles; tile++) {
+    if (!tiles->changed[tile])
+      continue;
+
+    size = sizeof(aliens_tile_update_t) +
+           tiles->counts[tile] * sizeof(tile_alien_t);
+    zmq_send_stamped_msg(pub_socket, ALIENS_TILE_UPDATE,
+                         tile_message(tiles, tile), (int)size,
+                         (PUBSUB_TOPICS)(TILES_TOPIC + tile), header);
+  }
+
+  tick_end.tile = TILES_TICK_END;
+  tick_end.aliens_alive = aliens_alive;
+  tick_end.n_aliens = 0;
+  zmq_send_stamped_msg(pub_socket, ALIENS_TILE_UPDATE, &tick_end,
+                       sizeof(aliens_tile_update_t), PLAYER_UPDATES_TOPIC,
+                       header);
+}
+
+/* Frees the tiles */
+void tiles_destroy(tiles_t *tiles) {
+  free(tiles->counts);
+  free(tiles->changed);
+  free(tiles->offsets);
+  free(tiles->buffer);
+  free(tiles);
+}
+
+/******************** Displays ********************/
+
+/* Subscribes to the tiles of a board area (height rows and width cols from
+ * row/col) and unsubscribes from the others, given the ones subscribed
+ * (updated). An empty area still gets its top left tile */
+void tiles_subscribe_area(void *sub_socket, int tile_size, int row, int col,
+                          int height, int width, bool *subscribed) {
+  int n_tiles = tiles_per_side(tile_size) * tiles_per_side(tile_size);
+  bool *visible = (bool *)malloc(n_tiles * sizeof(bool));
+
+  assert(visible != NULL);
+  tiles_in_area(tile_size, row, col, height, width, visible);
+
+  for (int tile = 0; tile < n_tiles; tile++) {
+    if (visible[tile] && !subscribed[tile])
+      zmq_subscribe(sub_socket, (PUBSUB_TOPICS)(TILES_TOPIC + tile));
+    else if (!visible[tile] && subscribed[tile])
+      zmq_unsubscribe(sub_socket, (PUBSUB_TOPICS)(TILES_TOPIC + tile));
+    subscribed[tile] = visible[tile];
+  }
+
+  free(visible);
+}
+
+/* Initializes the tiles of a display (all of them known) */
+void tiles_view_init(tiles_view_t *view, int tile_size) {
+  view->tile_size = tile_size;
+  view->n_tiles = tiles_per_side(tile_size) * tiles_per_side(tile_size);
+  view->visible = (bool *)calloc(view->n_tiles, sizeof(bool));
+  view->known = (bool *)malloc(view->n_tiles * sizeof(bool));
+  assert(view->visible != NULL && view->known != NULL);
+  tiles_view_sync(view);
+}
+
+/* Marks every tile as known (the whole game was received) */
+void tiles_view_sync(tiles_view_t *view) {
+  for (int tile = 0; tile < view->n_tiles; tile++)
+    view->known[tile] = true;
+
+  /* The next tiles_view_follow forgets the ones that aren't shown */
+  view->area[0] = -1;
+}
+
+/* Sets the area shown (the tiles subscribed to, as in tiles_subscribe_area),
+ * forgetting the tiles that aren't shown. Returns true if a tile shown isn't
+ * known, so its aliens must be removed until it is updated */
+bool tiles_view_follow(tiles_view_t *view, int row, int col, int height,
+                       int width) {
+  bool unknown_shown = false;
+
+  if (view->area[0] == row && view->area[1] == col &&
+      view->area[2] == height && view->area[3] == width)
+    return false;
+
+  view->area[0] = row;
+  view->area[1] = col;
+  view->area[2] = height;
+  view->area[3] = width;
+  tiles_in_area(view->tile_size, row, col, height, width, view->visible);
+
+  for (int tile = 0; tile < view->n_tiles; tile++) {
+    /* Its updates aren't received anymore */
+    if (!view->visible[tile])
+      view->known[tile] = false;
+    else if (!view->known[tile])
+      unknown_shown = true;
+  }
+
+  return unknown_shown;
+}
+
+/* Marks a tile as updated, returning false if its aliens weren't known (they
+ * are replaced by the ones listed) */
+bool tiles_view_update(tiles_view_t *view, int tile) {
+  bool known;
+
+  assert(tile >= 0 && tile < view->n_tiles);
+
+  /* Known from now on while it is shown (an update can still arrive right
+   * after it is no longer subscribed to) */
+  known = view->known[tile];
+  view->known[tile] = view->visible[tile];
+  return known;
+}
+
+/* Frees the tiles of a display */
+void tiles_view_destroy(tiles_view_t *view) {
+  free(view->visible);
+  free(view->known);
+}
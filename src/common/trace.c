@@ -0,0 +1,244 @@
+/* Contains the tracer (only compiled in with -DSPACE_TRACE) */
+
+#define _GNU_SOURCE /* syscall */
+#include "trace.h"
+
+#ifdef SPACE_TRACE
+
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  /* String literal given to the macro */
+  const char *name;
+  uint64_t ts_ns;
+  /* The ring might have had other owners before */
+  int tid;
+  char phase;
+} trace_event_t;
+
+typedef struct {
+  trace_event_t events[TRACE_RING_SIZE];
+  /* Number of events ever written (only the owner writes, the dump reads) */
+  atomic_uint_fast64_t head;
+  /* Cleared when the owner exits, so another thread can take it */
+  atomic_bool in_use;
+  int tid;
+  const char *thread_name;
+} trace_ring_t;
+
+/* Every ring created (never freed) */
+static _Atomic(trace_ring_t *) rings[TRACE_MAX_THREADS];
+static atomic_int n_rings;
+/* Events lost because there were no rings left */
+static atomic_uint_fast64_t dropped_events;
+
+/* Ring of the calling thread */
+static __thread trace_ring_t *thread_ring;
+/* Used to give the ring back when the thread exits */
+static pthread_key_t ring_key;
+
+static const char *program_name = "program";
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Returns the time of the monotonic clock in ns */
+static uint64_t trace_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* Marks the ring of an exiting thread as free */
+static void release_ring(void *ring) {
+  atomic_store(&((trace_ring_t *)ring)->in_use, false);
+}
+
+/* Returns the ring of the calling thread, taking a free one or creating it
+ * (NULL when there are no rings left) */
+static trace_ring_t *get_ring() {
+  trace_ring_t *ring;
+  bool expected;
+  int index;
+
+  if (thread_ring != NULL)
+    return thread_ring;
+
+  /* Reuse the ring of a thread that exited */
+  for (int i = 0; i < atomic_load(&n_rings) && i < TRACE_MAX_THREADS; i++) {
+    ring = atomic_load(&rings[i]);
+    expected = false;
+    if (ring != NULL &&
+        atomic_compare_exchange_strong(&ring->in_use, &expected, true)) {
+      thread_ring = ring;
+      break;
+    }
+  }
+
+  if (thread_ring == NULL) {
+    index = atomic_fetch_add(&n_rings, 1);
+    if (index >= TRACE_MAX_THREADS)
+      return NULL;
+
+    ring = (trace_ring_t *)calloc(1, sizeof(trace_ring_t));
+    assert(ring != NULL);
+    atomic_store(&ring->in_use, true);
+    atomic_store(&rings[index], ring);
+    thread_ring = ring;
+  }
+
+  thread_ring->tid = (int)syscall(SYS_gettid);
+  thread_ring->thread_name = NULL;
+  pthread_setspecific(ring_key, thread_ring);
+
+  return thread_ring;
+}
+
+/* Dumps the trace every time SIGUSR1 is received */
+static void *dump_on_signal_thread(void *void_args) {
+  sigset_t *signals = (sigset_t *)void_args;
+  int signal;
+
+  TRACE_THREAD_NAME("trace dump");
+
+  while (sigwait(signals, &signal) == 0)
+    trace_dump();
+
+  return NULL;
+}
+
+/* Starts the tracer: blocks SIGUSR1 (threads created later inherit it), waits
+ * for it on a thread that dumps the trace and dumps it again at exit */
+void trace_init(const char *program) {
+  static sigset_t signals;
+  pthread_t thread_id;
+
+  program_name = program;
+  assert(pthread_key_create(&ring_key, release_ring) == 0);
+
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  assert(pthread_sigmask(SIG_BLOCK, &signals, NULL) == 0);
+  assert(pthread_create(&thread_id, NULL, dump_on_signal_thread, &signals) ==
+         0);
+  pthread_detach(thread_id);
+
+  atexit(trace_dump);
+  TRACE_THREAD_NAME("main");
+}
+
+/* Names the calling thread on the trace */
+void trace_thread_name(const char *name) {
+  trace_ring_t *ring = get_ring();
+
+  if (ring != NULL)
+    ring->thread_name = name;
+}
+
+/* Records an event of the calling thread (phase is the Chrome trace one) */
+void trace_record(const char *name, char phase) {
+  trace_ring_t *ring = get_ring();
+  trace_event_t *event;
+  uint64_t head;
+
+  if (ring == NULL) {
+    atomic_fetch_add(&dropped_events, 1);
+    return;
+  }
+
+  head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  event = &ring->events[head & (TRACE_RING_SIZE - 1)];
+  event->name = name;
+  event->ts_ns = trace_now_ns();
+  event->tid = ring->tid;
+  event->phase = phase;
+
+  /* Publish the event to the dump */
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/* Writes the events of a ring that weren't overwritten while reading them,
+ * returning if any was written */
+static bool dump_ring(FILE *file, trace_ring_t *ring, bool first) {
+  /* Only used holding the dump lock */
+  static trace_event_t copy[TRACE_RING_SIZE];
+  uint64_t head, start, valid_start, end;
+
+  head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+  for (uint64_t i = start; i < head; i++)
+    copy[i - start] = ring->events[i & (TRACE_RING_SIZE - 1)];
+
+  /* The events written meanwhile (and the one being written) replaced the
+   * oldest ones copied, which are skipped */
+  end = atomic_load_explicit(&ring->head, memory_order_acquire);
+  valid_start = end + 1 > TRACE_RING_SIZE ? end + 1 - TRACE_RING_SIZE : 0;
+  if (valid_start < start)
+    valid_start = start;
+
+  if (ring->thread_name != NULL) {
+    fprintf(file,
+            "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",", (int)getpid(), ring->tid, ring->thread_name);
+    first = false;
+  }
+
+  for (uint64_t i = valid_start; i < head; i++) {
+    trace_event_t *event = &copy[i - start];
+
+    fprintf(file,
+            "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,"
+            "\"tid\":%d}",
+            first ? "" : ",", event->name, event->phase, event->ts_ns / 1e3,
+            (int)getpid(), event->tid);
+    first = false;
+  }
+
+  return !first;
+}
+
+/* Writes every ring to the trace file */
+void trace_dump() {
+  char default_path[128];
+  const char *path = getenv(TRACE_FILE_ENV);
+  FILE *file;
+  trace_ring_t *ring;
+  bool first = true;
+
+  if (path == NULL) {
+    snprintf(default_path, sizeof(default_path), "trace-%s-%d.json",
+             program_name, (int)getpid());
+    path = default_path;
+  }
+
+  pthread_mutex_lock(&dump_lock);
+
+  file = fopen(path, "w");
+  if (file == NULL) {
+    pthread_mutex_unlock(&dump_lock);
+    return;
+  }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (int i = 0; i < atomic_load(&n_rings) && i < TRACE_MAX_THREADS; i++) {
+    ring = atomic_load(&rings[i]);
+    if (ring != NULL && dump_ring(file, ring, first))
+      first = false;
+  }
+  fprintf(file, "\n],\"otherData\":{\"dropped_events\":%lu}}\n",
+          (unsigned long)atomic_load(&dropped_events));
+
+  fclose(file);
+  pthread_mutex_unlock(&dump_lock);
+}
+
+#endif // SPACE_TRACE
@@ -0,0 +1,400 @@
+/* Contains the UI thread, the only one drawing in the client programs */
+
+#include "ui.h"
+
+/* Applies an action to the game state and the screen, keeping the score the
+ * server gave the player. When view isn't NULL (only the visible tiles are
+ * known) the aliens killed locally might differ, so the aliens alive are
+ * counted from the score instead (a point per alien killed) */
+static void ui_apply_action(ui_t *ui, nc_window_t *game_window, game_t *game,
+                            tiles_view_t *view, action_request_t *action,
+                            int server_score) {
+  player_t *player = &game->players[action->id];
+  int aliens_alive = game->aliens_alive, score = player->score;
+
+  handle_player_action(action, player, game_window, &game, NULL, NULL, NULL,
+                       &ui->render_queue);
+
+  if (view != NULL)
+    game->aliens_alive = aliens_alive - (server_score - score);
+  player->score = server_score;
+}
+
+/* Applies an update received by the display role to the game state and the
+ * screen, returning true if the game ended. Actions of the local player up to
+ * local_sequence were already applied and are skipped. view has the tiles of
+ * the display (NULL if it receives every alien) */
+static bool ui_apply_game_update(ui_t *ui, render_command_t *command,
+                                 nc_window_t *game_window, game_t *game,
+                                 tiles_view_t *view, int local_player_id,
+                                 int *local_sequence) {
+  action_request_t *action_request;
+  disconnect_request_t *disconnect_request;
+  aliens_update_t *alien_update_request;
+
+  switch (command->msg_type) {
+  case ASTRONAUT_CONNECT_REQUEST:
+    /* NULL because display doesn't send a reply or manage tokens */
+    handle_player_connect(game_window, NULL, NULL, game);
+    break;
+
+  case ACTION_REQUEST:
+    action_request = (action_request_t *)command->data;
+    if (action_request->id == local_player_id) {
+      if (action_request->sequence <= *local_sequence)
+        break;
+      /* The broadcast arrived first, so the local action will be skipped */
+      *local_sequence = action_request->sequence;
+    }
+    ui_apply_action(ui, game_window, game, view, action_request,
+                    action_request->score);
+    break;
+
+  case DISCONNECT_REQUEST:
+    disconnect_request = (disconnect_request_t *)command->data;
+    handle_player_disconnect(game_window, game, disconnect_request->id);
+    break;
+
+  case ALIENS_UPDATE:
+    alien_update_request = (aliens_update_t *)command->data;
+    handle_aliens_updates(game_window, alien_update_request, game);
+    if (view != NULL)
+      tiles_view_sync(view);
+    break;
+
+  case ALIENS_TILE_UPDATE:
+    if (view != NULL)
+      handle_aliens_tile_update(
+          game_window, (aliens_tile_update_t *)command->data, view, game);
+    break;
+
+  case ROUND_STARTED:
+    handle_new_round(game_window, (display_connect_response_t *)command->data,
+                     game);
+    if (view != NULL)
+      tiles_view_sync(view);
+    break;
+
+  case GAME_ENDED:
+    return true;
+
+  default:
+    break;
+  }
+
+  return false;
+}
+
+/* Measures the latency of an update received by the display role, keeping its
+ * publish time until the screen is updated */
+static void ui_track_game_update(ui_t *ui, render_command_t *command,
+                                 int64_t *last_sequence,
+                                 uint64_t *pending_sent_ns, int *n_pending) {
+  update_header_t *header = &command->header;
+  uint64_t receive_lag = 0;
+
+  if (*last_sequence != -1 && (int64_t)header->sequence > *last_sequence + 1)
+    ui->missed_updates += header->sequence - *last_sequence - 1;
+  *last_sequence = (int64_t)header->sequence;
+
+  if (command->received_ns > header->sent_ns)
+    receive_lag = command->received_ns - header->sent_ns;
+  histogram_record(&ui->receive_lag, receive_lag);
+  pending_sent_ns[(*n_pending)++] = header->sent_ns;
+}
+
+/* Tells the display role the part of the board shown on the screen */
+static void ui_set_visible_area(ui_t *ui) {
+  uint64_t area = (uint64_t)(uint16_t)nc_viewport.row |
+                  (uint64_t)(uint16_t)nc_viewport.col << 16 |
+                  (uint64_t)(uint16_t)nc_viewport.height << 32 |
+                  (uint64_t)(uint16_t)nc_viewport.width << 48;
+
+  atomic_store(&ui->visible_area, area);
+}
+
+/* Initializes the UI state (the render backend is only initialized by
+ * ui_main) */
+void ui_init(ui_t *ui, bool has_display, bool has_astronaut) {
+  render_queue_init(&ui->render_queue);
+  ui->has_display = has_display;
+  ui->has_astronaut = has_astronaut;
+  ui->ready = false;
+  histogram_reset(&ui->receive_lag);
+  histogram_reset(&ui->render_lag);
+  ui->missed_updates = 0;
+  atomic_init(&ui->visible_area, 0);
+  assert(pthread_mutex_init(&ui->ready_lock, NULL) == 0);
+  assert(pthread_cond_init(&ui->ready_cond, NULL) == 0);
+}
+
+/* Runs the UI loop on the calling thread until every role is done */
+void ui_main(ui_t *ui) {
+  render_command_t command;
+  /* Drawing related */
+  nc_window_t *game_window = NULL, *score_window = NULL,
+              *astronaut_window = NULL, *latency_window = NULL;
+  bool game_changed = false;
+  bool astronaut_changed = false;
+  /* Game management related */
+  display_connect_response_t *display_connect_response = NULL;
+  game_t *game = NULL;
+  /* Tiles of the display, when it only receives the visible ones */
+  tiles_view_t tiles_view;
+  tiles_view_t *view = NULL;
+  bool game_ended = false;
+  int followed_player_id = -1;
+  /* Last action of the followed (local) player that was applied, either from
+   * the astronaut role or from the broadcast (whichever arrives first) */
+  int local_sequence = -1;
+  action_request_t *local_action;
+  /* Latency related (publish time of the updates not yet on the screen) */
+  int64_t last_sequence = -1;
+  uint64_t pending_sent_ns[UI_MAX_PENDING_UPDATES];
+  int n_pending = 0;
+  uint64_t now;
+  /* Roles management */
+  int roles_running = (ui->has_display ? 1 : 0) + (ui->has_astronaut ? 1 : 0);
+  char *exit_messages[UI_MAX_ROLES];
+  int n_exit_messages = 0;
+
+  TRACE_THREAD_NAME("ui");
+
+  /* Render backend initialization (the game windows don't depend on the game
+   * state, so they are created right away to know where the astronaut one
+   * goes) */
+  nc_init();
+  if (ui->has_display) {
+    game_window =
+        nc_init_space(ui->has_astronaut ? ASTRONAUT_WINDOW_ROWS : 0);
+    score_window = nc_init_scoreboard();
+    if (getenv(UI_LATENCY_OVERLAY_ENV) != NULL)
+      latency_window = nc_init_latency();
+    ui_set_visible_area(ui);
+  }
+
+  /* Let the roles know that the terminal is ready */
+  pthread_mutex_lock(&ui->ready_lock);
+  ui->ready = true;
+  pthread_cond_broadcast(&ui->ready_cond);
+  pthread_mutex_unlock(&ui->ready_lock);
+
+  while (roles_running > 0) {
+    render_queue_pop(&ui->render_queue, &command);
+    game_clock_refresh();
+
+    switch (command.type) {
+    case RENDER_GAME_INIT:
+      display_connect_response = (display_connect_response_t *)command.data;
+      game = &display_connect_response->game;
+      nc_draw_init_game(game_window, score_window, game);
+      if (display_connect_response->tile_size > 0) {
+        tiles_view_init(&tiles_view, display_connect_response->tile_size);
+        view = &tiles_view;
+        handle_tiles_shown(game_window, view, game);
+      }
+      break;
+
+    case RENDER_GAME_UPDATE:
+      ui_track_game_update(ui, &command, &last_sequence, pending_sent_ns,
+                           &n_pending);
+
+      /* The game state always arrives before the updates (same role) */
+      TRACE_BEGIN("apply");
+      if (game != NULL &&
+          ui_apply_game_update(ui, &command, game_window, game, view,
+                               followed_player_id, &local_sequence))
+        game_ended = true;
+      TRACE_END("apply");
+      if (command.data != NULL)
+        free(command.data);
+      game_changed = true;
+      break;
+
+    case RENDER_CLEAN_ZAP:
+      /* Only clean if the game hasn't ended */
+      if (game != NULL && game->aliens_alive != 0) {
+        nc_clean_zap(game_window, game, command.orientation, command.index);
+        game_changed = true;
+      }
+      break;
+
+    case RENDER_ASTRONAUT_INIT:
+      followed_player_id = command.value;
+      astronaut_window =
+          nc_init_astronaut(command.orientation, command.value,
+                            ui->has_display ? nc_space_window_rows() : 0);
+      break;
+
+    case RENDER_ASTRONAUT_SCORE:
+      if (astronaut_window != NULL) {
+        nc_update_astronaut_score(astronaut_window, command.value);
+        astronaut_changed = true;
+      }
+      break;
+
+    case RENDER_LOCAL_ACTION:
+      /* Without the game state the broadcast will be applied instead */
+      local_action = (action_request_t *)command.data;
+      if (game != NULL) {
+        if (local_action->sequence > local_sequence) {
+          ui_apply_action(ui, game_window, game, view, local_action,
+                          command.value);
+          local_sequence = local_action->sequence;
+        }
+        /* The score from the server's response is the right one (the aliens
+         * killed locally might differ if an update is still on its way) */
+        game->players[local_action->id].score = command.value;
+        game_changed = true;
+      }
+      free(command.data);
+      break;
+
+    case RENDER_SCROLL:
+      if (game != NULL)
+        nc_scroll_viewport(game_window, game, command.value);
+      if (game != NULL && view != NULL) {
+        handle_tiles_shown(game_window, view, game);
+        game_changed = true;
+      }
+      break;
+
+    case RENDER_ROLE_DONE:
+      roles_running--;
+      if (command.data != NULL && n_exit_messages < UI_MAX_ROLES)
+        exit_messages[n_exit_messages++] = (char *)command.data;
+      break;
+    }
+
+    /* Only repaint once every pending command was applied, so a burst of
+     * updates costs a single screen update (unless too many are waiting) */
+    if (!render_queue_empty(&ui->render_queue) &&
+        n_pending < UI_MAX_PENDING_UPDATES)
+      continue;
+
+    if (game_changed && game != NULL) {
+      /* Keep the followed player inside the viewport */
+      if (followed_player_id != -1 &&
+          game->players[followed_player_id].connected)
+        nc_follow_position(game_window, game,
+                           game->players[followed_player_id].position);
+      if (view != NULL)
+        handle_tiles_shown(game_window, view, game);
+
+      nc_update_scoreboard(score_window, game->players, game->aliens_alive);
+      nc_stage(game_window);
+      nc_stage(score_window);
+
+      if (latency_window != NULL) {
+        nc_update_latency(latency_window, &ui->receive_lag, &ui->render_lag,
+                          ui->missed_updates);
+        nc_stage(latency_window);
+      }
+    }
+    if (astronaut_changed)
+      nc_stage(astronaut_window);
+    if (game_changed || astronaut_changed)
+      nc_flush();
+    if (ui->has_display)
+      ui_set_visible_area(ui);
+
+    /* The updates applied are now on the screen */
+    now = get_monotonic_ns();
+    for (int i = 0; i < n_pending; i++)
+      histogram_record(&ui->render_lag,
+                       now > pending_sent_ns[i] ? now - pending_sent_ns[i] : 0);
+    n_pending = 0;
+
+    game_changed = false;
+    astronaut_changed = false;
+  }
+
+  /* It might have stopped without the game ending (when the user pressed Q) */
+  if (game_ended)
+    print_winning_player(game);
+  nc_cleanup();
+
+  for (int i = 0; i < n_exit_messages; i++) {
+    printf("%s", exit_messages[i]);
+    free(exit_messages[i]);
+  }
+
+  /* Dump the latency of the game updates */
+  if (ui->receive_lag.total > 0) {
+    printf("Game updates latency (%lu lost):\n",
+           (unsigned long)ui->missed_updates);
+    histogram_print_ms(stdout, "receive", &ui->receive_lag);
+    histogram_print_ms(stdout, "render", &ui->render_lag);
+  }
+
+  if (display_connect_response != NULL)
+    free(display_connect_response);
+  if (view != NULL)
+    tiles_view_destroy(view);
+}
+
+/* Blocks until the UI thread initialized the render backend (and the
+ * terminal) */
+void ui_wait_ready(ui_t *ui) {
+  pthread_mutex_lock(&ui->ready_lock);
+  while (!ui->ready)
+    pthread_cond_wait(&ui->ready_cond, &ui->ready_lock);
+  pthread_mutex_unlock(&ui->ready_lock);
+}
+
+/* Tells the UI thread that a role stopped, with an optional message to print
+ * once the render backend is closed */
+void ui_role_done(ui_t *ui, char *message) {
+  render_command_t command = {.type = RENDER_ROLE_DONE, .data = message};
+
+  render_queue_push(&ui->render_queue, &command);
+}
+
+/* Destroys the UI state */
+void ui_destroy(ui_t *ui) {
+  render_queue_destroy(&ui->render_queue);
+  pthread_mutex_destroy(&ui->ready_lock);
+  pthread_cond_destroy(&ui->ready_cond);
+}
+
+/* Returns the part of the board shown on the screen (it changes as the
+ * viewport is scrolled or follows the player) */
+viewport_t ui_visible_area(ui_t *ui) {
+  uint64_t area = atomic_load(&ui->visible_area);
+  viewport_t viewport = {(uint16_t)area, (uint16_t)(area >> 16),
+                         (uint16_t)(area >> 32), (uint16_t)(area >> 48)};
+
+  return viewport;
+}
+
+/* Reads a key directly from the terminal (arrows are converted to the ncurses
+ * KEY_* values), returning ERR if none was pressed within timeout_ms */
+int ui_read_key(int timeout_ms) {
+  struct pollfd stdin_poll = {STDIN_FILENO, POLLIN, 0};
+  unsigned char sequence[3];
+
+  if (poll(&stdin_poll, 1, timeout_ms) <= 0)
+    return ERR;
+  if (read(STDIN_FILENO, &sequence[0], 1) != 1)
+    return ERR;
+
+  /* Arrows are sent as ESC [ A/B/C/D (or ESC O A/B/C/D when the terminal is in
+   * keypad mode) */
+  if (sequence[0] != 27 || poll(&stdin_poll, 1, 10) <= 0 ||
+      read(STDIN_FILENO, &sequence[1], 2) != 2 ||
+      (sequence[1] != '[' && sequence[1] != 'O'))
+    return sequence[0];
+
+  switch (sequence[2]) {
+  case 'A':
+    return KEY_UP;
+  case 'B':
+    return KEY_DOWN;
+  case 'C':
+    return KEY_RIGHT;
+  case 'D':
+    return KEY_LEFT;
+  default:
+    return ERR;
+  }
+}
@@ -1,12 +1,20 @@
 /* Defines general utilities */
 
+#include "aliens_pool.h"
+#include "checkpoint.h"
+#include "game_snapshot.h"
+#include "journal.h"
+#include "server_stats.h"
+#include "shm_channel.h"
+#include "trace.h"
 #include "utils.h"
+#include <sys/random.h>
 
 /******************** Client requests handling ********************/
 
 /* Handles the state and screen updates when a player connects */
 void handle_player_connect(
-    WINDOW *game_window,
+    nc_window_t *game_window,
     astronaut_connect_response_t *astronaut_connect_response, int *tokens,
     game_t *game) {
 
@@ -23,10 +31,15 @@ void handle_player_connect(
   nc_add_player(game_window, game->players[idx]);
 }
 
-/* Handles the state and screen updates when a player makes an action */
+/* Handles the state and screen updates when a player makes an action on the
+ * game game points to (the zap is cleaned using the locks or, if not NULL,
+ * the render queue, and game is only kept by the cleaning thread in the first
+ * case). The aliens killed are added to kills if it isn't NULL */
 void handle_player_action(action_request_t *action_request,
-                          player_t *current_player, WINDOW *game_window,
-                          game_t *game, pthread_mutex_t *lock) {
+                          player_t *current_player, nc_window_t *game_window,
+                          game_t **game, aliens_kills_t *kills,
+                          pthread_mutex_t *lock, pthread_mutex_t *io_lock,
+                          render_queue_t *render_queue) {
   position_t old_position;
 
   if (action_request->action_type == MOVE) {
@@ -34,29 +47,40 @@ void handle_player_action(action_request_t *action_request,
     old_position.col = current_player->position.col;
     old_position.row = current_player->position.row;
 
-    update_position(&current_player->position,
-                    action_request->movement_direction);
+    player_move(*game, action_request->id,
+                action_request->movement_direction);
 
     nc_move_player(game_window, *current_player, old_position);
   } else if (action_request->action_type == ZAP) {
-    player_zap(game_window, game, action_request->id);
-    nc_draw_zap(game_window, game, current_player);
+    player_zap(*game, action_request->id, game_clock_now_ms(), kills);
+    nc_draw_zap(game_window, *game, current_player);
     spawn_clean_zap_thread(current_player->orientation,
                            current_player->orientation == HORIZONTAL
                                ? current_player->position.col
                                : current_player->position.row,
-                           game, game_window, lock);
+                           render_queue == NULL ? game : NULL, game_window,
+                           lock, io_lock, render_queue);
   }
 }
 
 /* Handles the state and screen updates when a player disconnects */
-void handle_player_disconnect(WINDOW *game_window, player_t *current_player) {
-  nc_clean_position(game_window, current_player->position);
-  current_player->connected = false;
+void handle_player_disconnect(nc_window_t *game_window, game_t *game,
+                              int player_id) {
+  nc_clean_position(game_window, game->players[player_id].position);
+  player_leave(game, player_id);
+}
+
+/* Handles the state and screen updates when a new round starts (the whole game
+ * state is replaced) */
+void handle_new_round(nc_window_t *game_window,
+                      display_connect_response_t *round_started,
+                      game_t *game) {
+  memcpy(game, &round_started->game, sizeof(game_t));
+  nc_redraw_space(game_window, game);
 }
 
 /* Handles the state and screen updates when the aliens positions are updated */
-void handle_aliens_updates(WINDOW *game_window,
+void handle_aliens_updates(nc_window_t *game_window,
                            aliens_update_t *alien_update_request,
                            game_t *game) {
   alien_t *alien;
@@ -67,10 +91,13 @@ void handle_aliens_updates(WINDOW *game_window,
     Two loops to clean the old positions of the aliens and then put the
     new ones (can't be done in just 1 iteration because there would be
     problems with overlaps between new and old positions)
+
+    Aliens outside the viewport only have their state updated, so the drawing
+    cost depends on the viewport size and not on the board size
   */
   for (int i = 0; i < N_ALIENS; i++) {
     alien = &game->aliens[i];
-    if (alien->alive)
+    if (alien->alive && NC_IS_VISIBLE(alien->position))
       nc_clean_position(game_window, alien->position);
   }
   for (int i = 0; i < N_ALIENS; i++) {
@@ -86,249 +113,320 @@ void handle_aliens_updates(WINDOW *game_window,
       alien->position.col = alien_update_request->aliens[i].position.col;
       alien->position.row = alien_update_request->aliens[i].position.row;
 
-      nc_add_alien(game_window, &alien->position, regenerated);
+      if (NC_IS_VISIBLE(alien->position))
+        nc_add_alien(game_window, &alien->position, regenerated);
     }
   }
 
   game->aliens_alive = aliens_alive;
 }
 
-/******************** Aliens management ********************/
-
-/* Threaded function responsible for updating the aliens */
-void *aliens_update_thread(void *void_args) {
-
-  aliens_update_thread_args_t *args = (aliens_update_thread_args_t *)void_args;
-
-  aliens_update_t aliens_update;
-  /* Args unpack */
-  pthread_mutex_t *lock = args->lock;
-  game_t *game = args->game;
-  WINDOW *game_window = args->game_window;
-  WINDOW *score_window = args->score_window;
-  void *pub_socket = args->pub_socket;
-  /* Aliens regeneration management */
-  int aliens_to_regenerate = 0;
-  int aliens_regenerated = 0;
-  int last_aliens_alive = game->aliens_alive;
-  uint64_t current_ts = get_timestamp_ms();
-  uint64_t last_aliens_change_ts = current_ts;
-
-  while (game->aliens_alive) {
-    usleep(ALIEN_UPDATE * 1000);
-    current_ts = get_timestamp_ms();
-    aliens_to_regenerate = 0;
-    aliens_regenerated = 0;
-
-    /* ========= Entering critical region ========= */
-    pthread_mutex_lock(lock);
-
-    /* Means some aliens were zapped */
-    if (last_aliens_alive > game->aliens_alive)
-      last_aliens_change_ts = current_ts;
-    /* Means that no aliens were zapped or regenerated in the last
-     * ALIEN_REGENERATION_DELAY interval*/
-    else if (current_ts - last_aliens_change_ts > ALIEN_REGENERATION_DELAY) {
-      aliens_to_regenerate =
-          (int)(ALIEN_REGENERATION_FACTOR * game->aliens_alive);
-      last_aliens_change_ts = current_ts;
-    }
-
-    last_aliens_alive = game->aliens_alive;
+/* Handles the state and screen updates when the aliens of a tile are updated
+ * (see include/tiles.h) */
+void handle_aliens_tile_update(nc_window_t *game_window,
+                               aliens_tile_update_t *tile_update,
+                               tiles_view_t *view, game_t *game) {
+  alien_t *alien;
+  tile_alien_t *tile_alien;
 
-    memcpy(&aliens_update.aliens, &game->aliens, sizeof(alien_t) * N_ALIENS);
+  /* The end of a tick, which only has the aliens alive */
+  if (tile_update->tile == TILES_TICK_END) {
+    game->aliens_alive = tile_update->aliens_alive;
+    return;
+  }
 
-    /* Generate new positions for aliens */
+  /* The aliens in the tile may have left it or died meanwhile, so only the
+   * ones listed are kept */
+  if (!tiles_view_update(view, tile_update->tile)) {
     for (int i = 0; i < N_ALIENS; i++) {
-      /* Update position */
-      if (aliens_update.aliens[i].alive)
-        update_position(&aliens_update.aliens[i].position,
-                        (MOVEMENT_DIRECTION)(rand() % 4));
-
-      /* Alien regeneration */
-      else if (aliens_to_regenerate > 0 &&
-               aliens_regenerated < aliens_to_regenerate) {
-        aliens_update.aliens[i].alive = true;
-        game->aliens_alive++;
-        aliens_regenerated++;
-      }
-    }
-
-    zmq_send_msg(pub_socket, ALIENS_UPDATE, &aliens_update, -1,
-                 GAME_UPDATES_TOPIC);
+      alien = &game->aliens[i];
+      if (!alien->alive ||
+          tile_of(alien->position, view->tile_size) != tile_update->tile)
+        continue;
 
-    /* Game should contain the old positions to clear the screen, while
-     * aliens_update contains the new ones */
-    handle_aliens_updates(game_window, &aliens_update, game);
+      if (NC_IS_VISIBLE(alien->position))
+        nc_clean_position(game_window, alien->position);
+      alien->alive = false;
+    }
+  }
 
-    nc_update_scoreboard(score_window, game->players, game->aliens_alive);
-    wrefresh(game_window);
-    wrefresh(score_window);
+  /* Same two loops as handle_aliens_updates, only with the aliens listed */
+  for (int i = 0; i < tile_update->n_aliens; i++) {
+    alien = &game->aliens[tile_update->aliens[i].index];
+    if (alien->alive && NC_IS_VISIBLE(alien->position))
+      nc_clean_position(game_window, alien->position);
+  }
+  for (int i = 0; i < tile_update->n_aliens; i++) {
+    tile_alien = &tile_update->aliens[i];
+    alien = &game->aliens[tile_alien->index];
 
-    /* ========= Leaving critical region ========= */
-    pthread_mutex_unlock(lock);
+    if (tile_alien->alien.alive && NC_IS_VISIBLE(tile_alien->alien.position))
+      nc_add_alien(game_window, &tile_alien->alien.position, !alien->alive);
+    *alien = tile_alien->alien;
   }
 
-  return NULL;
+  /* The aliens of the other tiles aren't all known */
+  game->aliens_alive = tile_update->aliens_alive;
 }
 
-/* Places the alien on the board */
-void place_alien(alien_t *alien) {
-  position_t *position = &alien->position;
+/* Handles the state and screen updates when the viewport moved: the aliens of
+ * the tiles that came into view aren't known, so they are removed until their
+ * tile is updated (see tiles_view_follow) */
+void handle_tiles_shown(nc_window_t *game_window, tiles_view_t *view,
+                        game_t *game) {
+  alien_t *alien;
 
-  /* Alien can only be on the "inner" space square */
-  position->row = rand() % (SPACE_SIZE - 4) + 2;
-  position->col = rand() % (SPACE_SIZE - 4) + 2;
-}
+  if (!tiles_view_follow(view, nc_viewport.row, nc_viewport.col,
+                         nc_viewport.height, nc_viewport.width))
+    return;
 
-/******************** Player management ********************/
+  /* The aliens alive are still the ones of the whole board */
+  for (int i = 0; i < N_ALIENS; i++) {
+    alien = &game->aliens[i];
+    if (!alien->alive ||
+        view->known[tile_of(alien->position, view->tile_size)])
+      continue;
 
-/* Places the player on the board */
-void place_player(player_t *player) {
-  position_t *position = &player->position;
-  int id = player->id;
-
-  // Init board like:
-  //        0
-  //        4
-  // 3 7         5 1
-  //        6
-  //        2
-
-  player->orientation = id % 2 == 0 ? HORIZONTAL : VERTICAL;
-
-  switch (id) {
-  case 0:
-    position->col = SPACE_SIZE / 2;
-    position->row = 0;
-    break;
-  case 1:
-    position->col = SPACE_SIZE - 1;
-    position->row = SPACE_SIZE / 2;
-    break;
-  case 2:
-    position->col = SPACE_SIZE / 2;
-    position->row = SPACE_SIZE - 1;
-    break;
-  case 3:
-    position->col = 0;
-    position->row = SPACE_SIZE / 2;
-    break;
-  case 4:
-    position->col = SPACE_SIZE / 2;
-    position->row = 1;
-    break;
-  case 5:
-    position->col = SPACE_SIZE - 2;
-    position->row = SPACE_SIZE / 2;
-    break;
-  case 6:
-    position->col = SPACE_SIZE / 2;
-    position->row = SPACE_SIZE - 2;
-    break;
-  case 7:
-    position->col = 1;
-    position->row = SPACE_SIZE / 2;
-    break;
-  default:
-    exit(-1);
+    if (NC_IS_VISIBLE(alien->position))
+      nc_clean_position(game_window, alien->position);
+    alien->alive = false;
   }
 }
 
-/* Finds an available position for a player and initializes it */
-int find_position_and_init_player(game_t *game, int *tokens) {
-
-  for (int i = 0; i < MAX_PLAYERS; i++) {
-    player_t *player = &game->players[i];
-
-    if (!player->connected) {
-      player->connected = true;
-      player->last_shot = 0;
-      player->last_stunned = 0;
-      place_player(player);
-      player->score = 0;
+/******************** Aliens management ********************/
 
-      /* Displays will use this function but don't manage authentication */
-      if (tokens != NULL)
-        tokens[i] = rand();
+/* Draws a generation of aliens over the previous one (both kept by the aliens
+ * thread, so the game lock isn't needed) */
+static void draw_aliens_generation(nc_window_t *game_window,
+                                   aliens_update_t *previous,
+                                   aliens_update_t *next) {
+  alien_t *alien;
 
-      return i;
-    }
+  /* Same two loops as handle_aliens_updates */
+  for (int i = 0; i < N_ALIENS; i++) {
+    alien = &previous->aliens[i];
+    if (alien->alive && NC_IS_VISIBLE(alien->position))
+      nc_clean_position(game_window, alien->position);
+  }
+  for (int i = 0; i < N_ALIENS; i++) {
+    alien = &next->aliens[i];
+    if (alien->alive && NC_IS_VISIBLE(alien->position))
+      nc_add_alien(game_window, &alien->position, !previous->aliens[i].alive);
   }
-
-  return -1;
 }
 
-/* Updates state when a player zaps and kills the aliens */
-void player_zap(WINDOW *win, game_t *game, int player_id) {
-  int aliens_killed = 0;
-  alien_t *alien;
-  player_t *player = &game->players[player_id];
-  player_t *other_player;
-  uint64_t current_ts = get_timestamp_ms();
+/* Threaded function responsible for updating the aliens */
+void *aliens_update_thread(void *void_args) {
 
-  /* Check aliens that were killed */
-  for (int i = 0; i < N_ALIENS; i++) {
-    alien = &game->aliens[i];
+  aliens_update_thread_args_t *args = (aliens_update_thread_args_t *)void_args;
 
-    /* Alien dies if it is alive and aligned with the player zap */
-    if (alien->alive && ((player->orientation == VERTICAL &&
-                          alien->position.row == player->position.row) ||
-                         (player->orientation == HORIZONTAL &&
-                          alien->position.col == player->position.col))) {
-      aliens_killed++;
-      game->aliens_alive--;
-      alien->alive = false;
-      nc_clean_position(win, alien->position);
+  /* The last generation of aliens (front) and the next one (back), which is
+   * computed without the game lock. Static as they can be too big for the
+   * thread stack on large boards */
+  static aliens_update_t generations[2];
+  aliens_update_t *front = &generations[0], *back = &generations[1], *swap;
+  /* Args unpack */
+  pthread_mutex_t *lock = args->lock;
+  pthread_mutex_t *io_lock = args->io_lock;
+  /* The current game and the other one, where the next generation is
+   * prepared without the game lock (only this thread swaps them) */
+  game_t *game, *next_game = args->spare_game;
+  nc_window_t *game_window = args->game_window;
+  nc_window_t *score_window = args->score_window;
+  void *pub_socket = args->pub_socket;
+  server_stats_t *stats = args->stats;
+  uint64_t acquired_ns;
+  aliens_regeneration_t regeneration;
+  int aliens_to_regenerate, aliens_regenerated;
+  /* Random numbers of the next generation (given back to the game on commit)
+   * and round of the front one */
+  game_rng_t rng;
+  int round;
+  update_header_t header;
+  /* The game after the tick, saved without any lock */
+  const game_snapshot_t *snapshot;
+  uint64_t journal_index = 0;
+  /* Threads that move the aliens with this one on large boards */
+  aliens_pool_t *pool = aliens_pool_create(aliens_pool_default_workers());
+
+  TRACE_THREAD_NAME("aliens thread");
+
+  /* The first generation is the current game */
+  pthread_mutex_lock(lock);
+  game = *args->game;
+  memcpy(&front->aliens, &game->aliens, sizeof(alien_t) * N_ALIENS);
+  rng = *args->rng;
+  round = *args->round;
+  aliens_regeneration_init(&regeneration, game, game_clock_now_ms());
+  pthread_mutex_unlock(lock);
+
+  while (true) {
+    game_clock_sleep_ms(ALIEN_UPDATE);
+    game_clock_refresh();
+    TRACE_BEGIN("tick");
+
+    /* Most of the tick, while the requests keep being handled: the aliens
+     * move into the game that isn't the current one, alive as they were at
+     * the last commit */
+    TRACE_BEGIN("move");
+    aliens_pool_move(pool, front->aliens, back, &rng);
+    for (int i = 0; i < N_ALIENS; i++)
+      back->aliens[i].alive = front->aliens[i].alive;
+    memcpy(next_game->aliens, back->aliens, sizeof(alien_t) * N_ALIENS);
+    TRACE_END("move");
+
+    /* ========= Entering critical region =========
+
+    Only to commit the new generation: the aliens killed meanwhile are applied
+    to it, and it replaces the current game
+    */
+    acquired_ns = server_stats_lock(stats, lock, LOCK_ALIENS_THREAD);
+    game = *args->game;
+
+    /* The last round ended while the generation was computed */
+    if (*args->game_over) {
+      server_stats_unlock(stats, lock, LOCK_ALIENS_THREAD, acquired_ns);
+      TRACE_END("tick");
+      break;
     }
-  }
 
-  player->last_shot = current_ts;
-  player->score += aliens_killed;
-
-  /* Check if it stunned other players */
-  for (int i = 0; i < MAX_PLAYERS; i++) {
-    /* Skip current player */
-    if (i == player_id)
+    /* A new round placed the aliens again, so this generation is dropped and
+     * the next one moves them from there (copied holding the lock, as it is
+     * rare), and the kills of the previous one don't delay the regeneration */
+    if (*args->round != round) {
+      rng = *args->rng;
+      round = *args->round;
+      memcpy(front->aliens, game->aliens, sizeof(alien_t) * N_ALIENS);
+      aliens_regeneration_init(&regeneration, game, game_clock_now_ms());
+      args->kills->n_killed = 0;
+      server_stats_unlock(stats, lock, LOCK_ALIENS_THREAD, acquired_ns);
+      TRACE_END("tick");
       continue;
+    }
+    *args->rng = rng;
+
+    aliens_to_regenerate =
+        aliens_regeneration_count(&regeneration, game, game_clock_now_ms());
+    aliens_regenerated = aliens_commit_kills(game, next_game, back, args->kills,
+                                             aliens_to_regenerate);
+    args->kills->n_killed = 0;
+    *args->game = next_game;
+    next_game = game;
+    game = *args->game;
+
+    if (args->journal != NULL)
+      journal_index = journal_append_tick(args->journal, aliens_regenerated,
+                                          game, game_clock_now_ms());
+
+    /* Taken before the game lock is released, so the update is published
+     * before the changes made after it */
+    pthread_mutex_lock(io_lock);
+    nc_update_scoreboard(score_window, game->players, game->aliens_alive);
 
-    other_player = &game->players[i];
+    /* ========= Leaving critical region ========= */
+    server_stats_unlock(stats, lock, LOCK_ALIENS_THREAD, acquired_ns);
+
+    publish_game_update(pub_socket, args->shm, args->tiles, ALIENS_UPDATE,
+                        back);
+    if (args->tiles != NULL) {
+      header = zmq_last_update_header();
+      tiles_publish_aliens(args->tiles, pub_socket, front, back,
+                           game->aliens_alive, &header);
+    }
 
-    /* Player is stunned if aligned with the player that shot */
-    if ((player->orientation == HORIZONTAL &&
-         player->position.col == other_player->position.col) ||
-        (player->orientation == VERTICAL &&
-         player->position.row == other_player->position.row))
-      other_player->last_stunned = current_ts;
+    /* The main loop only changes the game holding both locks, so it can't
+     * change until io_lock is released (and the snapshot taken is the game
+     * after this tick) */
+    TRACE_BEGIN("snapshot");
+    snapshot_publish(args->snapshots, game, args->tokens, args->client_ids,
+                     args->rng, true, zmq_next_update_sequence());
+    snapshot = snapshot_acquire(args->snapshots);
+    if (args->shm != NULL)
+      shm_channel_write_game(args->shm, game, true,
+                             zmq_next_update_sequence());
+    TRACE_END("snapshot");
+
+    TRACE_BEGIN("apply");
+    draw_aliens_generation(game_window, front, back);
+    TRACE_END("apply");
+
+    nc_stage(game_window);
+    nc_stage(score_window);
+    nc_flush();
+    pthread_mutex_unlock(io_lock);
+
+    /* Both go over the whole game, so they are done without any lock */
+    TRACE_BEGIN("save");
+    if (args->journal != NULL)
+      journal_set_checksum(args->journal, journal_index, &snapshot->game);
+    if (args->checkpoint != NULL)
+      checkpoint_save(args->checkpoint, snapshot, game_clock_now_ms());
+    snapshot_release(snapshot);
+    TRACE_END("save");
+
+    /* The new generation is the front one now */
+    swap = front;
+    front = back;
+    back = swap;
+    TRACE_END("tick");
   }
+
+  aliens_pool_destroy(pool);
+  return NULL;
 }
 
+/******************** Player management ********************/
+
 /* Threaded function responsible for cleaning the zap after sleeping */
 void *clean_zap_thread(void *void_args) {
   zap_clean_thread_args_t *args = (zap_clean_thread_args_t *)void_args;
+  render_command_t command;
+
+  game_clock_sleep_ms(ZAP_TIME_ON_SCREEN);
+
+  /* The UI thread owns the screen, so just tell it to clean the zap */
+  if (args->render_queue != NULL) {
+    command.type = RENDER_CLEAN_ZAP;
+    command.data = NULL;
+    command.orientation = args->orientation;
+    command.index = args->index;
+    render_queue_push(args->render_queue, &command);
+    free(void_args);
+    return NULL;
+  }
 
-  usleep(ZAP_TIME_ON_SCREEN * 1000);
-
+  TRACE_THREAD_NAME("zap cleaner");
+  TRACE_BEGIN("zap-clean");
   pthread_mutex_lock(args->lock);
+  pthread_mutex_lock(args->io_lock);
   /* Only clean if the game hasn't ended*/
-  if (args->game->aliens_alive != 0)
-    nc_clean_zap(args->game_window, args->game, args->orientation, args->index);
+  if ((*args->game)->aliens_alive != 0)
+    nc_clean_zap(args->game_window, *args->game, args->orientation,
+                 args->index);
+  pthread_mutex_unlock(args->io_lock);
   pthread_mutex_unlock(args->lock);
+  TRACE_END("zap-clean");
 
   free(void_args);
 
   return NULL;
 }
 
-/* Spawns the thread to clean the zap */
+/* Spawns the thread to clean the zap (if render_queue isn't NULL the thread
+ * sends the clean command to the UI thread instead of using the locks, and
+ * game must be NULL, as it may not outlive the call) */
 void spawn_clean_zap_thread(MOVEMENT_ORIENTATION orientation, int index,
-                            game_t *game, WINDOW *game_window,
-                            pthread_mutex_t *lock) {
+                            game_t **game, nc_window_t *game_window,
+                            pthread_mutex_t *lock, pthread_mutex_t *io_lock,
+                            render_queue_t *render_queue) {
   zap_clean_thread_args_t *args;
   pthread_t thread_id;
 
-  /* Assert that the lock was correctly created */
-  assert(lock != NULL);
+  /* Assert that the locks were correctly created (or the UI thread cleans
+   * the zap, without the game) */
+  assert(render_queue != NULL
+             ? game == NULL
+             : game != NULL && lock != NULL && io_lock != NULL);
 
   /* Use malloc instead of a local variable to ensure that it stays in memory
    * and the thread can access it */
@@ -339,6 +437,8 @@ void spawn_clean_zap_thread(MOVEMENT_ORIENTATION orientation, int index,
   args->game_window = game_window;
   args->index = index;
   args->lock = lock;
+  args->io_lock = io_lock;
+  args->render_queue = render_queue;
   args->orientation = orientation;
 
   /* Spawn the thread but don't join it, as it only sleeps,
@@ -349,74 +449,30 @@ void spawn_clean_zap_thread(MOVEMENT_ORIENTATION orientation, int index,
 
 /******************** Miscellaneous ********************/
 
-/* Inits all the players and aliens on the board */
-void init_game(game_t *game, int *tokens) {
-
-  /* Init players */
-  for (int i = 0; i < MAX_PLAYERS; i++) {
-    player_t *player = &game->players[i];
-
-    player->connected = false;
-    player->id = i;
-    player->last_shot = 0;
-    player->last_stunned = 0;
-    place_player(player);
-    player->score = -1;
-    tokens[i] = -1;
-  }
-
-  /* Init aliens */
-  game->aliens_alive = N_ALIENS;
-
-  for (int i = 0; i < game->aliens_alive; i++) {
-    alien_t *alien = &game->aliens[i];
-
-    alien->alive = true;
-    place_alien(alien);
-  }
-}
-
-/* Update the position of a player or alien */
-void update_position(position_t *position, MOVEMENT_DIRECTION direction) {
-
-  switch (direction) {
-  case UP:
-    position->row--;
-
-    /* Revert if out of bounds */
-    if (position->row < 2)
-      position->row++;
-    break;
-  case DOWN:
-    position->row++;
-
-    /* Revert if out of bounds */
-    if (position->row >= SPACE_SIZE - 2)
-      position->row--;
-    break;
-  case RIGHT:
-    position->col++;
-
-    /* Revert if out of bounds */
-    if (position->col >= SPACE_SIZE - 2)
-      position->col--;
-    break;
-  case LEFT:
-    position->col--;
-
-    /* Revert if out of bounds */
-    if (position->col < 2)
-      position->col++;
-    break;
-
-  default:
-    break;
+/* Publishes a game update and, if shm isn't NULL, writes it to the shared
+ * memory channel with the same sequence. If tiles isn't NULL, the updates of
+ * the players are also published on PLAYER_UPDATES_TOPIC */
+void publish_game_update(void *pub_socket, struct shm_channel *shm,
+                         struct tiles *tiles, MESSAGE_TYPE msg_type,
+                         void *msg) {
+  update_header_t header;
+
+  zmq_send_msg(pub_socket, msg_type, msg, -1, GAME_UPDATES_TOPIC);
+  if (shm != NULL)
+    shm_channel_write_update(shm, msg_type, msg,
+                             zmq_next_update_sequence() - 1);
+
+  /* The aliens are published on the tiles (see tiles_publish_aliens) */
+  if (tiles != NULL && msg_type != ALIENS_UPDATE) {
+    header = zmq_last_update_header();
+    zmq_send_stamped_msg(pub_socket, msg_type, msg, -1, PLAYER_UPDATES_TOPIC,
+                         &header);
   }
 }
 
 /* Copies the game state to the connect reply */
 void copy_game_state_for_display(display_connect_response_t *response,
-                                 game_t *game) {
+                                 const game_t *game) {
   for (int i = 0; i < MAX_PLAYERS; i++) {
     response->game.players[i].connected = game->players[i].connected;
     response->game.players[i].id = game->players[i].id;
@@ -426,8 +482,15 @@ void copy_game_state_for_display(display_connect_response_t *response,
     response->game.players[i].position.row = game->players[i].position.row;
     response->game.players[i].position.col = game->players[i].position.col;
     response->game.players[i].score = game->players[i].score;
+    response->game.players[i].next_in_row = game->players[i].next_in_row;
+    response->game.players[i].next_in_col = game->players[i].next_in_col;
   }
 
+  memcpy(response->game.row_players, game->row_players,
+         sizeof(game->row_players));
+  memcpy(response->game.col_players, game->col_players,
+         sizeof(game->col_players));
+
   response->game.aliens_alive = game->aliens_alive;
 
   for (int i = 0; i < N_ALIENS; i++) {
@@ -441,6 +504,7 @@ void copy_game_state_for_display(display_connect_response_t *response,
 void print_winning_player(game_t *game) {
   int idx = -1;
   player_t *current_player;
+  char message[64] = "", label[PLAYER_LABEL_SIZE];
 
   /* Find winning player */
   for (int i = 0; i < MAX_PLAYERS; i++) {
@@ -451,22 +515,48 @@ void print_winning_player(game_t *game) {
       idx = i;
   }
 
-  erase(); /* Clean entire ncurses screen */
-
   if (idx != -1)
-    printw("Player %c won with %d points!\n", id_to_symbol(idx),
-           game->players[idx].score);
+    snprintf(message, sizeof(message), "Player %s won with %d points!\n",
+             id_to_label(idx, label), game->players[idx].score);
 
-  refresh(); /* Refresh entire ncurses screen */
+  nc_show_message(message); /* Replaces the entire screen */
   sleep(5);
 }
 
-/* Converts an ID to a symbol */
-char id_to_symbol(int id) { return (char)('A' + id); }
+/* Converts an ID to the symbol drawn on the board (the ids after the last
+ * symbol reuse them) */
+char id_to_symbol(int id) { return PLAYER_SYMBOLS[id % N_PLAYER_SYMBOLS]; }
+
+/* Writes the name of a player on the scoreboards into label (at least
+ * PLAYER_LABEL_SIZE bytes): its symbol, followed by how many times the symbols
+ * were reused before it (e.g. "A", then "A1" when there are more players than
+ * symbols). Returns label */
+char *id_to_label(int id, char *label) {
+  if (id < N_PLAYER_SYMBOLS)
+    snprintf(label, PLAYER_LABEL_SIZE, "%c", id_to_symbol(id));
+  else
+    snprintf(label, PLAYER_LABEL_SIZE, "%c%d", id_to_symbol(id),
+             id / N_PLAYER_SYMBOLS);
+  return label;
+}
+
+/* Returns the time in ns of the monotonic clock (only comparable between
+ * processes of the same machine) */
+uint64_t get_monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* Returns a connect request with a new random client id (see
+ * astronaut_connect_request_t) */
+astronaut_connect_request_t new_connect_request() {
+  astronaut_connect_request_t request = {0};
+
+  /* 0 is the id of no client */
+  while (request.client_id == 0)
+    assert(getrandom(&request.client_id, sizeof(uint64_t), 0) ==
+           sizeof(uint64_t));
 
-/* Returns the current timestamp in ms since epoch */
-uint64_t get_timestamp_ms() {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return (uint64_t)(tv.tv_sec) * 1000 + (uint64_t)(tv.tv_usec) / 1000;
+  return request;
 }
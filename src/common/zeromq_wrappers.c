@@ -1,6 +1,23 @@
 /* Contains utility wrappers around the zeromq library */
 
 #include "zeromq_wrapper.h"
+#include "trace.h"
+#include "utils.h"
+
+/* Sequence of the next game update published (only the game-server publishes
+ * them and always holding io_lock) */
+static uint64_t next_update_sequence = 0;
+
+/* Epoch of the game updates published (see update_header_t) */
+static uint64_t update_epoch = 0;
+
+/* Header of the last game update published */
+static update_header_t last_update_header;
+
+/* Checks if the messages of a topic carry the update header */
+static bool topic_is_stamped(PUBSUB_TOPICS topic) {
+  return topic == GAME_UPDATES_TOPIC || topic >= PLAYER_UPDATES_TOPIC;
+}
 
 /******************** Socket creation and initialization ********************/
 
@@ -32,8 +49,11 @@ void zmq_bind_socket(void *socket, char *address) {
 
 /* Connect socket */
 void zmq_connect_socket(void *socket, char *address) {
-  int rc = zmq_connect(socket, address);
-  assert(rc == 0);
+  /* The addresses can come from the environment, so they may be wrong */
+  if (zmq_connect(socket, address) != 0) {
+    printf("Couldn't connect to %s (%s).\n", address, zmq_strerror(errno));
+    exit(-1);
+  }
 }
 
 /* Subscribe to publisher */
@@ -43,6 +63,33 @@ void zmq_subscribe(void *socket, PUBSUB_TOPICS topic) {
   assert(rc == 0);
 }
 
+/* Unsubscribe from a topic of the publisher */
+void zmq_unsubscribe(void *socket, PUBSUB_TOPICS topic) {
+  int rc = zmq_setsockopt(socket, ZMQ_UNSUBSCRIBE, (void *)&topic,
+                          sizeof(PUBSUB_TOPICS));
+  assert(rc == 0);
+}
+
+/* Returns the address in the environment variable env or, if not set,
+ * default_address */
+char *zmq_address_from_env(const char *env, char *default_address) {
+  char *address = getenv(env);
+
+  return address != NULL ? address : default_address;
+}
+
+/* Returns the REQREP address the clients connect to (SERVER_REQREP_ENV or
+ * SERVER_ZMQ_REQREP_ADDRESS) */
+char *zmq_server_reqrep_address() {
+  return zmq_address_from_env(SERVER_REQREP_ENV, SERVER_ZMQ_REQREP_ADDRESS);
+}
+
+/* Returns the PUBSUB address the clients connect to (SERVER_PUBSUB_ENV or
+ * SERVER_ZMQ_PUBSUB_ADDRESS) */
+char *zmq_server_pubsub_address() {
+  return zmq_address_from_env(SERVER_PUBSUB_ENV, SERVER_ZMQ_PUBSUB_ADDRESS);
+}
+
 /******************** Sending and receiving messages ********************/
 
 /*
@@ -54,23 +101,56 @@ If topic==NOTOPIC then no topic is expected
 */
 void *zmq_receive_msg(void *socket, MESSAGE_TYPE *msg_type,
                       PUBSUB_TOPICS topic) {
+  return zmq_receive_stamped_msg(socket, msg_type, topic, NULL);
+}
+
+/* Same as zmq_receive_msg, but also returns the update header of the
+ * GAME_UPDATES_TOPIC messages (discarded when header==NULL). The messages of
+ * PLAYER_UPDATES_TOPIC and the tile topics have it too */
+void *zmq_receive_stamped_msg(void *socket, MESSAGE_TYPE *msg_type,
+                              PUBSUB_TOPICS topic, update_header_t *header) {
   int n;
   void *msg;
   size_t followup_msg_size;
   PUBSUB_TOPICS temp;
+  update_header_t temp_header;
+  zmq_msg_t part;
 
-  /* Receive the topic and discard it as it isn't needed */
+  /* Receive the topic and discard it as it isn't needed (the span includes
+   * the time waiting for the message) */
+  TRACE_BEGIN("receive");
   if (topic != NO_TOPIC) {
     n = zmq_recv(socket, &temp, sizeof(PUBSUB_TOPICS), 0);
     assert(n != -1);
   }
 
+  /* Receive the update header */
+  if (topic_is_stamped(topic)) {
+    n = zmq_recv(socket, header != NULL ? header : &temp_header,
+                 sizeof(update_header_t), 0);
+    assert(n != -1);
+  }
+
   /* Receive message type/header */
   n = zmq_recv(socket, msg_type, sizeof(MESSAGE_TYPE), 0);
   assert(n != -1);
 
   followup_msg_size = get_msg_size(*msg_type);
 
+  /* The tiles have any number of aliens, so the size is the one received */
+  if (*msg_type == ALIENS_TILE_UPDATE) {
+    zmq_msg_init(&part);
+    n = zmq_msg_recv(&part, socket, 0);
+    assert(n != -1 && (size_t)n >= followup_msg_size);
+    msg = malloc(n);
+    assert(msg != NULL);
+    memcpy(msg, zmq_msg_data(&part), n);
+    zmq_msg_close(&part);
+
+    TRACE_END("receive");
+    return msg;
+  }
+
   /* Receive actual message */
   if (followup_msg_size > 0) {
     msg = malloc(followup_msg_size);
@@ -79,28 +159,57 @@ void *zmq_receive_msg(void *socket, MESSAGE_TYPE *msg_type,
     n = zmq_recv(socket, msg, followup_msg_size, 0);
     assert(n != -1);
 
+    TRACE_END("receive");
     return msg;
-  } else
+  } else {
+    TRACE_END("receive");
     return NULL;
+  }
 }
 
 /* Send messages, first the type then the actual message.
 
   If msg_size==-1, then it uses the get_msg_size function to get the size
   If topic==NOTOPIC then no topic is sent at the beggining
+  If topic==GAME_UPDATES_TOPIC then the update header is sent after the topic
 */
 void zmq_send_msg(void *socket, MESSAGE_TYPE msg_type, void *msg, int msg_size,
                   PUBSUB_TOPICS topic) {
+  zmq_send_stamped_msg(socket, msg_type, msg, msg_size, topic, NULL);
+}
+
+/* Same as zmq_send_msg, but the messages of PLAYER_UPDATES_TOPIC and the tile
+ * topics carry the given update header (the one of a GAME_UPDATES_TOPIC
+ * message is always a new one) */
+void zmq_send_stamped_msg(void *socket, MESSAGE_TYPE msg_type, void *msg,
+                          int msg_size, PUBSUB_TOPICS topic,
+                          const update_header_t *header) {
   int n;
   size_t followup_msg_size =
       (msg_size != -1) ? (size_t)msg_size : get_msg_size(msg_type);
 
+  TRACE_BEGIN(topic == NO_TOPIC ? "send" : "publish");
+
   /* Send topic if needed */
   if (topic != NO_TOPIC) {
     n = zmq_send(socket, &topic, sizeof(PUBSUB_TOPICS), ZMQ_SNDMORE);
     assert(n != -1);
   }
 
+  /* Stamp game updates (as late as possible, so the time measured by the
+   * displays doesn't include the server work) */
+  if (topic == GAME_UPDATES_TOPIC) {
+    last_update_header.epoch = update_epoch;
+    last_update_header.sequence = next_update_sequence++;
+    last_update_header.sent_ns = get_monotonic_ns();
+    header = &last_update_header;
+  }
+  if (topic_is_stamped(topic)) {
+    assert(header != NULL);
+    n = zmq_send(socket, header, sizeof(update_header_t), ZMQ_SNDMORE);
+    assert(n != -1);
+  }
+
   /* Send message type/header */
   n = zmq_send(socket, &msg_type, sizeof(MESSAGE_TYPE),
                followup_msg_size > 0 ? ZMQ_SNDMORE : 0);
@@ -111,8 +220,63 @@ void zmq_send_msg(void *socket, MESSAGE_TYPE msg_type, void *msg, int msg_size,
     n = zmq_send(socket, msg, followup_msg_size, 0);
     assert(n != -1);
   }
+
+  TRACE_END(topic == NO_TOPIC ? "send" : "publish");
 }
 
+/* Sends a request and waits for the reply, resending it on a new socket (a REQ
+ * socket can't send again before receiving) when the server doesn't reply in
+ * REQUEST_TIMEOUT_MS, e.g. while it restarts. Returns NULL if none of the
+ * REQUEST_ATTEMPTS got a reply. A request may be applied twice if only its
+ * reply was lost */
+void *zmq_request(void **req_socket, void *context, char *address,
+                  MESSAGE_TYPE request_type, void *request,
+                  MESSAGE_TYPE *reply_type) {
+  zmq_pollitem_t poll_item;
+  int linger = 0, attempt, n;
+
+  for (attempt = 0; attempt < REQUEST_ATTEMPTS; attempt++) {
+    if (attempt > 0) {
+      /* The unanswered request is dropped with the old socket */
+      n = zmq_setsockopt(*req_socket, ZMQ_LINGER, &linger, sizeof(int));
+      assert(n == 0);
+      zmq_cleanup(NULL, *req_socket, NULL);
+      *req_socket = zmq_create_socket(context, ZMQ_REQ);
+      zmq_connect_socket(*req_socket, address);
+    }
+
+    zmq_send_msg(*req_socket, request_type, request, -1, NO_TOPIC);
+
+    poll_item.socket = *req_socket;
+    poll_item.events = ZMQ_POLLIN;
+    if (zmq_poll(&poll_item, 1, REQUEST_TIMEOUT_MS) > 0)
+      return zmq_receive_msg(*req_socket, reply_type, NO_TOPIC);
+  }
+
+  /* Don't block the context termination with the last request */
+  n = zmq_setsockopt(*req_socket, ZMQ_LINGER, &linger, sizeof(int));
+  assert(n == 0);
+  return NULL;
+}
+
+/* Starts a new epoch of the game updates, from the real time clock so a
+ * server restarted gets another one (called before publishing any) */
+void zmq_start_update_epoch() {
+  struct timespec now;
+
+  assert(clock_gettime(CLOCK_REALTIME, &now) == 0);
+  update_epoch = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* Returns the epoch of the game updates published */
+uint64_t zmq_update_epoch() { return update_epoch; }
+
+/* Returns the sequence of the next game update published */
+uint64_t zmq_next_update_sequence() { return next_update_sequence; }
+
+/* Returns the header of the last game update published */
+update_header_t zmq_last_update_header() { return last_update_header; }
+
 /* Broadcasts the scores updates messages using protobuf protocol */
 void zmq_broadcast_scores_updates(void *pub_socket, game_t *game) {
   ScoresMessage scores_message = SCORES_MESSAGE__INIT;
@@ -143,7 +307,7 @@ void zmq_broadcast_scores_updates(void *pub_socket, game_t *game) {
 
 /******************** Cleanup ********************/
 
-/* Cleanup zmq */
+/* Cleanup zmq (sockets and context are only closed if not NULL) */
 void zmq_cleanup(void *context, void *socket1, void *socket2) {
   int n;
 
@@ -157,8 +321,10 @@ void zmq_cleanup(void *context, void *socket1, void *socket2) {
     assert(n == 0);
   }
 
-  n = zmq_ctx_destroy(context);
-  assert(n == 0);
+  if (context != NULL) {
+    n = zmq_ctx_destroy(context);
+    assert(n == 0);
+  }
 }
 
 /******************** Utilities ********************/
@@ -177,8 +343,7 @@ size_t get_msg_size(MESSAGE_TYPE type) {
   case DISPLAY_CONNECT_RESPONSE:
     return sizeof(display_connect_response_t);
   case ASTRONAUT_CONNECT_REQUEST:
-    /* Connect request doens't have a followup message with more info */
-    return 0;
+    return sizeof(astronaut_connect_request_t);
   case ASTROUNAUT_CONNECT_RESPONSE:
     return sizeof(astronaut_connect_response_t);
   case ACTION_REQUEST:
@@ -194,6 +359,15 @@ size_t get_msg_size(MESSAGE_TYPE type) {
     return 0;
   case ALIENS_UPDATE:
     return sizeof(aliens_update_t);
+  case STATS_UPDATE:
+    return sizeof(stats_update_t);
+  case ROUND_STARTED:
+    return sizeof(display_connect_response_t);
+  case ALIENS_TILE_UPDATE:
+    /* Only the part before the aliens */
+    return sizeof(aliens_tile_update_t);
+  case SHARD_STATUS:
+    return sizeof(shard_status_t);
 
   default:
     exit(-1);
@@ -1,7 +1,16 @@
+#include "admission.h"
+#include "checkpoint.h"
 #include "comms.h"
 #include "game_def.h"
+#include "game_snapshot.h"
+#include "journal.h"
+#include "lobby.h"
 #include "ncurses_wrapper.h"
 #include "scores.pb-c.h"
+#include "server_stats.h"
+#include "shm_channel.h"
+#include "tiles.h"
+#include "trace.h"
 #include "utils.h"
 #include "validators.h"
 #include "zeromq_wrapper.h"
@@ -12,6 +21,144 @@
 #include <unistd.h>
 #include <zmq.h>
 
+/* Answers a request shed by the admission control with 429, telling an
+ * astronaut when it can act again (retry_ns from now) and its score (0 if the
+ * action doesn't have a valid token). Only called from the main loop, the only
+ * one that changes the players, so the latest snapshot has its current score */
+static void answer_shed(void *rep_socket, MESSAGE_TYPE msg_type,
+                        const void *request, snapshot_pool_t *snapshots,
+                        uint64_t retry_ns) {
+  const game_snapshot_t *snapshot;
+  const action_request_t *action_request;
+  astronaut_connect_response_t astronaut_connect_response = {0};
+  action_response_t action_response = {0};
+  /* Static as it can be too big for the stack on large boards */
+  static display_connect_response_t display_connect_response;
+  uint64_t retry_ms = (retry_ns + 999999) / 1000000;
+
+  switch (msg_type) {
+  case DISPLAY_CONNECT_REQUEST:
+    /* Only the status code, the first field (the rest is the game) */
+    display_connect_response.status_code = 429;
+    zmq_send_msg(rep_socket, DISPLAY_CONNECT_RESPONSE,
+                 &display_connect_response, sizeof(int), NO_TOPIC);
+    break;
+
+  case ASTRONAUT_CONNECT_REQUEST:
+    astronaut_connect_response.status_code = 429;
+    zmq_send_msg(rep_socket, ASTROUNAUT_CONNECT_RESPONSE,
+                 &astronaut_connect_response, -1, NO_TOPIC);
+    break;
+
+  case ACTION_REQUEST:
+    action_response.status_code = 429;
+    /* The actions without a valid token are shed too (see
+     * include/admission.h), so the id is checked before its score is read */
+    action_request = (const action_request_t *)request;
+    snapshot = snapshot_acquire(snapshots);
+    if (action_request->id >= 0 && action_request->id < MAX_PLAYERS &&
+        snapshot->tokens[action_request->id] == action_request->token)
+      action_response.player_score =
+          snapshot->game.players[action_request->id].score;
+    snapshot_release(snapshot);
+    action_response.action_wait_ms = retry_ms;
+    action_response.zap_wait_ms = retry_ms;
+    zmq_send_msg(rep_socket, ACTION_RESPONSE, &action_response, -1, NO_TOPIC);
+    break;
+
+  default:
+    /* The rest are never shed */
+    assert(false);
+  }
+}
+
+/* Answers, with the latest snapshot of the game and without the game lock, the
+ * requests that don't change it: the displays connecting, the connect requests
+ * resent (client_ids are the ones of the main loop, which changes them) and
+ * the requests that are rejected. Returns false if the request must still be
+ * applied to the game (its response is already filled) */
+static bool answer_from_snapshot(
+    snapshot_pool_t *snapshots, const uint64_t *client_ids, void *rep_socket,
+    MESSAGE_TYPE msg_type, void *request,
+    display_connect_response_t *display_connect_response,
+    astronaut_connect_response_t *astronaut_connect_response,
+    action_response_t *action_response,
+    status_code_and_score_response_t *status_code_and_score_response) {
+  const game_snapshot_t *snapshot = snapshot_acquire(snapshots);
+  bool answered = true;
+  int id;
+
+  switch (msg_type) {
+  case DISPLAY_CONNECT_REQUEST: /* Received by the displays clients */
+    display_connect_response->status_code = 200;
+    display_connect_response->next_sequence = snapshot->next_update_sequence;
+    display_connect_response->epoch = zmq_update_epoch();
+    TRACE_BEGIN("apply");
+    copy_game_state_for_display(display_connect_response, &snapshot->game);
+    TRACE_END("apply");
+    zmq_send_msg(rep_socket, DISPLAY_CONNECT_RESPONSE, display_connect_response,
+                 -1, NO_TOPIC);
+    break;
+
+  case ASTRONAUT_CONNECT_REQUEST: /* Received by the astronaut clients */
+    TRACE_BEGIN("validate");
+    id = find_resent_connect(*(astronaut_connect_request_t *)request,
+                             &snapshot->game, client_ids);
+    astronaut_connect_response->status_code =
+        validate_connect_request(&snapshot->game);
+    TRACE_END("validate");
+
+    /* Answered with the player it already has, even if the game is full */
+    if (id != -1) {
+      astronaut_connect_response->status_code = 200;
+      astronaut_connect_response->id = id;
+      astronaut_connect_response->token = snapshot->tokens[id];
+      astronaut_connect_response->orientation =
+          snapshot->game.players[id].orientation;
+      zmq_send_msg(rep_socket, ASTROUNAUT_CONNECT_RESPONSE,
+                   astronaut_connect_response, -1, NO_TOPIC);
+      break;
+    }
+
+    answered = astronaut_connect_response->status_code != 200;
+    if (answered)
+      zmq_send_msg(rep_socket, ASTROUNAUT_CONNECT_RESPONSE,
+                   astronaut_connect_response, -1, NO_TOPIC);
+    break;
+
+  case ACTION_REQUEST: /* Received by the astronaut clients */
+    TRACE_BEGIN("validate");
+    action_response->status_code =
+        validate_action_request(*(action_request_t *)request, &snapshot->game,
+                                snapshot->tokens, action_response);
+    TRACE_END("validate");
+
+    answered = action_response->status_code != 200;
+    if (answered)
+      zmq_send_msg(rep_socket, ACTION_RESPONSE, action_response, -1,
+                   NO_TOPIC);
+    break;
+
+  case DISCONNECT_REQUEST: /* Received by the astronaut clients */
+    TRACE_BEGIN("validate");
+    status_code_and_score_response->status_code = validate_disconnect_request(
+        *(disconnect_request_t *)request, &snapshot->game, snapshot->tokens);
+    TRACE_END("validate");
+
+    answered = status_code_and_score_response->status_code != 200;
+    if (answered)
+      zmq_send_msg(rep_socket, DISCONNECT_RESPONSE,
+                   status_code_and_score_response, -1, NO_TOPIC);
+    break;
+
+  default:
+    answered = false;
+  }
+
+  snapshot_release(snapshot);
+  return answered;
+}
+
 int main() {
   /* ZeroMQ/comms related */
   void *zmq_context = zmq_get_context();
@@ -20,104 +167,255 @@ int main() {
   MESSAGE_TYPE msg_type;
   /* Structs and temp pointer to receive/send requests/responses */
   void *temp_pointer;
-  astronaut_connect_response_t astronaut_connect_response;
-  display_connect_response_t display_connect_response;
+  /* Zeroed, as the addresses are only set by a lobby */
+  astronaut_connect_response_t astronaut_connect_response = {0};
+  /* Static as it can be too big for the stack on large boards */
+  static display_connect_response_t display_connect_response;
   action_request_t *action_request;
   action_response_t action_response;
   disconnect_request_t *disconnect_request;
   status_code_and_score_response_t status_code_and_score_response;
   /* Ncurses related */
-  WINDOW *game_window, *score_window;
-  /* Game state and authentication management */
-  game_t game;
+  nc_window_t *game_window, *score_window;
+  /* Game state and authentication management (static for the same reason).
+   * The aliens thread prepares each tick on the game that isn't the current
+   * one and then makes it the current one, so game can only be used holding
+   * the game lock */
+  static game_t games[2];
+  game_t *game = &games[0];
+  /* Aliens killed since the last tick, applied by the next one */
+  static aliens_kills_t kills;
+  /* Set by the connects and disconnects, whose reply waits for the game to
+   * be saved */
+  bool save_checkpoint = false;
   int previous_aliens_alive =
       N_ALIENS; /* Used to broadcast scores updates when an alien is killed */
   bool players_changed =
       false; /* Used to broadcast scores updates when a user joined/left */
+  /* Used to copy the aliens to the next snapshot only if they changed */
+  bool aliens_changed = false;
+  /* Rounds played so far and before stopping (0 if it never stops) */
+  const char *rounds_env = getenv(ROUNDS_ENV);
+  int round = 1, max_rounds = rounds_env != NULL ? atoi(rounds_env) : 0;
+  /* Set holding the lock once the last round ended (aliens_alive is also 0
+   * while the next round starts) */
+  bool game_over = false;
   int tokens[MAX_PLAYERS]; /* The authentication tokens used by the players */
+  /* The clients that connected the players (see astronaut_connect_request_t),
+   * changed holding the game lock as they are published with it */
+  static uint64_t client_ids[MAX_PLAYERS];
+  /* Broadcasted instead of the connect requests (without the client id) */
+  astronaut_connect_request_t published_connect = {0};
   /* Aliens update thread */
   pthread_t thread_id;
   aliens_update_thread_args_t thread_args;
   pthread_mutex_t lock; /* Also used for the thread that cleans the zaps */
-
-  /* ZeroMQ initialization */
-  zmq_bind_socket(rep_socket, SERVER_ZMQ_REQREP_BIND_ADDRESS);
-  zmq_bind_socket(pub_socket, SERVER_ZMQ_PUBSUB_BIND_ADDRESS);
+  /* Protects the screen and the publish socket, always taken after lock (the
+   * aliens thread publishes and draws a tick holding only this one) */
+  pthread_mutex_t io_lock;
+  /* Snapshots of the game, published after every change (static as they are
+   * big) */
+  static snapshot_pool_t snapshots;
+  const game_snapshot_t *snapshot;
+  /* Telemetry (static as the histograms are big) */
+  static server_stats_t stats;
+  pthread_t stats_thread_id;
+  stats_publish_thread_args_t stats_thread_args;
+  uint64_t wait_start_ns, received_ns, acquired_ns, retry_ns;
+  /* Limits checked before the requests are validated */
+  static admission_t admission;
+  /* Aliens random numbers and the journal (NULL if not recording) */
+  static game_rng_t rng;
+  const char *seed_env = getenv(JOURNAL_SEED_ENV);
+  const char *journal_path = getenv(JOURNAL_ENV);
+  uint64_t seed;
+  journal_t *journal = NULL;
+  /* Checkpoints of the game (NULL if not saved) */
+  const char *checkpoint_path = getenv(CHECKPOINT_ENV);
+  checkpoint_t *checkpoint = NULL;
+  bool restored = false;
+  /* Shared memory channel of the local displays (NULL if not used) */
+  const char *shm_name = getenv(SHM_ENV);
+  shm_channel_t *shm = NULL;
+  /* Tiles where the aliens are also published (NULL if the board isn't
+   * split) */
+  int tile_size = tiles_size_from_env();
+  tiles_t *tiles = tile_size > 0 ? tiles_create(tile_size) : NULL;
+
+  /* Before any thread is created (see include/trace.h) */
+  TRACE_INIT("game-server");
+  game_clock_init();
+  TRACE_THREAD_NAME("main loop");
+
+  /* ZeroMQ initialization (see SERVER_REQREP_ENV), with updates the readers of
+   * a previous server can tell apart (see update_header_t) */
+  zmq_start_update_epoch();
+  zmq_bind_socket(rep_socket, zmq_address_from_env(
+                                  SERVER_REQREP_ENV,
+                                  SERVER_ZMQ_REQREP_BIND_ADDRESS));
+  zmq_bind_socket(pub_socket, zmq_address_from_env(
+                                  SERVER_PUBSUB_ENV,
+                                  SERVER_ZMQ_PUBSUB_BIND_ADDRESS));
 
   /* Ncurses initialization */
   nc_init();
-  game_window = nc_init_space();
+  game_window = nc_init_space(0);
   score_window = nc_init_scoreboard();
 
   /* Initialize game and spawn helper child process to manage aliens updated */
-  srand((unsigned int)time(NULL)); /* Used for the aliens positions */
-  init_game(&game, tokens);
+  srand((unsigned int)time(NULL)); /* Used for the tokens */
+  if (checkpoint_path != NULL) {
+    checkpoint = checkpoint_open(checkpoint_path);
+    /* Resume the match of a server that stopped, with the same players */
+    restored =
+        checkpoint_restore(checkpoint, game, tokens, client_ids, &rng);
+  }
+  if (!restored) {
+    seed = seed_env != NULL ? strtoull(seed_env, NULL, 10)
+                            : (uint64_t)time(NULL) ^ (uint64_t)getpid();
+    game_rng_seed(&rng, seed);
+    init_game(game, tokens, &rng);
+    /* A journal must start with the match, so a resumed one isn't recorded */
+    if (journal_path != NULL)
+      journal = journal_create(journal_path, seed, game_clock_now_ms());
+  }
+  previous_aliens_alive = game->aliens_alive;
+  snapshot_pool_init(&snapshots, game, tokens, client_ids, &rng);
+  if (shm_name != NULL)
+    shm = shm_channel_create(shm_name, game);
+  /* The displays that connect learn if they can subscribe to the tiles */
+  display_connect_response.tile_size = tile_size;
   nc_draw_init_game(game_window, score_window, game);
 
   /* Aliens update thread creation */
   assert(pthread_mutex_init(&lock, NULL) == 0);
+  assert(pthread_mutex_init(&io_lock, NULL) == 0);
   thread_args.game = &game;
+  thread_args.spare_game = &games[1];
+  thread_args.kills = &kills;
   thread_args.game_window = game_window;
   thread_args.score_window = score_window;
   thread_args.pub_socket = pub_socket;
   thread_args.lock = &lock;
+  thread_args.io_lock = &io_lock;
+  thread_args.stats = &stats;
+  thread_args.rng = &rng;
+  thread_args.round = &round;
+  thread_args.game_over = &game_over;
+  thread_args.journal = journal;
+  thread_args.checkpoint = checkpoint;
+  thread_args.tokens = tokens;
+  thread_args.client_ids = client_ids;
+  thread_args.snapshots = &snapshots;
+  thread_args.shm = shm;
+  thread_args.tiles = tiles;
+  server_stats_init(&stats);
   assert(pthread_create(&thread_id, NULL, aliens_update_thread, &thread_args) ==
          0);
 
+  /* Stats publishing thread creation */
+  stats_thread_args.game_over = &game_over;
+  stats_thread_args.pub_socket = pub_socket;
+  stats_thread_args.lock = &lock;
+  stats_thread_args.io_lock = &io_lock;
+  stats_thread_args.stats = &stats;
+  /* The lobby is told about the server along with the stats */
+  stats_thread_args.lobby_socket = lobby_shard_socket(zmq_context);
+  stats_thread_args.snapshots = &snapshots;
+  assert(pthread_create(&stats_thread_id, NULL, stats_publish_thread,
+                        &stats_thread_args) == 0);
+
+  admission_init(&admission);
+
   /* Game loop */
-  while (game.aliens_alive) {
+  while (!game_over) {
+    wait_start_ns = get_monotonic_ns();
     temp_pointer = zmq_receive_msg(rep_socket, &msg_type, NO_TOPIC);
+    received_ns = get_monotonic_ns();
+    game_clock_refresh();
+    TRACE_BEGIN("request");
+
+    /* The players only change in this loop, so its tokens are the current
+     * ones (a shed request only costs its reply) */
+    admission_record_wait(&admission, wait_start_ns, received_ns);
+    if (!admission_admit(&admission, msg_type, temp_pointer, tokens,
+                         received_ns, &retry_ns)) {
+      answer_shed(rep_socket, msg_type, temp_pointer, &snapshots, retry_ns);
+      server_stats_record_shed(&stats, msg_type);
+      if (temp_pointer != NULL)
+        free(temp_pointer);
+      TRACE_END("request");
+      continue;
+    }
+
+    /* The players only change in this loop, which publishes a snapshot after
+     * every request it applies, so the latest one has their current state and
+     * the requests validated with it are still valid once the lock is taken */
+    if (answer_from_snapshot(&snapshots, client_ids, rep_socket, msg_type,
+                             temp_pointer, &display_connect_response,
+                             &astronaut_connect_response, &action_response,
+                             &status_code_and_score_response)) {
+      server_stats_record_lock_free(&stats, &lock, msg_type, received_ns);
+      if (temp_pointer != NULL)
+        free(temp_pointer);
+      TRACE_END("request");
+      continue;
+    }
 
     /*
     ========= Entering critical region =========
 
     The thread of the aliens update uses the game state, windows and publish
-    socket, so the requests can't be handled without using those resources
+    socket, so the requests can't be applied without using those resources
     */
-    pthread_mutex_lock(&lock);
+    acquired_ns = server_stats_lock(&stats, &lock, LOCK_MAIN_LOOP);
+    pthread_mutex_lock(&io_lock);
 
     switch (msg_type) {
-    case DISPLAY_CONNECT_REQUEST: /* Received by the displays clients */
-      display_connect_response.status_code = 200;
-      copy_game_state_for_display(&display_connect_response, &game);
-      zmq_send_msg(rep_socket, DISPLAY_CONNECT_RESPONSE,
-                   &display_connect_response, -1, NO_TOPIC);
-      break;
-
     case ASTRONAUT_CONNECT_REQUEST: /* Received by the astronaut clients */
-      astronaut_connect_response.status_code = validate_connect_request(game);
-
-      if (astronaut_connect_response.status_code == 200) {
-        players_changed = true;
-        /* Publish update */
-        zmq_send_msg(pub_socket, ASTRONAUT_CONNECT_REQUEST, NULL, -1,
-                     GAME_UPDATES_TOPIC);
-
-        handle_player_connect(game_window, &astronaut_connect_response, tokens,
-                              &game);
-      }
-
-      zmq_send_msg(rep_socket, ASTROUNAUT_CONNECT_RESPONSE,
-                   &astronaut_connect_response, -1, NO_TOPIC);
+      players_changed = true;
+      /* Publish update */
+      publish_game_update(pub_socket, shm, tiles, ASTRONAUT_CONNECT_REQUEST,
+                          &published_connect);
+
+      TRACE_BEGIN("apply");
+      handle_player_connect(game_window, &astronaut_connect_response, tokens,
+                            game);
+      client_ids[astronaut_connect_response.id] =
+          ((astronaut_connect_request_t *)temp_pointer)->client_id;
+      TRACE_END("apply");
+
+      if (journal != NULL)
+        journal_append_input(journal, JOURNAL_CONNECT,
+                             astronaut_connect_response.id, NULL,
+                             game_clock_now_ms());
+      /* The new token can't wait for the next tick (replied once saved) */
+      save_checkpoint = checkpoint != NULL;
+      if (!save_checkpoint)
+        zmq_send_msg(rep_socket, ASTROUNAUT_CONNECT_RESPONSE,
+                     &astronaut_connect_response, -1, NO_TOPIC);
       break;
 
     case ACTION_REQUEST: /* Received by the astronaut clients */
       action_request = (action_request_t *)temp_pointer;
+      aliens_changed = action_request->action_type == ZAP;
 
-      action_response.status_code = validate_action_request(
-          *action_request, game, tokens, &action_response);
+      TRACE_BEGIN("apply");
+      handle_player_action(action_request, &game->players[action_request->id],
+                           game_window, &game, &kills, &lock, &io_lock, NULL);
+      TRACE_END("apply");
 
-      if (action_response.status_code == 200) {
-        /* Publish update */
-        action_request->token = -1; /* Invalidate token */
-        zmq_send_msg(pub_socket, ACTION_REQUEST, action_request, -1,
-                     GAME_UPDATES_TOPIC);
+      /* Publish update (after it is applied, with the new score) */
+      action_request->token = -1; /* Invalidate token */
+      action_request->score = game->players[action_request->id].score;
+      publish_game_update(pub_socket, shm, tiles, ACTION_REQUEST,
+                          action_request);
 
-        handle_player_action(action_request, &game.players[action_request->id],
-                             game_window, &game, &lock);
+      if (journal != NULL)
+        journal_append_input(journal, JOURNAL_ACTION, action_request->id,
+                             action_request, game_clock_now_ms());
 
-        action_response.player_score = game.players[action_request->id].score;
-      }
+      action_response.player_score = game->players[action_request->id].score;
 
       zmq_send_msg(rep_socket, ACTION_RESPONSE, &action_response, -1, NO_TOPIC);
       break;
@@ -125,65 +423,139 @@ int main() {
     case DISCONNECT_REQUEST: /* Received by the astronaut clients */
       disconnect_request = (disconnect_request_t *)temp_pointer;
 
-      status_code_and_score_response.status_code =
-          validate_disconnect_request(*disconnect_request, game, tokens);
-
-      if (status_code_and_score_response.status_code == 200) {
-        players_changed = true;
-        /* Publish update */
-        disconnect_request->token = -1; /* Invalidate token */
-        zmq_send_msg(pub_socket, DISCONNECT_REQUEST, disconnect_request, -1,
-                     GAME_UPDATES_TOPIC);
-
-        handle_player_disconnect(game_window,
-                                 &game.players[disconnect_request->id]);
-
-        status_code_and_score_response.player_score =
-            game.players[disconnect_request->id].score;
-      }
-
-      zmq_send_msg(rep_socket, DISCONNECT_RESPONSE,
-                   &status_code_and_score_response, -1, NO_TOPIC);
+      players_changed = true;
+      /* Publish update */
+      disconnect_request->token = -1; /* Invalidate token */
+      publish_game_update(pub_socket, shm, tiles, DISCONNECT_REQUEST,
+                          disconnect_request);
+
+      TRACE_BEGIN("apply");
+      handle_player_disconnect(game_window, game, disconnect_request->id);
+      client_ids[disconnect_request->id] = 0;
+      TRACE_END("apply");
+
+      if (journal != NULL)
+        journal_append_input(journal, JOURNAL_DISCONNECT,
+                             disconnect_request->id, NULL, game_clock_now_ms());
+      status_code_and_score_response.player_score =
+          game->players[disconnect_request->id].score;
+
+      save_checkpoint = checkpoint != NULL;
+      if (!save_checkpoint)
+        zmq_send_msg(rep_socket, DISCONNECT_RESPONSE,
+                     &status_code_and_score_response, -1, NO_TOPIC);
       break;
 
     default:
-      previous_aliens_alive = game.aliens_alive;
+      previous_aliens_alive = game->aliens_alive;
       players_changed = false;
       if (temp_pointer != NULL)
         free(temp_pointer);
       /* ========= Leaving critical region ========= */
-      pthread_mutex_unlock(&lock);
+      pthread_mutex_unlock(&io_lock);
+      server_stats_unlock(&stats, &lock, LOCK_MAIN_LOOP, acquired_ns);
+      TRACE_END("request");
       continue;
     }
 
+    server_stats_record_service(&stats, msg_type, received_ns);
+
     /* If some aliens were killed or somebody connected/disconnected, broadcast
      * scores updates */
-    if (previous_aliens_alive > game.aliens_alive || players_changed)
-      zmq_broadcast_scores_updates(pub_socket, &game);
-
-    previous_aliens_alive = game.aliens_alive;
+    if (previous_aliens_alive > game->aliens_alive || players_changed)
+      zmq_broadcast_scores_updates(pub_socket, game);
+
+    /* Every alien was killed, so the next round starts right away with the
+     * same players (the displays draw its state in place of the old one) */
+    if (game->aliens_alive == 0 && (max_rounds <= 0 || round < max_rounds)) {
+      round++;
+      start_round(game, &rng);
+      /* The aliens killed were the ones of the last round */
+      kills.n_killed = 0;
+      if (journal != NULL)
+        journal_append_round(journal, game, game_clock_now_ms());
+
+      /* Reuses the display response, as it has the same contents */
+      display_connect_response.status_code = 200;
+      copy_game_state_for_display(&display_connect_response, game);
+      publish_game_update(pub_socket, shm, tiles, ROUND_STARTED,
+                          &display_connect_response);
+      zmq_broadcast_scores_updates(pub_socket, game);
+      nc_redraw_space(game_window, game);
+      aliens_changed = true;
+    }
+    game_over = game->aliens_alive == 0;
+
+    /* Before the lock is released, so the next request sees the changes */
+    TRACE_BEGIN("snapshot");
+    snapshot_publish(&snapshots, game, tokens, client_ids, &rng,
+                     aliens_changed, zmq_next_update_sequence());
+    if (shm != NULL)
+      shm_channel_write_game(shm, game, aliens_changed,
+                             zmq_next_update_sequence());
+    TRACE_END("snapshot");
+
+    previous_aliens_alive = game->aliens_alive;
     players_changed = false;
+    aliens_changed = false;
 
     if (temp_pointer != NULL)
       free(temp_pointer);
 
     /* Update scoreboard and refresh game windows */
-    nc_update_scoreboard(score_window, game.players, game.aliens_alive);
-    wrefresh(game_window);
-    wrefresh(score_window);
+    nc_update_scoreboard(score_window, game->players, game->aliens_alive);
+    nc_stage(game_window);
+    nc_stage(score_window);
+    nc_flush();
 
     /* ========= Leaving critical region ========= */
-    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&io_lock);
+    server_stats_unlock(&stats, &lock, LOCK_MAIN_LOOP, acquired_ns);
+
+    /* From the snapshot just published (or a newer one), without the game
+     * lock */
+    if (save_checkpoint) {
+      TRACE_BEGIN("save");
+      snapshot = snapshot_acquire(&snapshots);
+      checkpoint_save(checkpoint, snapshot, game_clock_now_ms());
+      snapshot_release(snapshot);
+      TRACE_END("save");
+
+      if (msg_type == ASTRONAUT_CONNECT_REQUEST)
+        zmq_send_msg(rep_socket, ASTROUNAUT_CONNECT_RESPONSE,
+                     &astronaut_connect_response, -1, NO_TOPIC);
+      else
+        zmq_send_msg(rep_socket, DISCONNECT_RESPONSE,
+                     &status_code_and_score_response, -1, NO_TOPIC);
+      save_checkpoint = false;
+    }
+    TRACE_END("request");
   }
 
-  /* Publish final update because game ended */
-  zmq_send_msg(pub_socket, GAME_ENDED, NULL, -1, GAME_UPDATES_TOPIC);
+  /* Publish final update because game ended (the aliens thread may still be
+   * publishing its last tick) */
+  pthread_mutex_lock(&io_lock);
+  publish_game_update(pub_socket, shm, tiles, GAME_ENDED, NULL);
+  pthread_mutex_unlock(&io_lock);
 
   pthread_join(thread_id, NULL);
-  print_winning_player(&game);
+  pthread_join(stats_thread_id, NULL);
+  if (journal != NULL)
+    journal_close(journal);
+  /* The match ended, so the next server starts a new one */
+  if (checkpoint != NULL)
+    checkpoint_close(checkpoint, true);
+  /* The displays that mapped it can still read the end of the game */
+  if (shm != NULL)
+    shm_channel_destroy(shm);
+  if (tiles != NULL)
+    tiles_destroy(tiles);
+  print_winning_player(game);
 
   /* Resources cleanup */
   pthread_mutex_destroy(&lock);
+  pthread_mutex_destroy(&io_lock);
   nc_cleanup();
+  zmq_cleanup(NULL, stats_thread_args.lobby_socket, NULL);
   zmq_cleanup(zmq_context, rep_socket, pub_socket);
 }
\ No newline at end of file
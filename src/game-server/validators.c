@@ -3,35 +3,61 @@
 #include "validators.h"
 
 /* Validates the connect request and returns the status code  */
-int validate_connect_request(game_t game) {
+int validate_connect_request(const game_t *game) {
 
   /* Check if there is a free position to play */
   for (int i = 0; i < MAX_PLAYERS; i++) {
-    if (!game.players[i].connected)
+    if (!game->players[i].connected)
       return 200;
   }
 
   return 400;
 }
 
+/* Returns the player connected by the client of a connect request if the
+ * request was already applied (e.g. resent while the server restarted), or -1
+ * if it wasn't */
+int find_resent_connect(astronaut_connect_request_t request,
+                        const game_t *game, const uint64_t *client_ids) {
+
+  /* 0 is never chosen by the clients */
+  if (request.client_id == 0)
+    return -1;
+
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    if (game->players[i].connected && client_ids[i] == request.client_id)
+      return i;
+  }
+
+  return -1;
+}
+
+/* Returns the ms left at current_ts until more than delay ms passed since
+ * since_ts */
+static uint64_t time_left(uint64_t since_ts, uint64_t delay,
+                          uint64_t current_ts) {
+  return delay + 1 - (current_ts - since_ts);
+}
+
 /* Validates the action request and returns the status code */
-int validate_action_request(action_request_t request, game_t game, int *tokens,
+int validate_action_request(action_request_t request, const game_t *game,
+                            const int *tokens,
                             action_response_t *action_response) {
 
   int id = request.id;
   int request_token = request.token;
   player_t player;
-  uint64_t current_ts = get_timestamp_ms();
+  uint64_t current_ts = game_clock_now_ms();
 
   /* Initially, there is no delay */
-  action_response->next_allowed_action_timestamp = current_ts;
-  action_response->next_allowed_zap_timestamp = current_ts;
+  action_response->action_wait_ms = 0;
+  action_response->zap_wait_ms = 0;
 
   /* ID not valid */
   if (!(id >= 0 && id < MAX_PLAYERS))
     return 400;
 
-  player = game.players[id];
+  player = game->players[id];
 
   /* Player wasn't connected */
   if (!(player.connected))
@@ -45,15 +71,15 @@ int validate_action_request(action_request_t request, game_t game, int *tokens,
   case ZAP:
     /* Player is stunned */
     if (!(current_ts - player.last_stunned > STUNNED_DELAY)) {
-      action_response->next_allowed_action_timestamp =
-          player.last_stunned + STUNNED_DELAY;
+      action_response->action_wait_ms =
+          time_left(player.last_stunned, STUNNED_DELAY, current_ts);
       return 400;
     }
 
     /* Player shot */
     if (!(current_ts - player.last_shot > ZAP_DELAY)) {
-      action_response->next_allowed_zap_timestamp =
-          player.last_shot + ZAP_DELAY;
+      action_response->zap_wait_ms =
+          time_left(player.last_shot, ZAP_DELAY, current_ts);
       return 400;
     }
 
@@ -62,8 +88,8 @@ int validate_action_request(action_request_t request, game_t game, int *tokens,
 
     /* Player is stunned */
     if (!(current_ts - player.last_stunned > STUNNED_DELAY)) {
-      action_response->next_allowed_action_timestamp =
-          player.last_stunned + STUNNED_DELAY;
+      action_response->action_wait_ms =
+          time_left(player.last_stunned, STUNNED_DELAY, current_ts);
       return 400;
     }
 
@@ -90,8 +116,8 @@ int validate_action_request(action_request_t request, game_t game, int *tokens,
 }
 
 /* Validates  the request and returns status code */
-int validate_disconnect_request(disconnect_request_t request, game_t game,
-                                int *tokens) {
+int validate_disconnect_request(disconnect_request_t request,
+                                const game_t *game, const int *tokens) {
 
   int id = request.id;
   int request_token = request.token;
@@ -101,7 +127,7 @@ int validate_disconnect_request(disconnect_request_t request, game_t game,
   if (!(id >= 0 && id < MAX_PLAYERS))
     return 400;
 
-  player = game.players[id];
+  player = game->players[id];
 
   /* Player wasn't connected */
   if (!(player.connected))
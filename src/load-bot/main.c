@@ -0,0 +1,558 @@
+/* Load generator: runs scripted astronauts (and optionally passive displays)
+ * against the game-server and reports the latency of each request */
+
+#include "admission.h"
+#include "comms.h"
+#include "histogram.h"
+#include "lobby.h"
+#include "tiles.h"
+#include "utils.h"
+#include "zeromq_wrapper.h"
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zmq.h>
+
+/* Time waited for a reply before giving up on the server */
+#define LOAD_BOT_REPLY_TIMEOUT_MS 2000
+
+/* Status codes counted (any code above is counted as the last one) */
+#define LOAD_BOT_MAX_STATUS_CODE 599
+
+/* Maximum number of bots/displays */
+#define LOAD_BOT_MAX_THREADS 1024
+
+/* How the bots choose their actions */
+typedef enum {
+  PATTERN_RANDOM, /* Moves and zaps at random */
+  PATTERN_MOVE,   /* Only moves */
+  PATTERN_ZAP     /* Only zaps */
+} LOAD_PATTERN;
+
+static const char *pattern_names[] = {"random", "move", "zap"};
+
+typedef struct {
+  int n_astronauts;
+  int n_displays;
+  /* Actions per second of each astronaut */
+  double rate;
+  LOAD_PATTERN pattern;
+  int duration_s;
+  /* Sends actions even when the client side delays (stunned/zap) say the
+   * server will reject them */
+  bool ignore_delays;
+  /* Side of the part of the board the displays show (0 for all of it), so
+   * they only subscribe to its tiles when the server splits the board */
+  int view_cells;
+  const char *report_path;
+} load_config_t;
+
+/* Measures of a type of request */
+typedef enum {
+  OP_ASTRONAUT_CONNECT,
+  OP_ACTION,
+  OP_DISCONNECT,
+  OP_DISPLAY_CONNECT,
+  N_OPS
+} LOAD_OP;
+
+static const char *op_names[N_OPS] = {"connect", "action", "disconnect",
+                                      "display_connect"};
+
+typedef struct {
+  histogram_t latency;
+  uint64_t status_codes[LOAD_BOT_MAX_STATUS_CODE + 1];
+} op_results_t;
+
+typedef struct {
+  op_results_t ops[N_OPS];
+  /* Requests that got no reply in time (the bot stops afterwards) */
+  uint64_t timeouts;
+  /* Game updates received by the displays and their latency */
+  histogram_t receive_lag;
+  uint64_t missed_updates;
+  uint64_t update_bytes;
+} load_results_t;
+
+/* Shared by every thread */
+static load_config_t config;
+static void *zmq_context;
+static atomic_bool stop_load;
+/* Each thread merges its results when it finishes */
+static load_results_t results;
+static pthread_mutex_t results_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/******************** Helpers ********************/
+
+/* Adds the results of a thread to the global ones */
+static void merge_results(load_results_t *thread_results) {
+  pthread_mutex_lock(&results_lock);
+
+  for (int op = 0; op < N_OPS; op++) {
+    histogram_merge(&results.ops[op].latency,
+                    &thread_results->ops[op].latency);
+    for (int code = 0; code <= LOAD_BOT_MAX_STATUS_CODE; code++)
+      results.ops[op].status_codes[code] +=
+          thread_results->ops[op].status_codes[code];
+  }
+  results.timeouts += thread_results->timeouts;
+  histogram_merge(&results.receive_lag, &thread_results->receive_lag);
+  results.missed_updates += thread_results->missed_updates;
+  results.update_bytes += thread_results->update_bytes;
+
+  pthread_mutex_unlock(&results_lock);
+}
+
+/* Sends a request and waits for the reply, measuring its latency. Returns NULL
+ * (and counts a timeout) if the server didn't reply in time */
+static void *timed_request(void *req_socket, MESSAGE_TYPE request_type,
+                           void *request, LOAD_OP op,
+                           load_results_t *thread_results) {
+  zmq_pollitem_t poll_item = {req_socket, 0, ZMQ_POLLIN, 0};
+  MESSAGE_TYPE msg_type;
+  uint64_t start_ns = get_monotonic_ns();
+  void *reply;
+  int status_code;
+
+  zmq_send_msg(req_socket, request_type, request, -1, NO_TOPIC);
+
+  if (zmq_poll(&poll_item, 1, LOAD_BOT_REPLY_TIMEOUT_MS) <= 0) {
+    thread_results->timeouts++;
+    return NULL;
+  }
+  reply = zmq_receive_msg(req_socket, &msg_type, NO_TOPIC);
+
+  histogram_record(&thread_results->ops[op].latency,
+                   get_monotonic_ns() - start_ns);
+
+  /* Every reply starts with the status code */
+  status_code = *(int *)reply;
+  if (status_code < 0 || status_code > LOAD_BOT_MAX_STATUS_CODE)
+    status_code = LOAD_BOT_MAX_STATUS_CODE;
+  thread_results->ops[op].status_codes[status_code]++;
+
+  return reply;
+}
+
+/* Sleeps until the given monotonic time (or until the load stops) */
+static void sleep_until(uint64_t deadline_ns) {
+  uint64_t now_ns;
+
+  while (!stop_load && (now_ns = get_monotonic_ns()) < deadline_ns)
+    usleep((deadline_ns - now_ns) / 1000 < 100000
+               ? (useconds_t)((deadline_ns - now_ns) / 1000)
+               : 100000);
+}
+
+/* Chooses the next action of a bot */
+static void choose_action(action_request_t *action_request,
+                          MOVEMENT_ORIENTATION orientation) {
+  bool zap = config.pattern == PATTERN_ZAP ||
+             (config.pattern == PATTERN_RANDOM && rand() % 4 == 0);
+
+  if (zap) {
+    action_request->action_type = ZAP;
+    action_request->movement_direction = NO_MOVEMENT;
+  } else {
+    action_request->action_type = MOVE;
+    if (orientation == VERTICAL)
+      action_request->movement_direction = rand() % 2 ? UP : DOWN;
+    else
+      action_request->movement_direction = rand() % 2 ? LEFT : RIGHT;
+  }
+}
+
+/******************** Threads ********************/
+
+/* Scripted astronaut: connects, sends actions at the configured rate and
+ * disconnects when the load stops */
+static void *astronaut_bot_main(void *void_args) {
+  (void)void_args;
+  void *req_socket = zmq_create_socket(zmq_context, ZMQ_REQ);
+  /* On the heap as they are too big for the thread stacks */
+  load_results_t *thread_results = calloc(1, sizeof(load_results_t));
+  astronaut_connect_request_t connect_request = new_connect_request();
+  astronaut_connect_response_t *connect_response;
+  action_request_t action_request;
+  action_response_t *action_response;
+  disconnect_request_t disconnect_request;
+  void *reply;
+  MOVEMENT_ORIENTATION orientation;
+  uint64_t interval_ns = (uint64_t)(1e9 / config.rate);
+  uint64_t next_send_ns = get_monotonic_ns();
+  uint64_t next_allowed_action = 0, next_allowed_zap = 0;
+
+  assert(thread_results != NULL);
+  /* Through the lobby, if any (see include/lobby.h) */
+  zmq_connect_socket(req_socket, lobby_connect_address());
+
+  connect_response = (astronaut_connect_response_t *)timed_request(
+      req_socket, ASTRONAUT_CONNECT_REQUEST, &connect_request,
+      OP_ASTRONAUT_CONNECT, thread_results);
+
+  /* Rejected (the game is full) or no reply */
+  if (connect_response == NULL || connect_response->status_code != 200) {
+    free(connect_response);
+    merge_results(thread_results);
+    free(thread_results);
+    zmq_cleanup(NULL, req_socket, NULL);
+    return NULL;
+  }
+
+  action_request.id = connect_response->id;
+  action_request.token = connect_response->token;
+  action_request.sequence = 0;
+  orientation = connect_response->orientation;
+  disconnect_request.id = connect_response->id;
+  disconnect_request.token = connect_response->token;
+  lobby_follow_shard(req_socket, lobby_connect_address(), connect_response);
+  free(connect_response);
+
+  while (!stop_load) {
+    next_send_ns += interval_ns;
+    sleep_until(next_send_ns);
+    if (stop_load)
+      break;
+
+    choose_action(&action_request, orientation);
+
+    /* Behave like astronaut-client, which doesn't send what would be
+     * rejected */
+    game_clock_refresh();
+    if (!config.ignore_delays &&
+        (game_clock_now_ms() < next_allowed_action ||
+         (action_request.action_type == ZAP &&
+          game_clock_now_ms() < next_allowed_zap)))
+      continue;
+
+    action_response = (action_response_t *)timed_request(
+        req_socket, ACTION_REQUEST, &action_request, OP_ACTION,
+        thread_results);
+    if (action_response == NULL)
+      break;
+
+    /* Times left, added to the clock of this program */
+    game_clock_refresh();
+    next_allowed_action = game_clock_now_ms() + action_response->action_wait_ms;
+    next_allowed_zap = game_clock_now_ms() + action_response->zap_wait_ms;
+    action_request.sequence++;
+    free(action_response);
+  }
+
+  /* Can't send anything else after a timeout (REQ socket waits a reply) */
+  if (thread_results->timeouts == 0) {
+    reply = timed_request(req_socket, DISCONNECT_REQUEST, &disconnect_request,
+                          OP_DISCONNECT, thread_results);
+    free(reply);
+  }
+
+  merge_results(thread_results);
+  free(thread_results);
+  zmq_cleanup(NULL, req_socket, NULL);
+
+  return NULL;
+}
+
+/* Returns the bytes of a game update received (all of its parts) */
+static uint64_t update_bytes(MESSAGE_TYPE msg_type, void *msg) {
+  uint64_t bytes = sizeof(PUBSUB_TOPICS) + sizeof(update_header_t) +
+                   sizeof(MESSAGE_TYPE) + get_msg_size(msg_type);
+
+  if (msg_type == ALIENS_TILE_UPDATE)
+    bytes += ((aliens_tile_update_t *)msg)->n_aliens * sizeof(tile_alien_t);
+  return bytes;
+}
+
+/* Passive display: gets the game state and receives every update (or the ones
+ * of its view) until the load stops */
+static void *display_bot_main(void *void_args) {
+  (void)void_args;
+  void *req_socket = zmq_create_socket(zmq_context, ZMQ_REQ);
+  void *sub_socket = zmq_create_socket(zmq_context, ZMQ_SUB);
+  load_results_t *thread_results = calloc(1, sizeof(load_results_t));
+  zmq_pollitem_t poll_item = {sub_socket, 0, ZMQ_POLLIN, 0};
+  MESSAGE_TYPE msg_type;
+  update_header_t header;
+  int64_t last_sequence = -1;
+  uint64_t now_ns;
+  void *msg, *update;
+  int tile_size = 0;
+  bool connected, *subscribed = NULL;
+
+  assert(thread_results != NULL);
+  zmq_connect_socket(req_socket,
+                     zmq_address_from_env(DISPLAY_REQREP_ENV,
+                                          zmq_server_reqrep_address()));
+  zmq_connect_socket(sub_socket,
+                     zmq_address_from_env(DISPLAY_PUBSUB_ENV,
+                                          zmq_server_pubsub_address()));
+  zmq_subscribe(sub_socket, GAME_UPDATES_TOPIC);
+
+  /* Again after a while if the server is busy (see include/admission.h) */
+  while ((msg = timed_request(req_socket, DISPLAY_CONNECT_REQUEST, NULL,
+                              OP_DISPLAY_CONNECT, thread_results)) != NULL &&
+         *(int *)msg == 429 && !stop_load) {
+    free(msg);
+    usleep(ADMISSION_RETRY_MS * 1000);
+  }
+  if (msg != NULL && *(int *)msg != 200) {
+    free(msg);
+    msg = NULL;
+  }
+  connected = msg != NULL;
+  if (connected)
+    tile_size = ((display_connect_response_t *)msg)->tile_size;
+  free(msg);
+
+  /* Only the tiles of the view, from its top left corner (the updates of the
+   * tiles share the sequence of their tick) */
+  if (connected && config.view_cells > 0 && tile_size > 0) {
+    subscribed = (bool *)calloc(
+        tiles_per_side(tile_size) * tiles_per_side(tile_size), sizeof(bool));
+    assert(subscribed != NULL);
+    zmq_subscribe(sub_socket, PLAYER_UPDATES_TOPIC);
+    tiles_subscribe_area(sub_socket, tile_size, 0, 0, config.view_cells,
+                         config.view_cells, subscribed);
+    zmq_unsubscribe(sub_socket, GAME_UPDATES_TOPIC);
+  }
+
+  while (connected && !stop_load) {
+    assert(zmq_poll(&poll_item, 1, 100) != -1);
+    if (!(poll_item.revents & ZMQ_POLLIN))
+      continue;
+
+    update = zmq_receive_stamped_msg(sub_socket, &msg_type,
+                                     GAME_UPDATES_TOPIC, &header);
+    now_ns = get_monotonic_ns();
+    thread_results->update_bytes += update_bytes(msg_type, update);
+    free(update);
+
+    histogram_record(&thread_results->receive_lag,
+                     now_ns > header.sent_ns ? now_ns - header.sent_ns : 0);
+    if (last_sequence != -1 && (int64_t)header.sequence > last_sequence + 1)
+      thread_results->missed_updates += header.sequence - last_sequence - 1;
+    last_sequence = (int64_t)header.sequence;
+
+    /* The server stops answering when the game ends */
+    if (msg_type == GAME_ENDED)
+      stop_load = true;
+  }
+
+  merge_results(thread_results);
+  free(thread_results);
+  free(subscribed);
+  zmq_cleanup(NULL, req_socket, sub_socket);
+
+  return NULL;
+}
+
+/******************** Report ********************/
+
+/* Prints a line of the report table */
+static void print_op(const char *name, const histogram_t *latency,
+                     double elapsed_s) {
+  printf("%-16s %8lu %9.1f %9.3f %9.3f %9.3f %9.3f\n", name,
+         (unsigned long)latency->total, latency->total / elapsed_s,
+         histogram_percentile(latency, 50) / 1e6,
+         histogram_percentile(latency, 99) / 1e6,
+         histogram_percentile(latency, 99.9) / 1e6, latency->max / 1e6);
+}
+
+/* Writes the percentiles of a histogram as a JSON object */
+static void write_json_latency(FILE *file, const histogram_t *latency) {
+  fprintf(file,
+          "{\"count\": %lu, \"p50_ms\": %.4f, \"p99_ms\": %.4f, "
+          "\"p999_ms\": %.4f, \"max_ms\": %.4f}",
+          (unsigned long)latency->total,
+          histogram_percentile(latency, 50) / 1e6,
+          histogram_percentile(latency, 99) / 1e6,
+          histogram_percentile(latency, 99.9) / 1e6, latency->max / 1e6);
+}
+
+/* Writes the results as JSON, so different builds can be compared */
+static void write_json_report(double elapsed_s) {
+  FILE *file = fopen(config.report_path, "w");
+  bool first;
+
+  if (file == NULL) {
+    printf("Couldn't write the report to %s\n", config.report_path);
+    return;
+  }
+
+  fprintf(file, "{\n  \"config\": {\"astronauts\": %d, \"displays\": %d, "
+                "\"rate\": %.2f, \"pattern\": \"%s\", \"duration_s\": %d, "
+                "\"ignore_delays\": %s, \"space_size\": %d},\n",
+          config.n_astronauts, config.n_displays, config.rate,
+          pattern_names[config.pattern], config.duration_s,
+          config.ignore_delays ? "true" : "false", SPACE_SIZE);
+  fprintf(file, "  \"elapsed_s\": %.3f,\n  \"timeouts\": %lu,\n", elapsed_s,
+          (unsigned long)results.timeouts);
+
+  fprintf(file, "  \"operations\": {\n");
+  for (int op = 0; op < N_OPS; op++) {
+    fprintf(file, "    \"%s\": {\"throughput_per_s\": %.2f, \"latency\": ",
+            op_names[op], results.ops[op].latency.total / elapsed_s);
+    write_json_latency(file, &results.ops[op].latency);
+
+    fprintf(file, ", \"status_codes\": {");
+    first = true;
+    for (int code = 0; code <= LOAD_BOT_MAX_STATUS_CODE; code++) {
+      if (results.ops[op].status_codes[code] == 0)
+        continue;
+      fprintf(file, "%s\"%d\": %lu", first ? "" : ", ", code,
+              (unsigned long)results.ops[op].status_codes[code]);
+      first = false;
+    }
+    fprintf(file, "}}%s\n", op < N_OPS - 1 ? "," : "");
+  }
+  fprintf(file, "  },\n");
+
+  fprintf(file,
+          "  \"displays\": {\"view_cells\": %d, \"missed_updates\": %lu, "
+          "\"bytes_per_display\": %lu, \"receive_lag\": ",
+          config.view_cells, (unsigned long)results.missed_updates,
+          (unsigned long)(config.n_displays > 0
+                              ? results.update_bytes / config.n_displays
+                              : 0));
+  write_json_latency(file, &results.receive_lag);
+  fprintf(file, "}\n}\n");
+
+  fclose(file);
+}
+
+/* Prints the results and writes the JSON report */
+static void report(double elapsed_s) {
+  printf("\n%-16s %8s %9s %9s %9s %9s %9s\n", "Request", "count", "per s",
+         "p50 ms", "p99 ms", "p999 ms", "max ms");
+  for (int op = 0; op < N_OPS; op++)
+    print_op(op_names[op], &results.ops[op].latency, elapsed_s);
+  if (config.n_displays > 0)
+    print_op("update received", &results.receive_lag, elapsed_s);
+
+  printf("\nStatus codes:\n");
+  for (int op = 0; op < N_OPS; op++) {
+    for (int code = 0; code <= LOAD_BOT_MAX_STATUS_CODE; code++) {
+      if (results.ops[op].status_codes[code] > 0)
+        printf("  %-16s %d: %lu\n", op_names[op], code,
+               (unsigned long)results.ops[op].status_codes[code]);
+    }
+  }
+  printf("Timeouts: %lu\n", (unsigned long)results.timeouts);
+  if (config.n_displays > 0) {
+    printf("Updates missed by the displays: %lu\n",
+           (unsigned long)results.missed_updates);
+    printf("Bytes received by each display: %lu\n",
+           (unsigned long)(results.update_bytes / config.n_displays));
+  }
+
+  write_json_report(elapsed_s);
+  printf("\nReport written to %s\n", config.report_path);
+}
+
+/******************** Main ********************/
+
+/* Prints the usage and exits */
+static void usage(const char *program) {
+  printf("Usage: %s [-a astronauts] [-d displays] [-r actions/s] "
+         "[-p random|move|zap] [-t seconds] [-i] [-v cells] "
+         "[-o report.json]\n\n"
+         "  -i  send actions even when stunned or the zap is recharging\n"
+         "  -v  the displays only show (and subscribe to the tiles of) the "
+         "cells x cells\n      at the top left of the board\n",
+         program);
+  exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+  pthread_t threads[LOAD_BOT_MAX_THREADS];
+  int n_threads = 0, option;
+  uint64_t start_ns;
+  double elapsed_s;
+
+  /* Defaults: a full game of well behaved astronauts */
+  config.n_astronauts = MAX_PLAYERS;
+  config.n_displays = 0;
+  config.rate = 5;
+  config.pattern = PATTERN_RANDOM;
+  config.duration_s = 10;
+  config.ignore_delays = false;
+  config.view_cells = 0;
+  config.report_path = "load-bot-report.json";
+
+  while ((option = getopt(argc, argv, "a:d:r:p:t:iv:o:h")) != -1) {
+    switch (option) {
+    case 'a':
+      config.n_astronauts = atoi(optarg);
+      break;
+    case 'd':
+      config.n_displays = atoi(optarg);
+      break;
+    case 'r':
+      config.rate = atof(optarg);
+      break;
+    case 'p':
+      if (strcmp(optarg, "move") == 0)
+        config.pattern = PATTERN_MOVE;
+      else if (strcmp(optarg, "zap") == 0)
+        config.pattern = PATTERN_ZAP;
+      else if (strcmp(optarg, "random") == 0)
+        config.pattern = PATTERN_RANDOM;
+      else
+        usage(argv[0]);
+      break;
+    case 't':
+      config.duration_s = atoi(optarg);
+      break;
+    case 'i':
+      config.ignore_delays = true;
+      break;
+    case 'v':
+      config.view_cells = atoi(optarg);
+      break;
+    case 'o':
+      config.report_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (config.n_astronauts < 0 || config.n_displays < 0 || config.rate <= 0 ||
+      config.duration_s <= 0 || config.view_cells < 0 ||
+      config.n_astronauts + config.n_displays > LOAD_BOT_MAX_THREADS)
+    usage(argv[0]);
+
+  srand((unsigned int)time(NULL));
+  game_clock_init();
+  zmq_context = zmq_get_context();
+
+  printf("Running %d astronauts (%.1f actions/s, %s) and %d displays for %d "
+         "s...\n",
+         config.n_astronauts, config.rate, pattern_names[config.pattern],
+         config.n_displays, config.duration_s);
+
+  /* Displays first, so they see the astronauts connecting */
+  start_ns = get_monotonic_ns();
+  for (int i = 0; i < config.n_displays; i++)
+    assert(pthread_create(&threads[n_threads++], NULL, display_bot_main,
+                          NULL) == 0);
+  for (int i = 0; i < config.n_astronauts; i++)
+    assert(pthread_create(&threads[n_threads++], NULL, astronaut_bot_main,
+                          NULL) == 0);
+
+  sleep_until(start_ns + (uint64_t)config.duration_s * 1000000000);
+  stop_load = true;
+
+  for (int i = 0; i < n_threads; i++)
+    pthread_join(threads[i], NULL);
+  elapsed_s = (get_monotonic_ns() - start_ns) / 1e9;
+
+  report(elapsed_s);
+
+  zmq_cleanup(zmq_context, NULL, NULL);
+
+  return 0;
+}
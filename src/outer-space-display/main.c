@@ -2,19 +2,29 @@
 
 int main() {
   threaded_mains_args_t args;
-  pthread_mutex_t ncurses_lock;
-  bool terminate_threads = false;
+  ui_t ui;
+  atomic_bool terminate_threads = false;
+  pthread_t outer_space_display;
 
-  /* Even though no thread is created here, some threads will be created later
-   * to clean up the player's zaps and will use this lock */
-  assert(pthread_mutex_init(&ncurses_lock, NULL) == 0);
-  args.threaded = true;
-  args.ncurses_lock = &ncurses_lock;
+  /* Before any thread is created (see include/trace.h) */
+  TRACE_INIT("outer-space-display");
+  game_clock_init();
+  ui_init(&ui, true, false);
+  args.zmq_context = zmq_get_context();
+  args.ui = &ui;
   args.terminate_threads = &terminate_threads;
+  args.placement = NULL;
 
-  outer_space_display_main(&args);
+  assert(pthread_create(&outer_space_display, NULL, outer_space_display_main,
+                        &args) == 0);
 
-  pthread_mutex_destroy(&ncurses_lock);
+  /* The main thread owns the screen */
+  ui_main(&ui);
+
+  pthread_join(outer_space_display, NULL);
+
+  ui_destroy(&ui);
+  zmq_cleanup(args.zmq_context, NULL, NULL);
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,588 @@
+/* Microbenchmarks of the game core and the message codec hot paths (the board
+ * size is fixed at build time, "make bench" builds one per size) */
+
+#include "aliens_pool.h"
+#include "game_snapshot.h"
+#include "shm_channel.h"
+#include "utils.h"
+#include "zeromq_wrapper.h"
+#include <string.h>
+#include <zmq.h>
+
+/* Samples discarded before measuring (warm caches and branch predictors) */
+#define BENCH_WARMUP_SAMPLES 20
+
+/* Samples measured per benchmark */
+#define BENCH_SAMPLES 101
+
+/* Minimum duration of a sample, so the clock resolution doesn't matter */
+#define BENCH_MIN_SAMPLE_NS 200000
+
+/* Percentage of the aliens alive on each run of the alien benchmarks */
+#define BENCH_ALIVE_PERCENTAGES {100, 50, 10}
+
+/* Board rows/cols drawn on the (null) game window */
+#define BENCH_VIEWPORT_SIZE 50
+
+/* Messages that can be queued on the inproc socket before draining it */
+#define BENCH_MAX_QUEUED_MESSAGES 256
+
+#define BENCH_INPROC_ADDRESS "inproc://space-bench"
+
+/* Addresses of the action round trip benchmarks (the ipc one gets the pid, so
+ * two runs don't share it) */
+#define BENCH_RTT_TCP_ADDRESS "tcp://127.0.0.1:62770"
+#define BENCH_RTT_IPC_ADDRESS "ipc:///tmp/space-bench-%d"
+#define BENCH_RTT_INPROC_ADDRESS "inproc://space-bench-rtt"
+#define BENCH_RTT_TRANSPORTS 3
+
+/* State used by the benchmarks (static as it's too big for the stack on large
+ * boards) */
+typedef struct {
+  game_t game;
+  /* Copy of the game restored by the benchmarks that change it */
+  game_t initial_game;
+  /* Two alien updates with the same aliens alive, applied alternately */
+  aliens_update_t aliens_updates[2];
+  game_rng_t rng;
+  int tokens[MAX_PLAYERS];
+  uint64_t client_ids[MAX_PLAYERS];
+  /* Where aliens_commit_kills prepares the next game (with no kills) */
+  game_t next_game;
+  aliens_kills_t kills;
+  snapshot_pool_t snapshots;
+  /* Shared memory channel, written and read by the same process */
+  shm_channel_t *shm;
+  const shm_segment_t *shm_segment;
+  aliens_update_t shm_aliens_update;
+  /* Used by aliens_pool_move (see measure_aliens_pool) */
+  aliens_pool_t *aliens_pool;
+  display_connect_response_t display_response;
+  nc_window_t *game_window;
+  nc_window_t *score_window;
+  void *push_socket;
+  void *pull_socket;
+  /* Sends the actions to action_server_main (see measure_action_rtt) */
+  void *req_socket;
+  /* Number of calls made by the benchmark */
+  uint64_t iteration;
+} bench_state_t;
+
+typedef struct {
+  const char *name;
+  /* Prepares the state before each sample, not timed (can be NULL) */
+  void (*setup)(bench_state_t *state);
+  /* The code measured */
+  void (*run)(bench_state_t *state);
+  /* Maximum calls per sample (0 if unlimited) */
+  int max_batch;
+  /* Ran once per percentage of aliens alive */
+  bool uses_aliens;
+} benchmark_t;
+
+static bench_state_t state;
+
+/******************** Benchmarks ********************/
+
+/* Restores the game killed by the previous zaps */
+static void restore_game(bench_state_t *state) {
+  memcpy(&state->game, &state->initial_game, sizeof(game_t));
+}
+
+/* Zaps with each player in turn */
+static void run_player_zap(bench_state_t *state) {
+  player_zap(&state->game, (int)(state->iteration % MAX_PLAYERS),
+             game_clock_now_ms(), NULL);
+}
+
+/* Moves the aliens (the loop of the aliens thread) */
+static void run_aliens_tick(bench_state_t *state) {
+  aliens_tick(&state->game, &state->aliens_updates[0], 0, &state->rng);
+}
+
+/* The part of the tick done by the aliens thread without the game lock */
+static void run_aliens_move(bench_state_t *state) {
+  aliens_move(state->game.aliens, &state->aliens_updates[0], &state->rng);
+}
+
+/* The part of the tick done without the game lock, split between workers */
+static void run_aliens_pool_move(bench_state_t *state) {
+  aliens_pool_move(state->aliens_pool, state->game.aliens,
+                   &state->aliens_updates[0], &state->rng);
+}
+
+/* Applies a generation to the game, as a replayed tick does */
+static void run_aliens_commit(bench_state_t *state) {
+  aliens_commit(&state->game, &state->aliens_updates[state->iteration % 2], 0);
+}
+
+/* The part of the tick done holding the game lock */
+static void run_aliens_commit_kills(bench_state_t *state) {
+  aliens_commit_kills(&state->game, &state->next_game,
+                      &state->aliens_updates[state->iteration % 2],
+                      &state->kills, 0);
+}
+
+/* Applies the alien updates alternately, so every alien moves */
+static void run_handle_aliens_updates(bench_state_t *state) {
+  handle_aliens_updates(state->game_window,
+                        &state->aliens_updates[state->iteration % 2],
+                        &state->game);
+}
+
+static void run_copy_game_state(bench_state_t *state) {
+  copy_game_state_for_display(&state->display_response, &state->game);
+}
+
+/* Publishes a snapshot after a request that didn't change the aliens */
+static void run_snapshot_publish_players(bench_state_t *state) {
+  snapshot_publish(&state->snapshots, &state->game, state->tokens,
+                   state->client_ids, &state->rng, false, 0);
+}
+
+/* Publishes a snapshot after a tick */
+static void run_snapshot_publish_aliens(bench_state_t *state) {
+  snapshot_publish(&state->snapshots, &state->game, state->tokens,
+                   state->client_ids, &state->rng, true, 0);
+}
+
+/* What a request answered without the game lock does to read the game */
+static void run_snapshot_acquire(bench_state_t *state) {
+  snapshot_release(snapshot_acquire(&state->snapshots));
+}
+
+static void run_update_scoreboard(bench_state_t *state) {
+  nc_update_scoreboard(state->score_window, state->game.players,
+                       state->game.aliens_alive);
+}
+
+/* Gets the size of every message type with a fixed size */
+static void run_get_msg_size(bench_state_t *state) {
+  static volatile size_t total;
+
+  (void)state;
+  for (int type = 0; type < N_MESSAGE_TYPES; type++) {
+    if (type != SCORES_UPDATE)
+      total += get_msg_size((MESSAGE_TYPE)type);
+  }
+}
+
+/* Receives every message queued on the inproc socket */
+static void drain_socket(bench_state_t *state) {
+  zmq_msg_t msg;
+
+  zmq_msg_init(&msg);
+  while (zmq_msg_recv(&msg, state->pull_socket, ZMQ_DONTWAIT) != -1)
+    ;
+  zmq_msg_close(&msg);
+}
+
+/* Sends an alien update (the biggest message) as the aliens thread does */
+static void run_send_aliens_update(bench_state_t *state) {
+  zmq_send_msg(state->push_socket, ALIENS_UPDATE, &state->aliens_updates[0],
+               -1, GAME_UPDATES_TOPIC);
+}
+
+/* Writes an alien update to the shared memory channel and reads it back, as a
+ * local display does instead of receiving it */
+static void run_shm_aliens_update(bench_state_t *state) {
+  shm_update_t update;
+
+  shm_channel_write_update(state->shm, ALIENS_UPDATE,
+                           &state->aliens_updates[0], state->iteration);
+  shm_channel_read_update(state->shm_segment, state->iteration, &update,
+                          &state->shm_aliens_update);
+}
+
+/* Writes the game to the shared memory channel after a request */
+static void run_shm_write_game(bench_state_t *state) {
+  shm_channel_write_game(state->shm, &state->game, false, state->iteration);
+}
+
+/* Packs and sends the scores with protobuf */
+static void run_broadcast_scores(bench_state_t *state) {
+  zmq_broadcast_scores_updates(state->push_socket, &state->game);
+}
+
+/* Sends an action and waits for the reply, as an astronaut does */
+static void run_action_request(bench_state_t *state) {
+  action_request_t request = {0};
+  MESSAGE_TYPE msg_type;
+
+  request.action_type = MOVE;
+  request.movement_direction = state->iteration % 2 ? LEFT : RIGHT;
+  request.token = state->tokens[0];
+  request.sequence = (int)state->iteration;
+
+  zmq_send_msg(state->req_socket, ACTION_REQUEST, &request, -1, NO_TOPIC);
+  free(zmq_receive_msg(state->req_socket, &msg_type, NO_TOPIC));
+}
+
+static const benchmark_t benchmarks[] = {
+    {"player_zap", restore_game, run_player_zap, 1, true},
+    {"aliens_tick", NULL, run_aliens_tick, 0, true},
+    {"aliens_move", NULL, run_aliens_move, 0, true},
+    {"aliens_commit", NULL, run_aliens_commit, 0, true},
+    {"aliens_commit_kills", NULL, run_aliens_commit_kills, 0, false},
+    {"handle_aliens_updates", NULL, run_handle_aliens_updates, 0, true},
+    {"copy_game_state", NULL, run_copy_game_state, 0, true},
+    {"snapshot_publish", NULL, run_snapshot_publish_players, 0, false},
+    {"snapshot_publish+aliens", NULL, run_snapshot_publish_aliens, 0, true},
+    {"snapshot_acquire", NULL, run_snapshot_acquire, 0, false},
+    {"nc_update_scoreboard", NULL, run_update_scoreboard, 0, false},
+    {"get_msg_size", NULL, run_get_msg_size, 0, false},
+    {"zmq_send_msg (aliens)", drain_socket, run_send_aliens_update,
+     BENCH_MAX_QUEUED_MESSAGES, true},
+    {"shm_update (aliens)", NULL, run_shm_aliens_update, 0, true},
+    {"shm_write_game", NULL, run_shm_write_game, 0, false},
+    {"broadcast_scores", drain_socket, run_broadcast_scores,
+     BENCH_MAX_QUEUED_MESSAGES, false}};
+
+/******************** Setup ********************/
+
+/* Starts a game with every player connected and the given percentage of the
+ * aliens alive */
+static void init_state(int alive_percentage) {
+  int *tokens = state.tokens;
+  int aliens_alive = N_ALIENS * alive_percentage / 100;
+
+  game_rng_seed(&state.rng, 1);
+  init_game(&state.game, tokens, &state.rng);
+  for (int i = 0; i < MAX_PLAYERS; i++)
+    find_position_and_init_player(&state.game, tokens);
+
+  /* Kill the aliens spread over the array */
+  for (int i = 0; i < N_ALIENS; i++)
+    state.game.aliens[i].alive =
+        (int64_t)i * aliens_alive / N_ALIENS !=
+        (int64_t)(i + 1) * aliens_alive / N_ALIENS;
+  state.game.aliens_alive = aliens_alive;
+
+  aliens_tick(&state.game, &state.aliens_updates[0], 0, &state.rng);
+  aliens_tick(&state.game, &state.aliens_updates[1], 0, &state.rng);
+  memcpy(&state.initial_game, &state.game, sizeof(game_t));
+  snapshot_pool_init(&state.snapshots, &state.game, tokens, state.client_ids,
+                     &state.rng);
+}
+
+/* Returns the time taken by a sample of batch calls (in ns) */
+static uint64_t time_sample(const benchmark_t *benchmark, int batch) {
+  uint64_t start_ns;
+
+  if (benchmark->setup != NULL)
+    benchmark->setup(&state);
+
+  start_ns = get_monotonic_ns();
+  for (int i = 0; i < batch; i++) {
+    benchmark->run(&state);
+    state.iteration++;
+  }
+
+  return get_monotonic_ns() - start_ns;
+}
+
+/* Returns the number of calls per sample needed to last BENCH_MIN_SAMPLE_NS */
+static int calibrate_batch(const benchmark_t *benchmark) {
+  int batch = 1;
+
+  while ((benchmark->max_batch == 0 || batch < benchmark->max_batch) &&
+         time_sample(benchmark, batch) < BENCH_MIN_SAMPLE_NS)
+    batch *= 2;
+
+  if (benchmark->max_batch != 0 && batch > benchmark->max_batch)
+    batch = benchmark->max_batch;
+
+  return batch;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/******************** Measuring ********************/
+
+/* Measures a benchmark and prints its median, minimum and median absolute
+ * deviation per call (returns the median) */
+static double measure(const benchmark_t *benchmark, int alive_percentage,
+                      double clock_overhead_ns) {
+  double per_call[BENCH_SAMPLES], deviations[BENCH_SAMPLES];
+  double median, ns;
+  int batch = calibrate_batch(benchmark);
+
+  for (int i = 0; i < BENCH_WARMUP_SAMPLES; i++)
+    time_sample(benchmark, batch);
+
+  for (int i = 0; i < BENCH_SAMPLES; i++) {
+    ns = (double)time_sample(benchmark, batch) - clock_overhead_ns;
+    per_call[i] = (ns > 0 ? ns : 0) / batch;
+  }
+
+  qsort(per_call, BENCH_SAMPLES, sizeof(double), compare_doubles);
+  median = per_call[BENCH_SAMPLES / 2];
+
+  for (int i = 0; i < BENCH_SAMPLES; i++)
+    deviations[i] = per_call[i] > median ? per_call[i] - median
+                                         : median - per_call[i];
+  qsort(deviations, BENCH_SAMPLES, sizeof(double), compare_doubles);
+
+  printf("%-24s %6d%% %7d %12.1f %12.1f %7.1f%%\n", benchmark->name,
+         alive_percentage, batch, median, per_call[0],
+         median > 0 ? 100 * deviations[BENCH_SAMPLES / 2] / median : 0);
+
+  return median;
+}
+
+/* Checks that every zap stuns the same players as checking all of them would
+ * (the players on the column of a horizontal player, or on the row of a
+ * vertical one), after scattering them so the lanes are shared */
+static void check_player_zap() {
+  player_t *shooter, *player;
+  MOVEMENT_DIRECTION direction;
+  bool aligned;
+  int id;
+
+  init_state(100);
+  for (int i = 0; i < 4 * MAX_PLAYERS; i++) {
+    id = (int)(game_rng_next(&state.rng) % MAX_PLAYERS);
+    if (state.game.players[id].orientation == HORIZONTAL)
+      direction = game_rng_next(&state.rng) % 2 ? LEFT : RIGHT;
+    else
+      direction = game_rng_next(&state.rng) % 2 ? UP : DOWN;
+    player_move(&state.game, id, direction);
+  }
+  memcpy(&state.initial_game, &state.game, sizeof(game_t));
+
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    restore_game(&state);
+    player_zap(&state.game, i, 1, NULL);
+    shooter = &state.game.players[i];
+
+    for (int j = 0; j < MAX_PLAYERS; j++) {
+      player = &state.game.players[j];
+      aligned = shooter->orientation == HORIZONTAL
+                    ? player->position.col == shooter->position.col
+                    : player->position.row == shooter->position.row;
+      if ((j != i && aligned) != (player->last_stunned == 1)) {
+        printf("The zap of player %d doesn't stun the players on its lane.\n",
+               i);
+        exit(-1);
+      }
+    }
+  }
+}
+
+/* Measures aliens_pool_move with 1, 2, 4... workers (up to the cores or 4),
+ * checking that every pool moves the aliens as aliens_move does */
+static void measure_aliens_pool(double clock_overhead_ns) {
+  /* Static as it can be too big for the stack on large boards */
+  static aliens_update_t expected;
+  benchmark_t benchmark = {NULL, NULL, run_aliens_pool_move, 0, true};
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int max_workers = cores > 4 ? (int)cores : 4;
+  double single_ns = 0, speedups[MAX_ALIEN_WORKERS];
+  char name[32];
+  game_rng_t start_rng, rng;
+  int n = 0;
+
+  init_state(100);
+  /* The benchmarks advance state.rng */
+  start_rng = state.rng;
+  rng = start_rng;
+  /* Only the positions are moved, the rest is kept */
+  memcpy(&expected, &state.aliens_updates[0], sizeof(expected));
+  aliens_move(state.game.aliens, &expected, &rng);
+
+  for (int workers = 1; workers <= max_workers && workers <= MAX_ALIEN_WORKERS;
+       workers *= 2, n++) {
+    state.aliens_pool = aliens_pool_create(workers);
+
+    rng = start_rng;
+    aliens_pool_move(state.aliens_pool, state.game.aliens,
+                     &state.aliens_updates[0], &rng);
+    if (memcmp(&expected, &state.aliens_updates[0], sizeof(expected)) != 0) {
+      printf("aliens_pool_move with %d workers differs from aliens_move.\n",
+             workers);
+      exit(-1);
+    }
+
+    snprintf(name, sizeof(name), "aliens_pool_move/%d", workers);
+    benchmark.name = name;
+    speedups[n] = measure(&benchmark, 100, clock_overhead_ns);
+    if (workers == 1)
+      single_ns = speedups[n];
+    speedups[n] = speedups[n] > 0 ? single_ns / speedups[n] : 0;
+
+    aliens_pool_destroy(state.aliens_pool);
+  }
+
+  printf("%-24s", "Speedup (1, 2, 4...)");
+  for (int i = 0; i < n; i++)
+    printf(" %.2fx", speedups[i]);
+  printf(" on %ld cores\n", cores);
+}
+
+/* Answers the actions as the game-server does (moving the player and replying
+ * with its score) until a DISCONNECT_REQUEST */
+static void *action_server_main(void *rep_socket) {
+  action_request_t *request;
+  action_response_t response = {0};
+  MESSAGE_TYPE msg_type;
+  bool disconnected = false;
+
+  while (!disconnected) {
+    request =
+        (action_request_t *)zmq_receive_msg(rep_socket, &msg_type, NO_TOPIC);
+    disconnected = msg_type == DISCONNECT_REQUEST;
+
+    if (!disconnected) {
+      assert(msg_type == ACTION_REQUEST);
+      response.status_code =
+          request->token == state.tokens[request->id] ? 200 : 400;
+      if (response.status_code == 200)
+        player_move(&state.game, request->id, request->movement_direction);
+      response.player_score = state.game.players[request->id].score;
+    }
+
+    zmq_send_msg(rep_socket, disconnected ? DISCONNECT_RESPONSE
+                                          : ACTION_RESPONSE,
+                 &response, -1, NO_TOPIC);
+    free(request);
+  }
+
+  return NULL;
+}
+
+/* Measures the round trip of an action over tcp, ipc and inproc (the server
+ * is a thread of the benchmark in the three of them) */
+static void measure_action_rtt(void *context, double clock_overhead_ns) {
+  benchmark_t benchmark = {NULL, NULL, run_action_request, 0, false};
+  const char *transports[BENCH_RTT_TRANSPORTS] = {"tcp", "ipc", "inproc"};
+  char ipc_address[64];
+  char *addresses[BENCH_RTT_TRANSPORTS] = {
+      BENCH_RTT_TCP_ADDRESS, ipc_address, BENCH_RTT_INPROC_ADDRESS};
+  double medians[BENCH_RTT_TRANSPORTS];
+  disconnect_request_t disconnect_request = {0};
+  MESSAGE_TYPE msg_type;
+  pthread_t server_thread;
+  void *rep_socket;
+  char name[32];
+
+  snprintf(ipc_address, sizeof(ipc_address), BENCH_RTT_IPC_ADDRESS,
+           (int)getpid());
+
+  for (int i = 0; i < BENCH_RTT_TRANSPORTS; i++) {
+    init_state(100);
+    state.iteration = 0;
+
+    /* Bound before connecting, as inproc needs */
+    rep_socket = zmq_create_socket(context, ZMQ_REP);
+    zmq_bind_socket(rep_socket, addresses[i]);
+    state.req_socket = zmq_create_socket(context, ZMQ_REQ);
+    zmq_connect_socket(state.req_socket, addresses[i]);
+    pthread_create(&server_thread, NULL, action_server_main, rep_socket);
+    /* The connection is only made on the first request */
+    run_action_request(&state);
+
+    snprintf(name, sizeof(name), "action_rtt/%s", transports[i]);
+    benchmark.name = name;
+    medians[i] = measure(&benchmark, 100, clock_overhead_ns);
+
+    zmq_send_msg(state.req_socket, DISCONNECT_REQUEST, &disconnect_request,
+                 -1, NO_TOPIC);
+    free(zmq_receive_msg(state.req_socket, &msg_type, NO_TOPIC));
+    pthread_join(server_thread, NULL);
+    zmq_cleanup(NULL, state.req_socket, rep_socket);
+  }
+  unlink(ipc_address + strlen("ipc://"));
+
+  printf("%-24s", "Speedup over tcp");
+  for (int i = 1; i < BENCH_RTT_TRANSPORTS; i++)
+    printf(" %s %.2fx", transports[i],
+           medians[i] > 0 ? medians[0] / medians[i] : 0);
+  printf("\n");
+}
+
+/* Returns the time taken to read the clock twice (subtracted from samples) */
+static double measure_clock_overhead() {
+  uint64_t start_ns, total_ns = 0;
+
+  for (int i = 0; i < 1000; i++) {
+    start_ns = get_monotonic_ns();
+    total_ns += get_monotonic_ns() - start_ns;
+  }
+
+  return total_ns / 1000.0;
+}
+
+/******************** Main ********************/
+
+/* Runs every benchmark whose name contains the argument (all if none) */
+int main(int argc, char *argv[]) {
+  const int alive_percentages[] = BENCH_ALIVE_PERCENTAGES;
+  const char *filter = argc > 1 ? argv[1] : NULL;
+  void *context = zmq_get_context();
+  char shm_name[64];
+  double clock_overhead_ns;
+
+  /* Draw on the null backend, but with a viewport as a terminal would have */
+  setenv(RENDER_BACKEND_ENV, "null", 1);
+  nc_init();
+  state.game_window = nc_init_space(0);
+  state.score_window = nc_init_scoreboard();
+  nc_viewport.height =
+      SPACE_SIZE < BENCH_VIEWPORT_SIZE ? SPACE_SIZE : BENCH_VIEWPORT_SIZE;
+  nc_viewport.width = nc_viewport.height;
+
+  state.push_socket = zmq_create_socket(context, ZMQ_PUSH);
+  state.pull_socket = zmq_create_socket(context, ZMQ_PULL);
+  zmq_bind_socket(state.pull_socket, BENCH_INPROC_ADDRESS);
+  zmq_connect_socket(state.push_socket, BENCH_INPROC_ADDRESS);
+
+  snprintf(shm_name, sizeof(shm_name), "/space-bench-%d", (int)getpid());
+  state.shm = shm_channel_create(shm_name, &state.game);
+  state.shm_segment = shm_channel_map(shm_name);
+  assert(state.shm_segment != NULL);
+
+  clock_overhead_ns = measure_clock_overhead();
+
+  printf("SPACE_SIZE=%d N_ALIENS=%d (%d samples, ns per call)\n", SPACE_SIZE,
+         N_ALIENS, BENCH_SAMPLES);
+  /* What every snapshot, aliens update and display connection carries */
+  printf("Bytes: game %zu, player %zu, alien %zu, aliens update %zu, display "
+         "connect %zu\n\n",
+         sizeof(game_t), sizeof(player_t), sizeof(alien_t),
+         sizeof(aliens_update_t), sizeof(display_connect_response_t));
+  printf("%-24s %7s %7s %12s %12s %8s\n", "Benchmark", "alive", "batch",
+         "median", "min", "mad");
+
+  if (filter == NULL || strstr("player_zap", filter) != NULL)
+    check_player_zap();
+
+  for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+    if (filter != NULL && strstr(benchmarks[i].name, filter) == NULL)
+      continue;
+
+    for (size_t j = 0; j < sizeof(alive_percentages) / sizeof(int); j++) {
+      init_state(alive_percentages[j]);
+      state.iteration = 0;
+      measure(&benchmarks[i], alive_percentages[j], clock_overhead_ns);
+
+      if (!benchmarks[i].uses_aliens)
+        break;
+    }
+  }
+
+  if (filter == NULL || strstr("aliens_pool_move", filter) != NULL)
+    measure_aliens_pool(clock_overhead_ns);
+
+  if (filter == NULL || strstr("action_rtt", filter) != NULL)
+    measure_action_rtt(context, clock_overhead_ns);
+
+  nc_cleanup();
+  zmq_cleanup(context, state.push_socket, state.pull_socket);
+  shm_channel_unmap(state.shm_segment);
+  shm_channel_destroy(state.shm);
+
+  return 0;
+}
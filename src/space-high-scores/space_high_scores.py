@@ -7,11 +7,18 @@ from scores_pb2 import ScoresMessage  # type: ignore
 
 
 COMMS_H_FILE_PATH = "include/comms.h"
+# Same as SERVER_PUBSUB_ENV in include/comms.h
+SERVER_PUBSUB_ENV = "SPACE_SERVER_PUBSUB"
 SCORES_UPDATE_TOPIC = 2  # From PUBSUB_TOPICS enum in include/comms.h
+# From include/game_def.h
+PLAYER_SYMBOLS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"
 
 
 def extract_server_info() -> str:
-    """Extracts server info from comms.h"""
+    """Gets the server address from SERVER_PUBSUB_ENV or, if not set, comms.h"""
+
+    if os.environ.get(SERVER_PUBSUB_ENV):
+        return os.environ[SERVER_PUBSUB_ENV]
 
     definitions = {"PROTOCOL": None, "SERVER_IP": None, "PORT_PUBSUB": None}
 
@@ -37,8 +44,11 @@ def extract_server_info() -> str:
 def display_scoreboard(scores: list):
     """Displays the scoreboard"""
 
-    # Convert user id to the respective letter
-    id_to_symbol = lambda id: chr(ord("A") + id)
+    # Convert user id to the respective label (same as id_to_label in
+    # src/common/utils.c)
+    id_to_symbol = lambda id: PLAYER_SYMBOLS[id % len(PLAYER_SYMBOLS)] + (
+        str(id // len(PLAYER_SYMBOLS)) if id >= len(PLAYER_SYMBOLS) else ""
+    )
 
     scores_with_symbols = [
         {"symbol": id_to_symbol(index), "score": score}
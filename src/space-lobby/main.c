@@ -0,0 +1,387 @@
+/* Places the astronauts on the least loaded of the game-servers that report
+ * to it (the shards), so more players fit by starting more servers (see
+ * include/lobby.h) */
+
+#include "comms.h"
+#include "lobby.h"
+#include "utils.h"
+#include "zeromq_wrapper.h"
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zmq.h>
+
+/* Time between the status lines (ms) */
+#define LOBBY_REPORT_MS 5000
+
+typedef struct {
+  /* Last status reported by the shard */
+  shard_status_t status;
+  /* When it arrived (monotonic ns) */
+  uint64_t reported_ns;
+  /* Astronauts placed since then (not counted in it yet) */
+  int placed;
+  /* Forwards the connect requests to the shard */
+  void *req_socket;
+  /* Didn't answer a request, so it isn't tried until it reports again */
+  bool down;
+} shard_t;
+
+typedef struct {
+  void *zmq_context;
+  /* Receives the connect requests of the astronauts */
+  void *rep_socket;
+  /* Receives the status of the shards */
+  void *pull_socket;
+  shard_t shards[LOBBY_MAX_SHARDS];
+  int n_shards;
+  /* Since the last status line */
+  uint64_t placed;
+  uint64_t rejected;
+} lobby_t;
+
+/* Forgets a shard (the last one takes its place) */
+static void lobby_remove_shard(lobby_t *lobby, int index, const char *reason) {
+  shard_t *shard = &lobby->shards[index];
+
+  printf("Shard %s %s.\n", shard->status.reqrep_address, reason);
+  fflush(stdout);
+
+  /* A forwarded request still waiting for its reply is dropped (see
+   * lobby_connect_shard) */
+  zmq_cleanup(NULL, shard->req_socket, NULL);
+  lobby->shards[index] = lobby->shards[--lobby->n_shards];
+}
+
+/* Returns true if an address reported by a shard can be connected to (it must
+ * end within its field and name its transport, e.g. tcp:// or ipc://) */
+static bool lobby_valid_address(const char *address) {
+  const char *separator;
+
+  if (strnlen(address, ADDRESS_SIZE) == ADDRESS_SIZE)
+    return false;
+
+  separator = strstr(address, "://");
+  return separator != NULL && separator != address && separator[3] != '\0';
+}
+
+/* Creates the socket that forwards the requests to a shard, returning NULL if
+ * its address can't be connected to */
+static void *lobby_connect_shard(lobby_t *lobby, char *address) {
+  void *req_socket = zmq_create_socket(lobby->zmq_context, ZMQ_REQ);
+  int linger = 0;
+
+  /* A request forwarded is dropped with the socket */
+  assert(zmq_setsockopt(req_socket, ZMQ_LINGER, &linger, sizeof(int)) == 0);
+  if (zmq_connect(req_socket, address) != 0) {
+    printf("Shard %s ignored (%s).\n", address, zmq_strerror(errno));
+    fflush(stdout);
+    zmq_cleanup(NULL, req_socket, NULL);
+    return NULL;
+  }
+
+  return req_socket;
+}
+
+/* Updates the status of a shard, adding it the first time it reports */
+static void lobby_shard_status(lobby_t *lobby) {
+  MESSAGE_TYPE msg_type;
+  shard_status_t *status = (shard_status_t *)zmq_receive_msg(
+      lobby->pull_socket, &msg_type, NO_TOPIC);
+  shard_t *shard = NULL;
+  void *req_socket;
+
+  assert(msg_type == SHARD_STATUS);
+  /* The addresses are copied as they are, so they are checked first */
+  if (!lobby_valid_address(status->reqrep_address) ||
+      !lobby_valid_address(status->pubsub_address)) {
+    printf("Shard status ignored (invalid address).\n");
+    fflush(stdout);
+    free(status);
+    return;
+  }
+
+  for (int i = 0; i < lobby->n_shards && shard == NULL; i++) {
+    if (strcmp(lobby->shards[i].status.reqrep_address,
+               status->reqrep_address) == 0)
+      shard = &lobby->shards[i];
+  }
+
+  if (shard == NULL) {
+    if (lobby->n_shards == LOBBY_MAX_SHARDS) {
+      printf("Shard %s ignored (already %d shards).\n",
+             status->reqrep_address, LOBBY_MAX_SHARDS);
+      free(status);
+      return;
+    }
+
+    req_socket = lobby_connect_shard(lobby, status->reqrep_address);
+    if (req_socket == NULL) {
+      free(status);
+      return;
+    }
+
+    shard = &lobby->shards[lobby->n_shards++];
+    shard->req_socket = req_socket;
+    printf("Shard %s joined.\n", status->reqrep_address);
+    fflush(stdout);
+  }
+
+  memcpy(&shard->status, status, sizeof(shard_status_t));
+  shard->reported_ns = get_monotonic_ns();
+  shard->placed = 0;
+  shard->down = false;
+  free(status);
+}
+
+/* Forgets the shards that stopped reporting (e.g. their match ended) */
+static void lobby_expire_shards(lobby_t *lobby, uint64_t now_ns) {
+  for (int i = lobby->n_shards - 1; i >= 0; i--) {
+    if (now_ns - lobby->shards[i].reported_ns >
+        LOBBY_SHARD_TIMEOUT_MS * 1000000ULL)
+      lobby_remove_shard(lobby, i, "stopped reporting");
+  }
+}
+
+/* Returns the shard with free slots and the fewest players for its slots
+ * (then the most free slots) that wasn't tried yet and isn't down. The ones
+ * without free slots are only tried after the rest, as players may have left
+ * since they reported. Returns -1 if every shard was tried */
+static int lobby_least_loaded(lobby_t *lobby, const bool *tried) {
+  const shard_status_t *status;
+  int best = -1, full = -1, players, free_slots, best_players = 0,
+      best_free_slots = 0;
+  int64_t load, best_load;
+
+  for (int i = 0; i < lobby->n_shards; i++) {
+    status = &lobby->shards[i].status;
+    players = status->players + lobby->shards[i].placed;
+    free_slots = status->free_slots - lobby->shards[i].placed;
+    if (tried[i] || lobby->shards[i].down)
+      continue;
+    if (free_slots <= 0) {
+      full = full == -1 ? i : full;
+      continue;
+    }
+
+    /* players / slots compared to the best one without dividing */
+    load = (int64_t)players * (best_players + best_free_slots);
+    best_load = (int64_t)best_players * (players + free_slots);
+    if (best == -1 || load < best_load ||
+        (load == best_load && free_slots > best_free_slots)) {
+      best = i;
+      best_players = players;
+      best_free_slots = free_slots;
+    }
+  }
+
+  return best != -1 ? best : full;
+}
+
+/* Forwards a connect request to a shard, waiting LOBBY_SHARD_REQUEST_MS for its
+ * reply, as the lobby answers every astronaut on the same thread. Returns NULL
+ * (and marks the shard down until it reports again) if it doesn't reply in
+ * time */
+static void *lobby_shard_request(lobby_t *lobby, shard_t *shard,
+                                 astronaut_connect_request_t *request,
+                                 MESSAGE_TYPE *reply_type) {
+  zmq_pollitem_t poll_item = {shard->req_socket, 0, ZMQ_POLLIN, 0};
+  void *req_socket;
+
+  zmq_send_msg(shard->req_socket, ASTRONAUT_CONNECT_REQUEST, request, -1,
+               NO_TOPIC);
+  assert(zmq_poll(&poll_item, 1, LOBBY_SHARD_REQUEST_MS) != -1);
+  if (poll_item.revents & ZMQ_POLLIN)
+    return zmq_receive_msg(shard->req_socket, reply_type, NO_TOPIC);
+
+  /* A REQ socket can't send again before the reply, so the next request goes
+   * on a new one (the address was already connected to once) */
+  printf("Shard %s doesn't answer.\n", shard->status.reqrep_address);
+  fflush(stdout);
+  zmq_cleanup(NULL, shard->req_socket, NULL);
+  req_socket = lobby_connect_shard(lobby, shard->status.reqrep_address);
+  assert(req_socket != NULL);
+  shard->req_socket = req_socket;
+  shard->down = true;
+  return NULL;
+}
+
+/* Forwards a connect request to the least loaded shard (the next one if it is
+ * full, busy or doesn't answer), answering with its response and addresses.
+ * The astronaut is told the servers are busy (429) if one of them was */
+static void lobby_place_astronaut(lobby_t *lobby,
+                                  astronaut_connect_request_t *request) {
+  astronaut_connect_response_t rejected_response = {400, -1, 0, -1, "", ""};
+  astronaut_connect_response_t *response = NULL;
+  bool tried[LOBBY_MAX_SHARDS] = {false}, busy = false;
+  MESSAGE_TYPE reply_type;
+  shard_t *shard;
+  int index;
+
+  while (response == NULL &&
+         (index = lobby_least_loaded(lobby, tried)) != -1) {
+    shard = &lobby->shards[index];
+    response = (astronaut_connect_response_t *)lobby_shard_request(
+        lobby, shard, request, &reply_type);
+
+    /* Down if it didn't answer, so it isn't returned again */
+    if (response == NULL)
+      continue;
+
+    if (response->status_code != 200) {
+      /* Full until it reports again, unless it only shed the request (see
+       * include/admission.h) */
+      busy = busy || response->status_code == 429;
+      if (response->status_code != 429)
+        shard->status.free_slots = shard->placed;
+      tried[index] = true;
+      free(response);
+      response = NULL;
+    } else {
+      memcpy(response->reqrep_address, shard->status.reqrep_address,
+             ADDRESS_SIZE);
+      memcpy(response->pubsub_address, shard->status.pubsub_address,
+             ADDRESS_SIZE);
+      shard->placed++;
+    }
+  }
+
+  if (response != NULL) {
+    zmq_send_msg(lobby->rep_socket, ASTROUNAUT_CONNECT_RESPONSE, response, -1,
+                 NO_TOPIC);
+    lobby->placed++;
+    free(response);
+  } else {
+    rejected_response.status_code = busy ? 429 : 400;
+    zmq_send_msg(lobby->rep_socket, ASTROUNAUT_CONNECT_RESPONSE,
+                 &rejected_response, -1, NO_TOPIC);
+    lobby->rejected++;
+  }
+}
+
+/* Answers a request of an astronaut (only the connect requests are for the
+ * lobby, the rest are rejected as they must go to the shards) */
+static void lobby_request(lobby_t *lobby) {
+  MESSAGE_TYPE msg_type;
+  void *request = zmq_receive_msg(lobby->rep_socket, &msg_type, NO_TOPIC);
+  action_response_t action_response = {400, 0, 0, 0};
+  status_code_and_score_response_t status_code_and_score_response = {400, 0};
+  /* Static as it can be too big for the stack on large boards */
+  static display_connect_response_t display_connect_response;
+
+  switch (msg_type) {
+  case ASTRONAUT_CONNECT_REQUEST:
+    lobby_place_astronaut(lobby, (astronaut_connect_request_t *)request);
+    break;
+
+  case DISPLAY_CONNECT_REQUEST:
+    /* The displays must connect to a shard */
+    display_connect_response.status_code = 400;
+    zmq_send_msg(lobby->rep_socket, DISPLAY_CONNECT_RESPONSE,
+                 &display_connect_response, -1, NO_TOPIC);
+    break;
+
+  case ACTION_REQUEST:
+    zmq_send_msg(lobby->rep_socket, ACTION_RESPONSE, &action_response, -1,
+                 NO_TOPIC);
+    break;
+
+  case DISCONNECT_REQUEST:
+  default:
+    zmq_send_msg(lobby->rep_socket, DISCONNECT_RESPONSE,
+                 &status_code_and_score_response, -1, NO_TOPIC);
+    break;
+  }
+
+  if (request != NULL)
+    free(request);
+}
+
+/* Prints a status line with the shards and the counters since the last one */
+static void lobby_report(lobby_t *lobby) {
+  int players = 0, free_slots = 0;
+
+  for (int i = 0; i < lobby->n_shards; i++) {
+    players += lobby->shards[i].status.players + lobby->shards[i].placed;
+    free_slots += lobby->shards[i].status.free_slots - lobby->shards[i].placed;
+  }
+
+  printf("%d shards, %d players, %d free slots, placed %lu, rejected %lu\n",
+         lobby->n_shards, players, free_slots, (unsigned long)lobby->placed,
+         (unsigned long)lobby->rejected);
+  fflush(stdout);
+
+  lobby->placed = 0;
+  lobby->rejected = 0;
+}
+
+/* Prints the usage and exits */
+static void usage(const char *program) {
+  printf("Usage: %s [-r address] [-s address]\n\n"
+         "  -r  REQREP address bound for the astronauts (default: %s)\n"
+         "  -s  PULL address bound for the shards (default: %s)\n",
+         program, LOBBY_REQREP_BIND_ADDRESS, LOBBY_SHARDS_BIND_ADDRESS);
+  exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+  /* Static as the shards are kept in it */
+  static lobby_t lobby;
+  char *reqrep_bind_address = LOBBY_REQREP_BIND_ADDRESS;
+  char *shards_bind_address = LOBBY_SHARDS_BIND_ADDRESS;
+  zmq_pollitem_t poll_items[2];
+  uint64_t last_report_ns, now_ns;
+  int option;
+
+  while ((option = getopt(argc, argv, "r:s:h")) != -1) {
+    switch (option) {
+    case 'r':
+      reqrep_bind_address = optarg;
+      break;
+    case 's':
+      shards_bind_address = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc)
+    usage(argv[0]);
+
+  /* ZeroMQ initialization */
+  lobby.zmq_context = zmq_get_context();
+  lobby.rep_socket = zmq_create_socket(lobby.zmq_context, ZMQ_REP);
+  lobby.pull_socket = zmq_create_socket(lobby.zmq_context, ZMQ_PULL);
+  zmq_bind_socket(lobby.rep_socket, reqrep_bind_address);
+  zmq_bind_socket(lobby.pull_socket, shards_bind_address);
+
+  printf("Placing the astronauts of %s on the shards of %s\n",
+         reqrep_bind_address, shards_bind_address);
+  fflush(stdout);
+
+  poll_items[0] = (zmq_pollitem_t){lobby.pull_socket, 0, ZMQ_POLLIN, 0};
+  poll_items[1] = (zmq_pollitem_t){lobby.rep_socket, 0, ZMQ_POLLIN, 0};
+  last_report_ns = get_monotonic_ns();
+
+  /* Stops with Ctrl+C, like space-stats */
+  while (true) {
+    assert(zmq_poll(poll_items, 2, LOBBY_SHARD_TIMEOUT_MS) != -1);
+
+    /* The status first, so the placement uses the latest one */
+    if (poll_items[0].revents & ZMQ_POLLIN)
+      lobby_shard_status(&lobby);
+    now_ns = get_monotonic_ns();
+    lobby_expire_shards(&lobby, now_ns);
+    if (poll_items[1].revents & ZMQ_POLLIN)
+      lobby_request(&lobby);
+
+    if (now_ns - last_report_ns >= LOBBY_REPORT_MS * 1000000ULL) {
+      lobby_report(&lobby);
+      last_report_ns = now_ns;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,365 @@
+/* Relays the game updates of the game-server (or of another relay) to the
+ * displays: subscribes once upstream, keeps a mirror of the game with the
+ * updates it forwards and answers the displays connecting with it, so the
+ * spectators don't cost the game-server anything */
+
+#include "admission.h"
+#include "comms.h"
+#include "utils.h"
+#include "zeromq_wrapper.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zmq.h>
+
+/* Default addresses where the displays connect to the relay */
+#define RELAY_REQREP_BIND_ADDRESS PROTOCOL "://*:62764"
+#define RELAY_PUBSUB_BIND_ADDRESS PROTOCOL "://*:62765"
+
+/* Time between the status lines (ms) */
+#define RELAY_REPORT_MS 5000
+
+/* Parts of a published message (topic, update header, type and contents) */
+#define RELAY_MAX_FRAMES 4
+
+typedef struct {
+  void *zmq_context;
+  /* Upstream (the game-server or another relay) */
+  void *req_socket;
+  char *upstream_reqrep_address;
+  void *xsub_socket;
+  /* Downstream (the displays) */
+  void *rep_socket;
+  void *xpub_socket;
+  /* Mirror of the upstream game, sent as it is to the displays (its
+   * next_sequence is the sequence of the next update to apply) */
+  display_connect_response_t *mirror;
+  /* Since the last status line */
+  uint64_t forwarded;
+  uint64_t displays;
+  uint64_t resyncs;
+} relay_t;
+
+/* Subscribes the XSUB socket to a topic (XSUB sockets subscribe by sending the
+ * subscription as a message) */
+static void xsub_subscribe(void *xsub_socket, PUBSUB_TOPICS topic) {
+  unsigned char subscription[1 + sizeof(PUBSUB_TOPICS)];
+
+  subscription[0] = 1;
+  memcpy(&subscription[1], &topic, sizeof(PUBSUB_TOPICS));
+  assert(zmq_send(xsub_socket, subscription, sizeof(subscription), 0) != -1);
+}
+
+/* Replaces the mirror with the game state of the upstream (again after a
+ * while if it is busy, exits if it doesn't answer) */
+static void mirror_sync(relay_t *relay) {
+  MESSAGE_TYPE reply_type;
+  display_connect_response_t *response;
+
+  while (true) {
+    response = (display_connect_response_t *)zmq_request(
+        &relay->req_socket, relay->zmq_context, relay->upstream_reqrep_address,
+        DISPLAY_CONNECT_REQUEST, NULL, &reply_type);
+    if (response == NULL || response->status_code != 429)
+      break;
+    free(response);
+    usleep(ADMISSION_RETRY_MS * 1000);
+  }
+
+  if (response == NULL || response->status_code != 200) {
+    printf("The upstream at %s doesn't answer.\n",
+           relay->upstream_reqrep_address);
+    exit(-1);
+  }
+
+  memcpy(relay->mirror, response, sizeof(display_connect_response_t));
+  free(response);
+}
+
+/* Applies a game update to the mirror (the same way the displays do, without
+ * drawing) */
+static void mirror_apply(game_t *game, MESSAGE_TYPE msg_type, void *msg) {
+  action_request_t *action_request;
+  aliens_update_t *aliens_update;
+
+  switch (msg_type) {
+  case ASTRONAUT_CONNECT_REQUEST:
+    /* NULL because the relay doesn't manage tokens */
+    assert(find_position_and_init_player(game, NULL) != -1);
+    break;
+
+  case ACTION_REQUEST:
+    action_request = (action_request_t *)msg;
+    if (action_request->action_type == MOVE)
+      player_move(game, action_request->id,
+                  action_request->movement_direction);
+    else if (action_request->action_type == ZAP)
+      player_zap(game, action_request->id, game_clock_now_ms(), NULL);
+    break;
+
+  case DISCONNECT_REQUEST:
+    player_leave(game, ((disconnect_request_t *)msg)->id);
+    break;
+
+  case ALIENS_UPDATE:
+    aliens_update = (aliens_update_t *)msg;
+    memcpy(game->aliens, aliens_update->aliens, sizeof(game->aliens));
+    game->aliens_alive = 0;
+    for (int i = 0; i < N_ALIENS; i++)
+      game->aliens_alive += game->aliens[i].alive;
+    break;
+
+  case ROUND_STARTED:
+    memcpy(game, &((display_connect_response_t *)msg)->game, sizeof(game_t));
+    break;
+
+  default:
+    break;
+  }
+}
+
+/* Forwards a message of the upstream to the displays, applying it to the
+ * mirror first if it is a game update. Returns true if the game ended */
+static bool relay_upstream_message(relay_t *relay) {
+  zmq_msg_t frames[RELAY_MAX_FRAMES];
+  int n_frames = 0, more;
+  PUBSUB_TOPICS topic;
+  update_header_t header;
+  MESSAGE_TYPE msg_type = N_MESSAGE_TYPES;
+  size_t msg_size;
+  bool missed = false;
+  /* zmq doesn't align the data of the frames for the game structures, so the
+   * contents are copied here first (static as it can be too big for the
+   * stack) */
+  static union {
+    action_request_t action_request;
+    disconnect_request_t disconnect_request;
+    aliens_update_t aliens_update;
+    display_connect_response_t round_started;
+  } msg;
+
+  do {
+    assert(n_frames < RELAY_MAX_FRAMES);
+    zmq_msg_init(&frames[n_frames]);
+    assert(zmq_msg_recv(&frames[n_frames], relay->xsub_socket, 0) != -1);
+    more = zmq_msg_more(&frames[n_frames]);
+    n_frames++;
+  } while (more);
+
+  memcpy(&topic, zmq_msg_data(&frames[0]), sizeof(PUBSUB_TOPICS));
+
+  if (topic == GAME_UPDATES_TOPIC && n_frames >= 3) {
+    memcpy(&header, zmq_msg_data(&frames[1]), sizeof(update_header_t));
+    memcpy(&msg_type, zmq_msg_data(&frames[2]), sizeof(MESSAGE_TYPE));
+
+    /* The updates before next_sequence are already in the mirror (unless the
+     * upstream restarted, which starts the sequences over) */
+    if (header.epoch != relay->mirror->epoch ||
+        header.sequence > relay->mirror->next_sequence) {
+      missed = true;
+    } else if (header.sequence == relay->mirror->next_sequence) {
+      msg_size = get_msg_size(msg_type);
+      if (msg_size > 0) {
+        assert(n_frames == 4 && zmq_msg_size(&frames[3]) == msg_size &&
+               msg_size <= sizeof(msg));
+        memcpy(&msg, zmq_msg_data(&frames[3]), msg_size);
+      }
+      mirror_apply(&relay->mirror->game, msg_type, &msg);
+      relay->mirror->next_sequence++;
+    }
+  }
+
+  /* The update header is kept, so the displays see the upstream sequences */
+  for (int i = 0; i < n_frames; i++)
+    assert(zmq_msg_send(&frames[i], relay->xpub_socket,
+                        i < n_frames - 1 ? ZMQ_SNDMORE : 0) != -1);
+  relay->forwarded++;
+
+  /* An update was lost (e.g. before the subscription reached the upstream)
+   * or the upstream restarted, so the mirror is replaced by a state that
+   * already has it (the displays that see the new epoch ask for it after) */
+  if (missed) {
+    mirror_sync(relay);
+    relay->resyncs++;
+  }
+
+  return msg_type == GAME_ENDED;
+}
+
+/* Forwards the subscriptions of the displays to the upstream (except to the
+ * game updates, which the relay is always subscribed to) */
+static void relay_subscription(relay_t *relay) {
+  zmq_msg_t subscription;
+  PUBSUB_TOPICS topic = GAME_UPDATES_TOPIC;
+
+  zmq_msg_init(&subscription);
+  assert(zmq_msg_recv(&subscription, relay->xpub_socket, 0) != -1);
+
+  if (zmq_msg_size(&subscription) == 1 + sizeof(PUBSUB_TOPICS) &&
+      memcmp((char *)zmq_msg_data(&subscription) + 1, &topic,
+             sizeof(PUBSUB_TOPICS)) == 0)
+    zmq_msg_close(&subscription);
+  else
+    assert(zmq_msg_send(&subscription, relay->xsub_socket, 0) != -1);
+}
+
+/* Answers a request of a display with the mirror (the astronauts must connect
+ * to the game-server, so their requests are rejected) */
+static void relay_request(relay_t *relay) {
+  MESSAGE_TYPE msg_type;
+  void *request = zmq_receive_msg(relay->rep_socket, &msg_type, NO_TOPIC);
+  astronaut_connect_response_t astronaut_connect_response = {400, -1, 0, -1,
+                                                             "", ""};
+  action_response_t action_response = {400, 0, 0, 0};
+  status_code_and_score_response_t status_code_and_score_response = {400, 0};
+
+  switch (msg_type) {
+  case DISPLAY_CONNECT_REQUEST:
+    relay->mirror->status_code = 200;
+    zmq_send_msg(relay->rep_socket, DISPLAY_CONNECT_RESPONSE, relay->mirror,
+                 -1, NO_TOPIC);
+    relay->displays++;
+    break;
+
+  case ASTRONAUT_CONNECT_REQUEST:
+    zmq_send_msg(relay->rep_socket, ASTROUNAUT_CONNECT_RESPONSE,
+                 &astronaut_connect_response, -1, NO_TOPIC);
+    break;
+
+  case ACTION_REQUEST:
+    zmq_send_msg(relay->rep_socket, ACTION_RESPONSE, &action_response, -1,
+                 NO_TOPIC);
+    break;
+
+  case DISCONNECT_REQUEST:
+    zmq_send_msg(relay->rep_socket, DISCONNECT_RESPONSE,
+                 &status_code_and_score_response, -1, NO_TOPIC);
+    break;
+
+  default:
+    break;
+  }
+
+  if (request != NULL)
+    free(request);
+}
+
+/* Prints a status line with the counters since the last one */
+static void relay_report(relay_t *relay, uint64_t elapsed_ns) {
+  printf("Forwarded %.1f msg/s, %lu displays connected, %lu resyncs, next "
+         "sequence %lu\n",
+         relay->forwarded * 1e9 / elapsed_ns, (unsigned long)relay->displays,
+         (unsigned long)relay->resyncs,
+         (unsigned long)relay->mirror->next_sequence);
+  fflush(stdout);
+
+  relay->forwarded = 0;
+  relay->displays = 0;
+  relay->resyncs = 0;
+}
+
+/* Prints the usage and exits */
+static void usage(const char *program) {
+  printf("Usage: %s [-u address] [-s address] [-r address] [-p address]\n\n"
+         "  -u  REQREP address of the upstream (default: %s, %s or %s)\n"
+         "  -s  PUBSUB address of the upstream (default: %s, %s or %s)\n"
+         "  -r  REQREP address bound for the displays (default: %s)\n"
+         "  -p  PUBSUB address bound for the displays (default: %s)\n",
+         program, DISPLAY_REQREP_ENV, SERVER_REQREP_ENV,
+         SERVER_ZMQ_REQREP_ADDRESS, DISPLAY_PUBSUB_ENV, SERVER_PUBSUB_ENV,
+         SERVER_ZMQ_PUBSUB_ADDRESS,
+         RELAY_REQREP_BIND_ADDRESS, RELAY_PUBSUB_BIND_ADDRESS);
+  exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+  relay_t relay = {0};
+  /* Static as it can be too big for the stack on large boards */
+  static display_connect_response_t mirror;
+  char *upstream_pubsub_address =
+      zmq_address_from_env(DISPLAY_PUBSUB_ENV, zmq_server_pubsub_address());
+  char *reqrep_bind_address = RELAY_REQREP_BIND_ADDRESS;
+  char *pubsub_bind_address = RELAY_PUBSUB_BIND_ADDRESS;
+  zmq_pollitem_t poll_items[3];
+  bool game_ended = false;
+  uint64_t last_report_ns, now_ns;
+  int option;
+
+  relay.upstream_reqrep_address =
+      zmq_address_from_env(DISPLAY_REQREP_ENV, zmq_server_reqrep_address());
+  while ((option = getopt(argc, argv, "u:s:r:p:h")) != -1) {
+    switch (option) {
+    case 'u':
+      relay.upstream_reqrep_address = optarg;
+      break;
+    case 's':
+      upstream_pubsub_address = optarg;
+      break;
+    case 'r':
+      reqrep_bind_address = optarg;
+      break;
+    case 'p':
+      pubsub_bind_address = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc)
+    usage(argv[0]);
+
+  game_clock_init();
+
+  /* ZeroMQ initialization */
+  relay.zmq_context = zmq_get_context();
+  relay.req_socket = zmq_create_socket(relay.zmq_context, ZMQ_REQ);
+  relay.xsub_socket = zmq_create_socket(relay.zmq_context, ZMQ_XSUB);
+  relay.rep_socket = zmq_create_socket(relay.zmq_context, ZMQ_REP);
+  relay.xpub_socket = zmq_create_socket(relay.zmq_context, ZMQ_XPUB);
+  relay.mirror = &mirror;
+
+  zmq_connect_socket(relay.req_socket, relay.upstream_reqrep_address);
+  zmq_connect_socket(relay.xsub_socket, upstream_pubsub_address);
+  xsub_subscribe(relay.xsub_socket, GAME_UPDATES_TOPIC);
+  zmq_bind_socket(relay.rep_socket, reqrep_bind_address);
+  zmq_bind_socket(relay.xpub_socket, pubsub_bind_address);
+
+  /* Subscribed first, so the updates after the state received arrive */
+  mirror_sync(&relay);
+  printf("Relaying %s and %s on %s and %s\n", relay.upstream_reqrep_address,
+         upstream_pubsub_address, reqrep_bind_address, pubsub_bind_address);
+  fflush(stdout);
+
+  poll_items[0] = (zmq_pollitem_t){relay.xsub_socket, 0, ZMQ_POLLIN, 0};
+  poll_items[1] = (zmq_pollitem_t){relay.xpub_socket, 0, ZMQ_POLLIN, 0};
+  poll_items[2] = (zmq_pollitem_t){relay.rep_socket, 0, ZMQ_POLLIN, 0};
+  last_report_ns = get_monotonic_ns();
+
+  while (!game_ended) {
+    assert(zmq_poll(poll_items, 3, RELAY_REPORT_MS) != -1);
+    game_clock_refresh();
+
+    if (poll_items[0].revents & ZMQ_POLLIN)
+      game_ended = relay_upstream_message(&relay);
+    if (poll_items[1].revents & ZMQ_POLLIN)
+      relay_subscription(&relay);
+    if (poll_items[2].revents & ZMQ_POLLIN)
+      relay_request(&relay);
+
+    now_ns = get_monotonic_ns();
+    if (now_ns - last_report_ns >= RELAY_REPORT_MS * 1000000ULL) {
+      relay_report(&relay, now_ns - last_report_ns);
+      last_report_ns = now_ns;
+    }
+  }
+
+  printf("The game ended.\n");
+
+  /* Resources cleanup (waits for GAME_ENDED to reach the displays) */
+  zmq_cleanup(NULL, relay.req_socket, relay.xsub_socket);
+  zmq_cleanup(relay.zmq_context, relay.rep_socket, relay.xpub_socket);
+
+  return 0;
+}
@@ -0,0 +1,206 @@
+/* Replays the journal of a match (see include/journal.h) with the game rules,
+ * optionally drawing it, at real time, N times faster or as fast as possible */
+
+#include "journal.h"
+#include "ncurses_wrapper.h"
+#include "utils.h"
+#include <getopt.h>
+
+typedef struct {
+  uint64_t inputs;
+  uint64_t ticks;
+  uint64_t rounds;
+  /* Records whose result differs from the one recorded */
+  uint64_t divergences;
+  /* Index of the first one (-1 if none) */
+  int64_t first_divergence;
+} replay_results_t;
+
+/* Counts a record whose result differs from the one recorded */
+static void diverged(replay_results_t *results, uint64_t index) {
+  if (results->divergences++ == 0)
+    results->first_divergence = (int64_t)index;
+}
+
+/* Applies a record to the game, checking it against the recorded result */
+static void apply_record(const journal_record_t *record, uint64_t index,
+                         game_t *game, game_rng_t *rng, int *tokens,
+                         replay_results_t *results) {
+  /* Static as it can be too big for the stack on large boards */
+  static aliens_update_t aliens_update;
+  player_t *player =
+      record->player_id >= 0 && record->player_id < MAX_PLAYERS
+          ? &game->players[record->player_id]
+          : NULL;
+
+  if (record->type != JOURNAL_TICK && record->type != JOURNAL_ROUND &&
+      player == NULL) {
+    diverged(results, index);
+    return;
+  }
+
+  switch (record->type) {
+  case JOURNAL_CONNECT:
+    if (find_position_and_init_player(game, tokens) != record->player_id)
+      diverged(results, index);
+    results->inputs++;
+    break;
+
+  case JOURNAL_ACTION:
+    if (record->data.action.action_type == MOVE)
+      player_move(game, record->player_id,
+                  (MOVEMENT_DIRECTION)record->data.action.movement_direction);
+    else
+      player_zap(game, record->player_id, record->ts, NULL);
+    results->inputs++;
+    break;
+
+  case JOURNAL_DISCONNECT:
+    player_leave(game, record->player_id);
+    results->inputs++;
+    break;
+
+  case JOURNAL_TICK:
+    aliens_tick(game, &aliens_update, record->data.tick.aliens_regenerated,
+                rng);
+
+    /* The checksum isn't there if the server stopped right after the tick */
+    if (game->aliens_alive != record->data.tick.aliens_alive ||
+        (record->data.tick.checksum != 0 &&
+         game_checksum(game) != record->data.tick.checksum))
+      diverged(results, index);
+    results->ticks++;
+    break;
+
+  case JOURNAL_ROUND:
+    start_round(game, rng);
+
+    if (game->aliens_alive != record->data.tick.aliens_alive ||
+        game_checksum(game) != record->data.tick.checksum)
+      diverged(results, index);
+    results->rounds++;
+    break;
+
+  default:
+    diverged(results, index);
+  }
+}
+
+/* Prints the usage and exits */
+static void usage(const char *program) {
+  printf("Usage: %s [-s speed] [-d] journal\n\n"
+         "  -s  1 replays at real time, N at N times faster and 0 as fast as "
+         "possible (default)\n"
+         "  -d  draws the game (with the renderer chosen by %s)\n",
+         program, RENDER_BACKEND_ENV);
+  exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+  const journal_header_t *header;
+  const journal_record_t *records;
+  size_t mapped_size;
+  /* Static as it can be too big for the stack on large boards */
+  static game_t game;
+  game_rng_t rng;
+  int tokens[MAX_PLAYERS];
+  nc_window_t *game_window = NULL, *score_window = NULL;
+  replay_results_t results = {0, 0, 0, 0, -1};
+  double speed = 0;
+  bool draw = false;
+  uint64_t start_ns, target_ns, now_ns;
+  double elapsed_s;
+  int option;
+
+  while ((option = getopt(argc, argv, "s:dh")) != -1) {
+    switch (option) {
+    case 's':
+      speed = atof(optarg);
+      break;
+    case 'd':
+      draw = true;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (optind != argc - 1 || speed < 0)
+    usage(argv[0]);
+
+  header = journal_map(argv[optind], &mapped_size);
+  if (header == NULL) {
+    printf("%s isn't a valid journal.\n", argv[optind]);
+    return -1;
+  }
+  if (header->space_size != SPACE_SIZE || header->max_players != MAX_PLAYERS ||
+      header->n_aliens != N_ALIENS) {
+    /* N_ALIENS follows from SPACE_SIZE, so only the two can be built with */
+    printf("The journal was recorded with SPACE_SIZE=%d, MAX_PLAYERS=%d and "
+           "N_ALIENS=%d, and this build has %d, %d and %d (build it with "
+           "\"make SPACE_SIZE=%d MAX_PLAYERS=%d\").\n",
+           header->space_size, header->max_players, header->n_aliens,
+           SPACE_SIZE, MAX_PLAYERS, N_ALIENS, header->space_size,
+           header->max_players);
+    return -1;
+  }
+  records = journal_records(header);
+
+  /* Same starting game as the server */
+  game_rng_seed(&rng, header->seed);
+  init_game(&game, tokens, &rng);
+
+  if (draw) {
+    nc_init();
+    game_window = nc_init_space(0);
+    score_window = nc_init_scoreboard();
+    nc_draw_init_game(game_window, score_window, &game);
+  }
+
+  start_ns = get_monotonic_ns();
+  for (uint64_t i = 0; i < header->n_records; i++) {
+    /* Wait for the time of the record (relative to the match start) */
+    if (speed > 0) {
+      target_ns = start_ns + (uint64_t)((records[i].ts - header->start_ts) *
+                                        1e6 / speed);
+      now_ns = get_monotonic_ns();
+      if (target_ns > now_ns)
+        usleep((useconds_t)((target_ns - now_ns) / 1000));
+    }
+
+    apply_record(&records[i], i, &game, &rng, tokens, &results);
+
+    if (draw) {
+      nc_redraw_space(game_window, &game);
+      nc_update_scoreboard(score_window, game.players, game.aliens_alive);
+      nc_stage(game_window);
+      nc_stage(score_window);
+      nc_flush();
+    }
+  }
+  elapsed_s = (get_monotonic_ns() - start_ns) / 1e9;
+
+  if (draw)
+    nc_cleanup();
+
+  printf("Replayed %lu records (%lu inputs, %lu ticks, %.1f s of match) in "
+         "%.3f s: %.0f records/s, %.0f ticks/s\n",
+         (unsigned long)header->n_records, (unsigned long)results.inputs,
+         (unsigned long)results.ticks,
+         header->n_records > 0
+             ? (records[header->n_records - 1].ts - header->start_ts) / 1e3
+             : 0.0,
+         elapsed_s, header->n_records / elapsed_s, results.ticks / elapsed_s);
+  printf("Rounds started: %lu, aliens alive at the end: %d\n",
+         (unsigned long)results.rounds, game.aliens_alive);
+
+  if (results.divergences > 0) {
+    printf("Diverged from the recorded match on %lu records (first: record "
+           "%ld).\n",
+           (unsigned long)results.divergences, (long)results.first_divergence);
+    return 1;
+  }
+
+  printf("Matches the recorded match.\n");
+  return 0;
+}
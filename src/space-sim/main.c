@@ -0,0 +1,191 @@
+/* Headless simulation: plays matches with the game rules only (no sockets and
+ * no drawing) on a virtual clock, as fast as possible, to know how many
+ * matches a core could host */
+
+#include "game_clock.h"
+#include "game_core.h"
+#include <assert.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* State of a match (everything a server needs per match, besides the
+ * sockets and windows) */
+typedef struct {
+  game_t game;
+  aliens_update_t aliens_update;
+  int tokens[MAX_PLAYERS];
+  aliens_regeneration_t regeneration;
+  game_rng_t rng;
+} match_t;
+
+typedef struct {
+  int matches;
+  /* Ticks after which a match stops even if there are aliens alive */
+  int max_ticks;
+  /* Actions per second of each player */
+  double rate;
+  unsigned int seed;
+} sim_config_t;
+
+typedef struct {
+  uint64_t ticks;
+  uint64_t actions;
+  /* Actions a validator would reject (player stunned) */
+  uint64_t rejected_actions;
+  uint64_t zaps;
+  /* Matches that ended because every alien was killed */
+  int matches_won;
+} sim_results_t;
+
+/* Returns the time of the monotonic clock in ns */
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* Makes a player act at the current time, like a well behaved astronaut-client
+ * (zaps on a quarter of the actions the zap is recharged, moves otherwise) */
+static void player_act(match_t *match, player_t *player,
+                       sim_results_t *results) {
+  uint64_t current_ts = game_clock_now_ms();
+  MOVEMENT_DIRECTION direction;
+
+  results->actions++;
+
+  /* Same rules as the game-server validator */
+  if (current_ts - player->last_stunned <= STUNNED_DELAY) {
+    results->rejected_actions++;
+    return;
+  }
+
+  if (current_ts - player->last_shot > ZAP_DELAY && rand() % 4 == 0) {
+    player_zap(&match->game, player->id, current_ts, NULL);
+    results->zaps++;
+    return;
+  }
+
+  if (player->orientation == VERTICAL)
+    direction = rand() % 2 ? UP : DOWN;
+  else
+    direction = rand() % 2 ? LEFT : RIGHT;
+  player_move(&match->game, player->id, direction);
+}
+
+/* Plays a match until every alien is killed or max_ticks */
+static void play_match(match_t *match, uint64_t seed,
+                       const sim_config_t *config, sim_results_t *results) {
+  int actions_per_tick = (int)(config->rate * ALIEN_UPDATE / 1000);
+  uint64_t action_interval =
+      actions_per_tick > 0 ? ALIEN_UPDATE / actions_per_tick : ALIEN_UPDATE;
+  int aliens_to_regenerate;
+
+  game_rng_seed(&match->rng, seed);
+  init_game(&match->game, match->tokens, &match->rng);
+  for (int i = 0; i < MAX_PLAYERS; i++)
+    find_position_and_init_player(&match->game, match->tokens);
+  aliens_regeneration_init(&match->regeneration, &match->game,
+                           game_clock_now_ms());
+
+  for (int tick = 0; tick < config->max_ticks && match->game.aliens_alive;
+       tick++) {
+    /* Actions spread over the tick interval */
+    for (int i = 0; i < actions_per_tick; i++) {
+      for (int j = 0; j < MAX_PLAYERS; j++)
+        player_act(match, &match->game.players[j], results);
+      game_clock_sleep_ms(action_interval);
+    }
+    game_clock_sleep_ms(ALIEN_UPDATE - action_interval * actions_per_tick);
+
+    aliens_to_regenerate = aliens_regeneration_count(
+        &match->regeneration, &match->game, game_clock_now_ms());
+    aliens_tick(&match->game, &match->aliens_update, aliens_to_regenerate,
+                &match->rng);
+    results->ticks++;
+  }
+
+  if (match->game.aliens_alive == 0)
+    results->matches_won++;
+}
+
+/* Prints the usage and exits */
+static void usage(const char *program) {
+  printf("Usage: %s [-m matches] [-T max ticks per match] [-r actions/s] "
+         "[-s seed]\n",
+         program);
+  exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+  sim_config_t config = {10, 3600, 5, 1};
+  sim_results_t results = {0};
+  match_t *match =
+      (match_t *)aligned_alloc(_Alignof(match_t), sizeof(match_t));
+  struct rusage usage_stats;
+  uint64_t start_ns;
+  double elapsed_s, simulated_s;
+  int option;
+
+  assert(match != NULL);
+
+  while ((option = getopt(argc, argv, "m:T:r:s:h")) != -1) {
+    switch (option) {
+    case 'm':
+      config.matches = atoi(optarg);
+      break;
+    case 'T':
+      config.max_ticks = atoi(optarg);
+      break;
+    case 'r':
+      config.rate = atof(optarg);
+      break;
+    case 's':
+      config.seed = (unsigned int)atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (config.matches <= 0 || config.max_ticks <= 0 || config.rate < 0)
+    usage(argv[0]);
+
+  /* Used by the players (each match seeds its aliens) */
+  srand(config.seed);
+  /* Only moves when the simulation sleeps, starting late enough for no
+   * player to start stunned */
+  game_clock_use(game_clock_virtual.name, 0);
+  game_clock_advance_ms(STUNNED_DELAY + 1);
+
+  start_ns = now_ns();
+  for (int i = 0; i < config.matches; i++)
+    play_match(match, config.seed + i, &config, &results);
+  elapsed_s = (now_ns() - start_ns) / 1e9;
+
+  simulated_s = results.ticks * (ALIEN_UPDATE / 1000.0);
+  getrusage(RUSAGE_SELF, &usage_stats);
+
+  printf("SPACE_SIZE=%d N_ALIENS=%d, %d matches (%d won) of up to %d ticks, "
+         "%.1f actions/s per player\n\n",
+         SPACE_SIZE, N_ALIENS, config.matches, results.matches_won,
+         config.max_ticks, config.rate);
+  printf("Elapsed             %12.3f s\n", elapsed_s);
+  printf("Ticks               %12lu (%.0f per s)\n",
+         (unsigned long)results.ticks, results.ticks / elapsed_s);
+  printf("Actions             %12lu (%.0f per s, %lu rejected, %lu zaps)\n",
+         (unsigned long)results.actions, results.actions / elapsed_s,
+         (unsigned long)results.rejected_actions, (unsigned long)results.zaps);
+  printf("Simulated time      %12.0f s (%.1fx real time)\n", simulated_s,
+         simulated_s / elapsed_s);
+  printf("Memory per match    %12lu bytes\n", (unsigned long)sizeof(match_t));
+  printf("Peak RSS            %12ld KB\n", usage_stats.ru_maxrss);
+  printf("\nA core could host about %.0f real time matches (without "
+         "network and drawing costs)\n",
+         simulated_s / elapsed_s);
+
+  free(match);
+
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include "comms.h"
+#include "zeromq_wrapper.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <zmq.h>
+
+/* Requests handled by the game-server (the ones with a service time) */
+static const struct {
+  MESSAGE_TYPE type;
+  const char *name;
+} requests[] = {{DISPLAY_CONNECT_REQUEST, "DISPLAY_CONNECT_REQUEST"},
+                {ASTRONAUT_CONNECT_REQUEST, "ASTRONAUT_CONNECT_REQUEST"},
+                {ACTION_REQUEST, "ACTION_REQUEST"},
+                {DISCONNECT_REQUEST, "DISCONNECT_REQUEST"}};
+
+static const char *lock_users[N_LOCK_USERS] = {"main loop", "aliens thread"};
+
+/* Prints a line with a summary (in ms) */
+static void print_summary(const char *name, const latency_summary_t *summary) {
+  printf("%-27s %7lu %8.3f %8.3f %8.3f\n", name, (unsigned long)summary->count,
+         summary->p50 / 1e6, summary->p99 / 1e6, summary->max / 1e6);
+}
+
+/* Displays the stats of an interval */
+static void display_stats(stats_update_t *stats_update) {
+  char name[32];
+  uint64_t n_requests = 0;
+  int n_request_types = sizeof(requests) / sizeof(requests[0]);
+
+  for (int i = 0; i < n_request_types; i++)
+    n_requests += stats_update->service_time[requests[i].type].count;
+
+  printf("\x1b[2J\x1b[H"); /* Clear the terminal */
+
+  printf("====== Server stats (last %lu ms) ======\n",
+         (unsigned long)stats_update->interval_ms);
+  printf("Requests: %.1f/s\n\n",
+         stats_update->interval_ms > 0
+             ? n_requests * 1000.0 / stats_update->interval_ms
+             : 0.0);
+
+  printf("%-27s %7s %8s %8s %8s\n", "Service time", "count", "p50 ms", "p99 ms",
+         "max ms");
+  for (int i = 0; i < n_request_types; i++)
+    print_summary(requests[i].name,
+                  &stats_update->service_time[requests[i].type]);
+
+  printf("\n%-27s %7s\n", "Shed (see admission.h)", "count");
+  for (int i = 0; i < n_request_types; i++)
+    printf("%-27s %7lu\n", requests[i].name,
+           (unsigned long)stats_update->shed[requests[i].type]);
+
+  printf("\n%-27s %7s %8s %8s %8s\n", "Game lock", "count", "p50 ms", "p99 ms",
+         "max ms");
+  for (int i = 0; i < N_LOCK_USERS; i++) {
+    snprintf(name, sizeof(name), "wait (%s)", lock_users[i]);
+    print_summary(name, &stats_update->lock_wait[i]);
+  }
+  for (int i = 0; i < N_LOCK_USERS; i++) {
+    snprintf(name, sizeof(name), "hold (%s)", lock_users[i]);
+    print_summary(name, &stats_update->lock_hold[i]);
+  }
+
+  fflush(stdout);
+}
+
+int main() {
+  /* ZeroMQ/comms related */
+  void *zmq_context = zmq_get_context();
+  void *sub_socket = zmq_create_socket(zmq_context, ZMQ_SUB);
+  MESSAGE_TYPE msg_type;
+  stats_update_t *stats_update;
+
+  /* ZeroMQ initialization */
+  zmq_connect_socket(sub_socket, zmq_server_pubsub_address());
+  zmq_subscribe(sub_socket, STATS_TOPIC);
+
+  printf("Waiting for the game-server stats...\n");
+
+  /* Stops with Ctrl+C, like the Python scoreboard */
+  while (true) {
+    stats_update =
+        (stats_update_t *)zmq_receive_msg(sub_socket, &msg_type, STATS_TOPIC);
+    display_stats(stats_update);
+    free(stats_update);
+  }
+
+  zmq_cleanup(zmq_context, sub_socket, NULL);
+}